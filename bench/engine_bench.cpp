@@ -0,0 +1,302 @@
+// Microbenchmarks for the storage engine, without Node in the way: index
+// puts and gets, SimpleJSON, dotted paths, and saving and loading the data
+// files. Each benchmark reports throughput, per-operation latency
+// percentiles, heap bytes allocated and the resident set size afterwards.
+//
+//   fastdb_bench [--sizes 10000,1000000,10000000] [--filter name] [--json file] [--dir path]
+//
+// Operations are timed in batches, so a percentile is the mean cost of one
+// operation within a batch; single operations are too short for the clock.
+#include "engine.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Heap accounting: every allocation in the process goes through here
+static std::atomic<uint64_t> allocatedBytes(0);
+static std::atomic<uint64_t> allocationCount(0);
+
+void* operator new(size_t size) {
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+// Exposes the engine internals the benchmarks time directly
+class BenchEngine : public fastdb::Engine {
+public:
+    using Engine::splitPath;
+};
+
+struct Result {
+    std::string name;
+    size_t entries;
+    uint64_t ops;
+    double seconds;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+    uint64_t bytes;
+    uint64_t allocations;
+    uint64_t rss;
+};
+
+uint64_t residentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.WorkingSetSize;
+#else
+    std::ifstream statm("/proc/self/statm");
+    uint64_t pages = 0;
+    uint64_t resident = 0;
+    if (statm >> pages >> resident) return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    // No procfs (macOS): fall back to the peak
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// xorshift64*, so key orders are the same on every run
+struct Random {
+    uint64_t state;
+    explicit Random(uint64_t seed) : state(seed ? seed : 1) {}
+    uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 2685821657736338717ULL;
+    }
+};
+
+double percentile(std::vector<double>& samples, double p) {
+    if (samples.empty()) return 0;
+    size_t rank = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+    std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+    return samples[rank];
+}
+
+// Runs op(i) for i in [0, ops), timing batches of `batch` operations
+template <typename Op>
+Result measure(const std::string& name, size_t entries, uint64_t ops, uint64_t batch, Op op) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<double> samples;
+    samples.reserve(static_cast<size_t>(ops / batch + 1));
+    
+    uint64_t bytesBefore = allocatedBytes.load();
+    uint64_t countBefore = allocationCount.load();
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < ops;) {
+        uint64_t first = i;
+        uint64_t end = std::min(ops, i + batch);
+        Clock::time_point batchStart = Clock::now();
+        for (; i < end; i++) op(i);
+        double nanos = std::chrono::duration<double, std::nano>(Clock::now() - batchStart).count();
+        samples.push_back(nanos / static_cast<double>(end - first));
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    
+    Result result;
+    result.name = name;
+    result.entries = entries;
+    result.ops = ops;
+    result.seconds = seconds;
+    result.bytes = allocatedBytes.load() - bytesBefore;
+    result.allocations = allocationCount.load() - countBefore;
+    result.p50 = percentile(samples, 0.50);
+    result.p90 = percentile(samples, 0.90);
+    result.p99 = percentile(samples, 0.99);
+    result.max = samples.empty() ? 0 : *std::max_element(samples.begin(), samples.end());
+    result.rss = residentBytes();
+    return result;
+}
+
+std::string keyOf(uint64_t i) {
+    return "user:" + std::to_string(i);
+}
+
+// A record shaped like the nested documents the README examples store
+std::string sampleDocument(uint64_t i) {
+    return "{\"id\":" + std::to_string(i) + ",\"name\":\"User " + std::to_string(i) +
+           "\",\"email\":\"user" + std::to_string(i) + "@example.com\",\"active\":true," +
+           "\"profile\":{\"age\":" + std::to_string(20 + i % 50) + ",\"city\":\"Istanbul\"," +
+           "\"tags\":[\"alpha\",\"beta\",\"gamma\"]},\"score\":" + std::to_string(i % 1000) + ".5}";
+}
+
+void printResult(const Result& r) {
+    double opsPerSecond = r.seconds > 0 ? static_cast<double>(r.ops) / r.seconds : 0;
+    std::cout << std::left << std::setw(18) << r.name << std::right << std::setw(10) << r.entries
+              << std::setw(14) << std::fixed << std::setprecision(0) << opsPerSecond
+              << std::setw(14) << std::setprecision(1) << r.p50 << std::setw(14) << r.p90
+              << std::setw(14) << r.p99 << std::setw(14) << r.max
+              << std::setw(14) << r.bytes / std::max<uint64_t>(r.ops, 1)
+              << std::setw(10) << r.rss / (1024 * 1024) << std::endl;
+}
+
+void writeJson(std::ostream& out, const std::vector<Result>& results) {
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        double opsPerSecond = r.seconds > 0 ? static_cast<double>(r.ops) / r.seconds : 0;
+        out << "    {\"name\": \"" << r.name << "\", \"entries\": " << r.entries << ", \"ops\": " << r.ops
+            << std::fixed << std::setprecision(1) << ", \"opsPerSec\": " << opsPerSecond
+            << ", \"nsPerOp\": {\"p50\": " << r.p50 << ", \"p90\": " << r.p90 << ", \"p99\": " << r.p99
+            << ", \"max\": " << r.max << "}, \"seconds\": " << std::setprecision(6) << r.seconds
+            << ", \"bytesAllocated\": " << r.bytes << ", \"allocations\": " << r.allocations
+            << ", \"rssBytes\": " << r.rss << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+std::vector<size_t> parseSizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) sizes.push_back(static_cast<size_t>(std::strtoull(item.c_str(), nullptr, 10)));
+    }
+    return sizes;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes = { 10000, 1000000 };
+    std::string filter;
+    std::string jsonPath;
+    std::string dir;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--sizes" && hasValue) {
+            sizes = parseSizes(argv[++i]);
+        } else if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            jsonPath = argv[++i];
+        } else if (arg == "--dir" && hasValue) {
+            dir = argv[++i];
+        } else {
+            std::cerr << "usage: fastdb_bench [--sizes 10000,1000000,10000000] [--filter name] [--json file] [--dir path]"
+                      << std::endl;
+            return 2;
+        }
+    }
+    if (dir.empty()) {
+        dir = (std::filesystem::temp_directory_path() / ("fastdb-bench-" + std::to_string(
+            std::chrono::steady_clock::now().time_since_epoch().count()))).string();
+    }
+    std::filesystem::create_directories(dir);
+    
+    std::vector<Result> results;
+    auto run = [&](const std::string& name, size_t entries, uint64_t ops, uint64_t batch, auto op) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) return;
+        results.push_back(measure(name, entries, ops, batch, op));
+        printResult(results.back());
+    };
+    
+    std::cout << std::left << std::setw(18) << "benchmark" << std::right << std::setw(10) << "entries"
+              << std::setw(14) << "ops/sec" << std::setw(14) << "p50 ns" << std::setw(14) << "p90 ns"
+              << std::setw(14) << "p99 ns" << std::setw(14) << "max ns" << std::setw(14) << "bytes/op"
+              << std::setw(10) << "RSS MB" << std::endl;
+    
+    for (size_t n : sizes) {
+        std::string path = dir + "/bench-" + std::to_string(n) + ".db";
+        std::string error;
+        fastdb::Options options;
+        options.autoSync = false;
+        std::string value(100, 'v');
+        
+        {
+            BenchEngine db;
+            if (!db.open(path, options, error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+            run("put", n, n, 256, [&](uint64_t i) { db.put(keyOf(i), value); });
+            
+            std::vector<std::string> keys(n);
+            Random random(n);
+            for (auto& key : keys) key = keyOf(random.next() % n);
+            std::string out;
+            run("get", n, n, 256, [&](uint64_t i) { db.get(keys[i], out); });
+            run("get.miss", n, n, 256, [&](uint64_t i) { db.get("missing:" + std::to_string(i), out); });
+            keys.clear();
+            keys.shrink_to_fit();
+            
+            // One save of the whole index; repeated while it stays short
+            uint64_t repeats = n <= 1000000 ? 3 : 1;
+            run("save", n, repeats, 1, [&](uint64_t) { db.checkpoint(); });
+        }
+        run("load", n, 1, 1, [&](uint64_t) {
+            BenchEngine db;
+            db.open(path, options, error);
+        });
+        std::filesystem::remove(path);
+        
+        // The remaining benchmarks cost per operation what they cost at any
+        // size, so they run at most 1M operations
+        uint64_t ops = std::min<uint64_t>(n, 1000000);
+        std::vector<std::string> documents;
+        for (uint64_t i = 0; i < 1000; i++) documents.push_back(sampleDocument(i));
+        std::vector<fastdb::SimpleJSON::Value> parsed;
+        for (const auto& document : documents) parsed.push_back(fastdb::SimpleJSON::parse(document));
+        run("json.parse", n, ops, 64, [&](uint64_t i) { fastdb::SimpleJSON::parse(documents[i % 1000]); });
+        run("json.stringify", n, ops, 64, [&](uint64_t i) { fastdb::SimpleJSON::stringify(parsed[i % 1000]); });
+        
+        BenchEngine nested;
+        nested.open(dir + "/nested-" + std::to_string(n) + ".db", options, error);
+        run("splitPath", n, ops, 256, [&](uint64_t) { nested.splitPath("users.profile.address.city"); });
+        // A nested write rewrites the whole root document, so these scale
+        // with the number of distinct paths, not with n
+        uint64_t nestedOps = std::min<uint64_t>(n, 20000);
+        run("nested.set", n, nestedOps, 16, [&](uint64_t i) {
+            nested.put("users.u" + std::to_string(i % 1000) + ".name", "User");
+        });
+        std::string out;
+        run("nested.get", n, nestedOps, 16, [&](uint64_t i) {
+            nested.get("users.u" + std::to_string(i % 1000) + ".name", out);
+        });
+    }
+    
+    std::error_code ignored;
+    std::filesystem::remove_all(dir, ignored);
+    
+    if (!jsonPath.empty()) {
+        std::ofstream json(jsonPath);
+        writeJson(json, results);
+        if (!json) {
+            std::cerr << "Cannot write " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
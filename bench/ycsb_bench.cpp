@@ -0,0 +1,294 @@
+// The YCSB workloads of benchmark.js run directly on the storage engine, to
+// separate the engine's cost from the Node boundary's. Takes the same
+// options as benchmark.js and prints a table, or JSON with --json (- for
+// standard output, which is how benchmark.js --native reads it).
+//
+//   fastdb_ycsb [--workloads A,B,C,D,E,F] [--records 100000] [--operations 100000]
+//               [--distribution zipfian|uniform] [--value-size 100] [--dot-ratio 0]
+//               [--modes wal,walsync,partitioned,rewrite] [--json file]
+#include "engine.h"
+
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <random>
+
+namespace {
+
+struct Workload {
+    double read;
+    double update;
+    double insert;
+    double scan;
+    double readModifyWrite;
+    bool latest;
+};
+
+// Same shares as WORKLOADS in benchmark.js
+const std::map<std::string, Workload> WORKLOADS = {
+    { "A", { 0.5, 0.5, 0, 0, 0, false } },
+    { "B", { 0.95, 0.05, 0, 0, 0, false } },
+    { "C", { 1, 0, 0, 0, 0, false } },
+    { "D", { 0.95, 0, 0.05, 0, 0, true } },
+    { "E", { 0, 0, 0.05, 0.95, 0, false } },
+    { "F", { 0.5, 0, 0, 0, 0.5, false } }
+};
+
+const uint64_t MAX_SCAN_LENGTH = 100;
+
+struct Settings {
+    std::string workloads = "A,B,C,D,E,F";
+    uint64_t records = 100000;
+    uint64_t operations = 100000;
+    std::string distribution = "zipfian";
+    size_t valueSize = 100;
+    double dotRatio = 0;
+    std::string modes = "wal";
+    std::string json;
+};
+
+struct Result {
+    std::string mode;
+    std::string workload;
+    uint64_t operations;
+    double opsPerSec;
+    uint64_t p50;
+    uint64_t p95;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+};
+
+// Zipfian over [0, items) with theta 0.99, as in YCSB and benchmark.js
+class Zipfian {
+public:
+    explicit Zipfian(uint64_t items, double theta = 0.99)
+        : theta(theta), alpha(1 / (1 - theta)), zeta2(1 + std::pow(0.5, theta)), zetan(0), eta(0), items(0) {
+        grow(items);
+    }
+
+    void grow(uint64_t count) {
+        for (uint64_t i = items; i < count; i++) zetan += 1 / std::pow(static_cast<double>(i + 1), theta);
+        items = count;
+        eta = (1 - std::pow(2.0 / items, 1 - theta)) / (1 - zeta2 / zetan);
+    }
+
+    uint64_t next(std::mt19937_64& random) {
+        double u = std::uniform_real_distribution<double>(0, 1)(random);
+        double uz = u * zetan;
+        if (uz < 1) return 0;
+        if (uz < zeta2) return 1;
+        return static_cast<uint64_t>(items * std::pow(eta * u - eta + 1, alpha));
+    }
+
+private:
+    double theta;
+    double alpha;
+    double zeta2;
+    double zetan;
+    double eta;
+    uint64_t items;
+};
+
+uint64_t scramble(uint64_t rank, uint64_t items) {
+    uint32_t h = 0x811c9dc5u;
+    for (int i = 0; i < 4; i++) {
+        h ^= (rank >> (i * 8)) & 0xff;
+        h *= 0x01000193u;
+    }
+    return h % items;
+}
+
+std::string keyOf(uint64_t id, double dotRatio) {
+    if (dotRatio > 0 && static_cast<double>(id % 1000) < dotRatio * 1000) return "ycsb.user" + std::to_string(id);
+    return "user" + std::to_string(id);
+}
+
+fastdb::Options optionsFor(const std::string& mode) {
+    fastdb::Options options;
+    if (mode == "wal" || mode == "walsync" || mode == "partitioned") options.wal = true;
+    if (mode == "walsync") options.walSync = true;
+    if (mode == "partitioned") options.partitions = 16;
+    return options;
+}
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+template <typename Op>
+Result timeOperations(const std::string& mode, const std::string& workload, uint64_t count, Op op) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<uint64_t> samples(count);
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < count; i++) {
+        Clock::time_point opStart = Clock::now();
+        op(i);
+        samples[i] = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - opStart).count());
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double p) {
+        return samples.empty() ? 0 : samples[std::min<size_t>(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+    };
+    return { mode, workload, count, seconds > 0 ? count / seconds : 0, at(0.5), at(0.95), at(0.99), at(0.999),
+             samples.empty() ? 0 : samples.back() };
+}
+
+bool runMode(const std::string& mode, const Settings& settings, const std::string& dir, std::vector<Result>& results) {
+    std::string path = dir + "/ycsb-" + mode + ".db";
+    fastdb::Engine db;
+    std::string error;
+    if (!db.open(path, optionsFor(mode), error)) {
+        std::cerr << error << std::endl;
+        return false;
+    }
+    std::string value(settings.valueSize, 'x');
+    uint64_t records = settings.records;
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> share(0, 1);
+    
+    results.push_back(timeOperations(mode, "load", records, [&](uint64_t id) {
+        db.put(keyOf(id, settings.dotRatio), value);
+    }));
+    
+    Zipfian zipfian(records);
+    std::string out;
+    for (const auto& name : split(settings.workloads)) {
+        auto found = WORKLOADS.find(name);
+        if (found == WORKLOADS.end()) {
+            std::cerr << "Unknown workload: " << name << std::endl;
+            return false;
+        }
+        const Workload& workload = found->second;
+        double read = workload.read;
+        double update = read + workload.update;
+        double insert = update + workload.insert;
+        double scan = insert + workload.scan;
+        
+        auto chooseId = [&]() -> uint64_t {
+            if (workload.latest) {
+                uint64_t back = zipfian.next(random);
+                return back < records ? records - 1 - back : 0;
+            }
+            if (settings.distribution == "uniform") return random() % records;
+            return scramble(zipfian.next(random), records);
+        };
+        
+        results.push_back(timeOperations(mode, name, settings.operations, [&](uint64_t) {
+            double p = share(random);
+            if (p < read) {
+                db.get(keyOf(chooseId(), settings.dotRatio), out);
+            } else if (p < update) {
+                db.put(keyOf(chooseId(), settings.dotRatio), value);
+            } else if (p < insert) {
+                db.put(keyOf(records++, settings.dotRatio), value);
+                if (workload.latest) zipfian.grow(records);
+            } else if (p < scan) {
+                uint64_t first = chooseId();
+                uint64_t length = 1 + random() % MAX_SCAN_LENGTH;
+                for (uint64_t id = first; id < std::min(records, first + length); id++) {
+                    db.get(keyOf(id, settings.dotRatio), out);
+                }
+            } else {
+                std::string key = keyOf(chooseId(), settings.dotRatio);
+                db.get(key, out);
+                db.put(key, value);
+            }
+        }));
+    }
+    return true;
+}
+
+void writeJson(std::ostream& out, const std::vector<Result>& results) {
+    out << "{\"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        out << (i ? ",\n" : "\n") << "  {\"mode\": \"" << r.mode << "\", \"workload\": \"" << r.workload
+            << "\", \"operations\": " << r.operations << ", \"opsPerSec\": " << static_cast<uint64_t>(r.opsPerSec)
+            << ", \"latencyNs\": {\"p50\": " << r.p50 << ", \"p95\": " << r.p95 << ", \"p99\": " << r.p99
+            << ", \"p999\": " << r.p999 << ", \"max\": " << r.max << "}}";
+    }
+    out << "\n]}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Settings settings;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        if (arg == "--workloads") {
+            settings.workloads = value;
+        } else if (arg == "--records") {
+            settings.records = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--operations") {
+            settings.operations = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--distribution") {
+            settings.distribution = value;
+        } else if (arg == "--value-size") {
+            settings.valueSize = static_cast<size_t>(std::strtoull(value.c_str(), nullptr, 10));
+        } else if (arg == "--dot-ratio") {
+            settings.dotRatio = std::strtod(value.c_str(), nullptr);
+        } else if (arg == "--modes") {
+            settings.modes = value;
+        } else if (arg == "--json") {
+            settings.json = value;
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 2;
+        }
+    }
+    if (argc % 2 == 0 || settings.records == 0 || (settings.distribution != "zipfian" && settings.distribution != "uniform")) {
+        std::cerr << "usage: fastdb_ycsb [--workloads A,B,...] [--records n] [--operations n] "
+                     "[--distribution zipfian|uniform] [--value-size n] [--dot-ratio r] [--modes list] [--json file|-]"
+                  << std::endl;
+        return 2;
+    }
+    
+    std::string dir = (std::filesystem::temp_directory_path() / ("fastdb-ycsb-" + std::to_string(
+        std::chrono::steady_clock::now().time_since_epoch().count()))).string();
+    std::filesystem::create_directories(dir);
+    std::vector<Result> results;
+    bool success = true;
+    for (const auto& mode : split(settings.modes)) {
+        if (mode != "wal" && mode != "walsync" && mode != "partitioned" && mode != "rewrite") {
+            std::cerr << "Unknown mode: " << mode << std::endl;
+            success = false;
+            break;
+        }
+        if (!runMode(mode, settings, dir, results)) {
+            success = false;
+            break;
+        }
+    }
+    std::error_code ignored;
+    std::filesystem::remove_all(dir, ignored);
+    if (!success) return 1;
+    
+    if (settings.json == "-") {
+        writeJson(std::cout, results);
+        return 0;
+    }
+    std::cout << std::left << std::setw(12) << "mode" << std::setw(9) << "workload" << std::right << std::setw(11)
+              << "ops/sec" << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "p99.9 us"
+              << std::setw(11) << "max us" << std::endl;
+    for (const auto& r : results) {
+        std::cout << std::left << std::setw(12) << r.mode << std::setw(9) << r.workload << std::right
+                  << std::setw(11) << static_cast<uint64_t>(r.opsPerSec) << std::fixed << std::setprecision(1)
+                  << std::setw(10) << r.p50 / 1000.0 << std::setw(10) << r.p99 / 1000.0
+                  << std::setw(10) << r.p999 / 1000.0 << std::setw(11) << r.max / 1000.0 << std::endl;
+    }
+    if (!settings.json.empty()) {
+        std::ofstream json(settings.json);
+        writeJson(json, results);
+    }
+    return 0;
+}
@@ -0,0 +1,285 @@
+/**
+ * YCSB-style workloads against the Database API, for sizing deployments
+ * and comparing storage modes.
+ *
+ *   node benchmark.js [--workloads A,B,C,D,E,F] [--records 100000] [--operations 100000]
+ *                     [--distribution zipfian|uniform] [--value-size 100] [--dot-ratio 0]
+ *                     [--modes wal,walsync,partitioned,rewrite] [--batch 1000] [--json file] [--native]
+ *
+ * Each mode loads `records` records into a fresh database, then runs every
+ * workload's `operations` operations over it. Operations run in batches of
+ * `batch` between event-loop turns, as a server would interleave requests,
+ * and the event-loop delay is sampled throughout. With --native, the same
+ * workloads also run through the C++ engine (build-native/fastdb_ycsb), so
+ * the cost of the Node boundary shows up as the difference.
+ */
+const Database = require('./index.js');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const { monitorEventLoopDelay } = require('perf_hooks');
+const { execFileSync } = require('child_process');
+
+// Read, update, insert, scan and read-modify-write shares, as in YCSB's
+// core workloads. D reads the latest inserted records; E's scans read a
+// run of consecutive record ids, since the store has no ordered scan.
+const WORKLOADS = {
+    A: { read: 0.5, update: 0.5 },
+    B: { read: 0.95, update: 0.05 },
+    C: { read: 1 },
+    D: { read: 0.95, insert: 0.05, latest: true },
+    E: { scan: 0.95, insert: 0.05 },
+    F: { read: 0.5, readModifyWrite: 0.5 }
+};
+
+// Storage modes: constructor options for each
+const MODES = {
+    wal: { wal: true },
+    walsync: { wal: true, walSync: true },
+    partitioned: { wal: true, partitions: 16 },
+    rewrite: {}
+};
+
+const MAX_SCAN_LENGTH = 100;
+
+function parseArgs(argv) {
+    const options = {
+        workloads: 'A,B,C,D,E,F',
+        records: 100000,
+        operations: 100000,
+        distribution: 'zipfian',
+        valueSize: 100,
+        dotRatio: 0,
+        modes: 'wal',
+        batch: 1000,
+        json: null,
+        native: false
+    };
+    for (let i = 2; i < argv.length; i++) {
+        const arg = argv[i];
+        const name = arg.replace(/^--/, '').replace(/-([a-z])/g, (_, c) => c.toUpperCase());
+        if (name === 'native') {
+            options.native = true;
+        } else if (name in options && i + 1 < argv.length) {
+            const value = argv[++i];
+            options[name] = typeof options[name] === 'number' ? Number(value) : value;
+        } else {
+            throw new Error(`Unknown argument: ${arg}`);
+        }
+    }
+    if (!['zipfian', 'uniform'].includes(options.distribution)) {
+        throw new Error('distribution must be zipfian or uniform');
+    }
+    return options;
+}
+
+/**
+ * Zipfian generator over [0, items), Gray et al. as in YCSB, with
+ * theta 0.99. New items can be added without recomputing zeta from scratch.
+ */
+class Zipfian {
+    constructor(items, theta = 0.99) {
+        this.theta = theta;
+        this.alpha = 1 / (1 - theta);
+        this.items = 0;
+        this.zetan = 0;
+        this.zeta2 = 1 + Math.pow(0.5, theta);
+        this.grow(items);
+    }
+
+    grow(items) {
+        for (let i = this.items; i < items; i++) {
+            this.zetan += 1 / Math.pow(i + 1, this.theta);
+        }
+        this.items = items;
+        this.eta = (1 - Math.pow(2 / items, 1 - this.theta)) / (1 - this.zeta2 / this.zetan);
+    }
+
+    next() {
+        const u = Math.random();
+        const uz = u * this.zetan;
+        if (uz < 1) return 0;
+        if (uz < this.zeta2) return 1;
+        return Math.floor(this.items * Math.pow(this.eta * u - this.eta + 1, this.alpha));
+    }
+}
+
+// FNV-1a of the rank, so the hot records are spread over the key space
+// instead of being the lowest ids
+function scramble(rank, items) {
+    let h = 0x811c9dc5;
+    for (let i = 0; i < 4; i++) {
+        h ^= (rank >>> (i * 8)) & 0xff;
+        h = Math.imul(h, 0x01000193) >>> 0;
+    }
+    return h % items;
+}
+
+function keyOf(id, dotRatio) {
+    // A fixed share of ids live under one nested document
+    if (dotRatio > 0 && (id % 1000) < dotRatio * 1000) return `ycsb.user${id}`;
+    return `user${id}`;
+}
+
+function percentile(sorted, p) {
+    if (sorted.length === 0) return 0;
+    return sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+}
+
+function summarize(samples, count) {
+    const sorted = samples.subarray(0, count).sort();
+    return {
+        p50: percentile(sorted, 0.5),
+        p95: percentile(sorted, 0.95),
+        p99: percentile(sorted, 0.99),
+        p999: percentile(sorted, 0.999),
+        max: count ? sorted[count - 1] : 0
+    };
+}
+
+const nextTurn = () => new Promise(resolve => setImmediate(resolve));
+
+/**
+ * Runs `count` operations from `op` in batches, timing each one
+ * @returns {Promise<Object>} Throughput, latency percentiles in ns and event-loop delay in ms
+ */
+async function timeOperations(count, batch, op) {
+    const samples = new Uint32Array(count);
+    const loopDelay = monitorEventLoopDelay({ resolution: 10 });
+    loopDelay.enable();
+    const start = process.hrtime.bigint();
+    for (let i = 0; i < count;) {
+        const end = Math.min(count, i + batch);
+        for (; i < end; i++) {
+            const opStart = process.hrtime.bigint();
+            op(i);
+            samples[i] = Math.min(Number(process.hrtime.bigint() - opStart), 0xffffffff);
+        }
+        await nextTurn();
+    }
+    const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+    loopDelay.disable();
+    return {
+        operations: count,
+        opsPerSec: Math.round(count / seconds),
+        latencyNs: summarize(samples, count),
+        eventLoopDelayMs: {
+            p50: loopDelay.percentile(50) / 1e6,
+            p99: loopDelay.percentile(99) / 1e6,
+            max: loopDelay.max / 1e6
+        }
+    };
+}
+
+async function runMode(mode, options, dir) {
+    const filename = path.join(dir, `ycsb-${mode}.db`);
+    const db = new Database(filename, MODES[mode]);
+    const value = 'x'.repeat(options.valueSize);
+    let records = options.records;
+    const results = [];
+
+    const load = await timeOperations(records, options.batch, id => {
+        db.set(keyOf(id, options.dotRatio), value);
+    });
+    results.push({ mode, workload: 'load', ...load });
+
+    const zipfian = new Zipfian(records);
+    for (const name of options.workloads.split(',')) {
+        const workload = WORKLOADS[name.trim().toUpperCase()];
+        if (!workload) throw new Error(`Unknown workload: ${name}`);
+        const read = workload.read || 0;
+        const update = read + (workload.update || 0);
+        const insert = update + (workload.insert || 0);
+        const scan = insert + (workload.scan || 0);
+
+        const chooseId = () => {
+            if (workload.latest) return Math.max(0, records - 1 - zipfian.next());
+            if (options.distribution === 'uniform') return Math.floor(Math.random() * records);
+            return scramble(zipfian.next(), records);
+        };
+
+        const result = await timeOperations(options.operations, options.batch, () => {
+            const p = Math.random();
+            if (p < read) {
+                db.get(keyOf(chooseId(), options.dotRatio));
+            } else if (p < update) {
+                db.set(keyOf(chooseId(), options.dotRatio), value);
+            } else if (p < insert) {
+                db.set(keyOf(records++, options.dotRatio), value);
+                if (workload.latest) zipfian.grow(records);
+            } else if (p < scan) {
+                const first = chooseId();
+                const length = 1 + Math.floor(Math.random() * MAX_SCAN_LENGTH);
+                for (let id = first; id < Math.min(records, first + length); id++) {
+                    db.get(keyOf(id, options.dotRatio));
+                }
+            } else {
+                const key = keyOf(chooseId(), options.dotRatio);
+                db.get(key);
+                db.set(key, value);
+            }
+        });
+        results.push({ mode, workload: name.trim().toUpperCase(), ...result });
+    }
+
+    db.clear();
+    for (const file of fs.readdirSync(dir).filter(file => file.startsWith(`ycsb-${mode}.db`))) {
+        fs.unlinkSync(path.join(dir, file));
+    }
+    return results;
+}
+
+function runNative(options) {
+    const binary = path.join(__dirname, 'build-native', process.platform === 'win32' ? 'fastdb_ycsb.exe' : 'fastdb_ycsb');
+    if (!fs.existsSync(binary)) {
+        console.error('build-native/fastdb_ycsb not found; run npm run benchmark:native first');
+        return [];
+    }
+    const args = ['--workloads', options.workloads, '--records', String(options.records),
+        '--operations', String(options.operations), '--distribution', options.distribution,
+        '--value-size', String(options.valueSize), '--dot-ratio', String(options.dotRatio),
+        '--modes', options.modes, '--json', '-'];
+    return JSON.parse(execFileSync(binary, args, { encoding: 'utf8', maxBuffer: 64 * 1024 * 1024 })).results;
+}
+
+function printTable(results) {
+    const pad = (value, width) => String(value).padStart(width);
+    console.log(`${'driver'.padEnd(7)}${'mode'.padEnd(12)}${'workload'.padEnd(9)}${pad('ops/sec', 11)}` +
+        `${pad('p50 µs', 10)}${pad('p99 µs', 10)}${pad('p99.9 µs', 10)}${pad('max µs', 11)}${pad('loop p99 ms', 13)}`);
+    for (const r of results) {
+        const us = ns => (ns / 1000).toFixed(1);
+        const loop = r.eventLoopDelayMs ? r.eventLoopDelayMs.p99.toFixed(1) : '-';
+        console.log(`${(r.driver || 'node').padEnd(7)}${r.mode.padEnd(12)}${r.workload.padEnd(9)}${pad(r.opsPerSec, 11)}` +
+            `${pad(us(r.latencyNs.p50), 10)}${pad(us(r.latencyNs.p99), 10)}${pad(us(r.latencyNs.p999), 10)}` +
+            `${pad(us(r.latencyNs.max), 11)}${pad(loop, 13)}`);
+    }
+}
+
+async function main() {
+    const options = parseArgs(process.argv);
+    const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'fastdb-ycsb-'));
+    const results = [];
+    try {
+        for (const mode of options.modes.split(',')) {
+            if (!MODES[mode]) throw new Error(`Unknown mode: ${mode}`);
+            for (const result of await runMode(mode, options, dir)) {
+                results.push({ driver: 'node', ...result });
+            }
+        }
+    } finally {
+        fs.rmSync(dir, { recursive: true, force: true });
+    }
+    if (options.native) {
+        for (const result of runNative(options)) results.push({ driver: 'native', ...result });
+    }
+
+    printTable(results);
+    if (options.json) {
+        fs.writeFileSync(options.json, JSON.stringify({ options, results }, null, 2));
+    }
+}
+
+main().catch(error => {
+    console.error(error.message);
+    process.exit(1);
+});
@@ -1,5 +1,15 @@
 {
   "targets": [
+    {
+      "target_name": "libfastdb",
+      "type": "static_library",
+      "cflags!": [ "-fno-exceptions" ],
+      "cflags_cc!": [ "-fno-exceptions" ],
+      "sources": [ "src/engine.cpp" ],
+      "direct_dependent_settings": {
+        "include_dirs": [ "src" ]
+      }
+    },
     {
       "target_name": "fastdb",
       "cflags!": [ "-fno-exceptions" ],
@@ -9,9 +19,10 @@
         "<!@(node -p \"require('node-addon-api').include\")"
       ],
       "dependencies": [
+        "libfastdb",
         "<!(node -p \"require('node-addon-api').gyp\")"
       ],
       "defines": [ "NAPI_DISABLE_CPP_EXCEPTIONS" ]
     }
   ]
-} 
\ No newline at end of file
+}
@@ -19,6 +19,272 @@ export interface DatabaseOptions {
   autoSync?: boolean;
   /** Maximum file size in bytes (100MB default) */
   maxFileSize?: number;
+  /** Number of files keys are hash-partitioned into (1-256, default 1) */
+  partitions?: number;
+  /** Directories the partition files are spread across, round-robin */
+  directories?: string[];
+  /** Bytes of values kept in RAM; colder values spill to `<filename>.cold` (0 = unlimited) */
+  memoryLimit?: number;
+  /** Bloom filter bits per key in file footers (0-64, 0 disables, default 10 for ~1% false positives) */
+  bloomBitsPerKey?: number;
+  /** Serve the file from a shared memory mapping; mutations throw */
+  readOnly?: boolean;
+  /** Leave the files unread until loadAsync(); writes throw until it completes */
+  deferLoad?: boolean;
+  /** Append each write to `<filename>.wal` instead of rewriting the data files */
+  wal?: boolean;
+  /** fsync the log after every write (default false: flushed to the OS only) */
+  walSync?: boolean;
+  /** Log size in bytes that triggers a checkpoint (default 64 MiB) */
+  checkpointBytes?: number;
+  /** Checkpoints to keep, with the logs between them, for restoreTo() (requires wal; default 0) */
+  retainCheckpoints?: number;
+  /** Serve reads from another process's files, applying its write-ahead log as it grows; writes throw until promote() */
+  follow?: boolean;
+  /** Milliseconds between checks of the leader's log (default 100) */
+  followInterval?: number;
+  /** Operations slower than this many milliseconds go to slowLog() (default 0, off) */
+  slowLogThreshold?: number;
+  /** Slow operations kept, oldest dropped first (1-100000, default 128) */
+  slowLogSize?: number;
+  /** One in this many gets and sets is counted for hotKeys() (0-65536, default 16; 0 turns it off) */
+  hotKeySampling?: number;
+}
+
+export interface WalStats {
+  /** Whether writes go to the write-ahead log */
+  enabled: boolean;
+  /** Current log size in bytes */
+  bytes: number;
+  /** Records in the log since the last checkpoint */
+  records: number;
+  /** Sequence number of the last record written */
+  sequence: number;
+  /** Checkpoints taken by this instance */
+  checkpoints: number;
+  /** Records replayed from the log when opening */
+  recoveredRecords: number;
+  /** Bytes of torn records cut from the end of the log */
+  truncatedBytes: number;
+  /** Checkpoints kept for restoreTo() */
+  retainedCheckpoints: number;
+  /** Log segments kept between those checkpoints */
+  retainedSegments: number;
+  /** Sequence of the oldest state restoreTo() can reach (0 when nothing is retained) */
+  oldestRestoreSequence: number;
+  /** Time of the oldest state restoreTo() can reach, in ms since the epoch */
+  oldestRestoreTimestamp: number;
+}
+
+export interface LatencyHistogram {
+  /** Operations recorded */
+  count: number;
+  /** Mean latency in nanoseconds */
+  mean: number;
+  /** Percentiles in nanoseconds, within 1/16 of the recorded values */
+  p50: number;
+  p90: number;
+  p99: number;
+  p999: number;
+  /** Slowest operation in nanoseconds */
+  max: number;
+}
+
+export interface Metrics {
+  get: LatencyHistogram;
+  set: LatencyHistogram;
+  /** Gets of dotted keys */
+  nestedGet: LatencyHistogram;
+  /** Sets of dotted keys */
+  nestedSet: LatencyHistogram;
+  /** Data file writes */
+  save: LatencyHistogram;
+  /** Data file reads, including loadAsync() */
+  load: LatencyHistogram;
+  /** Cold file rewrites */
+  compaction: LatencyHistogram;
+  /** Flushes to disk, including log appends with walSync */
+  fsync: LatencyHistogram;
+  /** File I/O since the last reset */
+  io: IoMetrics;
+  /** Bloom filter probes of readOnly, compiled and ingested files since they were opened */
+  bloom: { probes: number; negatives: number; falsePositives: number };
+}
+
+export interface IoMetrics {
+  /** Bytes of keys and values mutated by writes */
+  logicalBytes: number;
+  /** Bytes written to the data files, the log and the cold file */
+  writtenBytes: number;
+  /** Bytes read from them, including loads */
+  readBytes: number;
+  /** writtenBytes / logicalBytes (0 before any write) */
+  writeAmplification: number;
+  fsyncs: number;
+  /** Milliseconds spent in fsync */
+  fsyncTime: number;
+  /**
+   * Bytes by destination: log records, data files saved without a log (and
+   * read at load), checkpoints, the cold file, and its compactions
+   */
+  sources: Record<'log' | 'data' | 'checkpoint' | 'cold' | 'compaction', { written: number; read: number }>;
+  /** Bytes by the operation that caused them, with its own write amplification */
+  operations: Record<'get' | 'set' | 'nestedGet' | 'nestedSet' | 'save' | 'load' | 'compaction',
+    { logical: number; written: number; read: number; writeAmplification: number }>;
+}
+
+export interface SlowOperation {
+  /** Position in the order operations were logged, from 0 */
+  id: number;
+  /** When the operation finished, in ms since the epoch */
+  timestamp: number;
+  operation: 'get' | 'set' | 'nestedGet' | 'nestedSet' | 'save' | 'load' | 'compaction';
+  /** The key, cut to 128 bytes; empty for saves, loads and compactions */
+  key: string;
+  /** Milliseconds the operation took */
+  duration: number;
+  /** Milliseconds spent in hash table lookups, parsing and serializing the nested document, and file I/O */
+  phases: { lookup: number; parse: number; serialize: number; io: number };
+}
+
+export interface HotKey {
+  key: string;
+  /** Estimated reads and writes since the counts were reset */
+  reads: number;
+  writes: number;
+  /** How much reads + writes may be overcounted */
+  error: number;
+  /** Reads and writes per second */
+  readRate: number;
+  writeRate: number;
+}
+
+export interface KeyMemoryUsage {
+  /** Heap bytes of the key string (0 when it is stored inline) */
+  key: number;
+  /** Heap bytes of the value; for a nested path, its serialized size */
+  value: number;
+  /** The hash table node and its share of the bucket array */
+  node: number;
+  /** Value bytes read from the cold file or a mapped file instead */
+  disk: number;
+  /** key + value + node */
+  total: number;
+}
+
+export interface MemoryReport {
+  /** Keys in the default collection */
+  totalKeys: number;
+  /** Keys the estimate was made from; all of them when there are no more than `samples` */
+  sampledKeys: number;
+  /** Bytes and keys per key prefix, scaled to the whole collection, largest first */
+  prefixes: { prefix: string; keys: number; bytes: number }[];
+  /** Serialized bytes and leaf count per path of the nested document, largest first */
+  nestedPaths: { path: string; keys: number; bytes: number }[];
+}
+
+export interface ReplicationStatus {
+  /** 'follower', 'leader' (writes go to a log followers can tail) or 'standalone' */
+  role: 'follower' | 'leader' | 'standalone';
+  /** Sequence of the last record written, or applied on a follower */
+  sequence: number;
+  /** Bytes of log records written by the leader and not yet applied */
+  pendingBytes: number;
+  /** Age in ms of the oldest record not yet applied (0 when caught up) */
+  lagMs: number;
+  /** Log records applied by this follower */
+  appliedRecords: number;
+  /** Times the data files were reloaded because records were missed */
+  reloads: number;
+}
+
+export interface ServerOptions {
+  /** TCP port; 0 picks a free one (default 6379) */
+  port?: number;
+  /** IPv4 address to listen on (default '127.0.0.1') */
+  host?: string;
+}
+
+export interface ServerStats {
+  /** Whether the RESP server is listening */
+  running: boolean;
+  /** Port it listens on (0 when stopped) */
+  port: number;
+  /** Open client connections */
+  connections: number;
+  /** Connections accepted since startServer() */
+  totalConnections: number;
+  /** Commands executed */
+  commands: number;
+  /** Batches of pipelined commands run on the JavaScript thread */
+  batches: number;
+}
+
+export interface RestoreTarget {
+  /** Log sequence number to restore to */
+  sequence?: number;
+  /** Time to restore to */
+  timestamp?: number | Date;
+}
+
+export interface RestoreResult {
+  /** Sequence of the last record applied */
+  sequence: number;
+  /** Time of the last record applied, in ms since the epoch */
+  timestamp: number;
+  /** Sequence of the checkpoint the replay started from */
+  checkpoint: number;
+  /** Log records replayed */
+  records: number;
+}
+
+export interface LoadProgress {
+  /** Bytes of data files read so far */
+  bytes: number;
+  /** Total size of the data files */
+  totalBytes: number;
+  /** Keys loaded so far */
+  keys: number;
+}
+
+export interface ExportOptions {
+  /** 'ndjson' writes one {key, value} object per line; 'binary' writes a FastDB data file (default 'ndjson') */
+  format?: 'ndjson' | 'binary';
+  /** Called periodically from the event loop while the export runs */
+  onProgress?: (progress: { entries: number; total: number; bytes: number }) => void;
+}
+
+export interface Column {
+  type: 'utf8' | 'float64' | 'bool' | 'dictionary';
+  /** Number of rows without a value */
+  nulls: number;
+  /** Arrow-style validity bitmap (bit i set = row i present); null when nothing is missing */
+  validity: Uint8Array | null;
+  /** float64 values, a bool bitmap, or int32 indices into `dictionary` */
+  values?: Float64Array | Uint8Array | Int32Array;
+  /** Distinct strings of a dictionary column */
+  dictionary?: string[];
+  /** UTF-8 offsets and bytes of the id column */
+  offsets?: Int32Array;
+  data?: Uint8Array;
+  get?: (row: number) => string;
+}
+
+export interface TierStats {
+  /** Configured memory limit in bytes (0 = unlimited) */
+  memoryLimit: number;
+  /** Bytes of values held in memory */
+  hotBytes: number;
+  /** Bytes of values held only in the cold file */
+  coldBytes: number;
+  /** Number of entries held only in the cold file */
+  coldEntries: number;
+  /** Size of the cold file, including stale copies */
+  coldFileSize: number;
+  /** Values read back into memory */
+  promotions: number;
+  /** Values moved to the cold file */
+  demotions: number;
 }
 
 export interface DatabaseStats {
@@ -43,6 +309,37 @@ export interface KeyValuePair {
   value: any;
 }
 
+export interface PackedStrings {
+  /** UTF-8 bytes of every string, back to back */
+  data: ArrayBuffer;
+  /** String i spans data bytes [offsets[i], offsets[i + 1]) */
+  offsets: Uint32Array;
+}
+
+/**
+ * A named collection inside a database file, with its own index
+ */
+export interface Collection {
+  /** Sets a key-value pair (supports dot notation) */
+  set(key: string, value: any): this;
+  /** Gets a value, or defaultValue if the key doesn't exist */
+  get(key: string, defaultValue?: any): any;
+  /** Deletes a key; true if it existed */
+  delete(key: string): boolean;
+  /** Checks if a key exists */
+  has(key: string): boolean;
+  /** Removes every key from the collection */
+  clear(): this;
+  /** Number of keys in the collection */
+  size(): number;
+  /** All keys in the collection */
+  keys(): string[];
+  /** All values in the collection */
+  values(): any[];
+  /** The collection name */
+  name(): string;
+}
+
 /**
  * FastDB - Ultra-fast native database for Node.js
  * High-performance C++ key-value store with dot notation support
@@ -61,6 +358,17 @@ export default class Database {
    */
   constructor(filename?: string, options?: DatabaseOptions);
 
+  /**
+   * Opens a database, loading it on a background thread
+   * @returns Resolves with the database once every key is loaded
+   */
+  static open(filename?: string, options?: DatabaseOptions & { onProgress?: (progress: LoadProgress) => void }): Promise<Database>;
+
+  /**
+   * Loads a database created with deferLoad; reads see keys loaded so far and writes throw until it resolves
+   */
+  loadAsync(onProgress?: (progress: LoadProgress) => void): Promise<this>;
+
   /**
    * Sets a key-value pair in the database
    * @param key The key to set (supports dot notation for nested data)
@@ -103,7 +411,133 @@ export default class Database {
   all(): KeyValuePair[];
 
   /**
-   * Clears all data from the database
+   * Returns all raw keys packed into a single buffer without creating JS strings
+   * @returns Packed key bytes and offsets (offsets.length === count + 1)
+   */
+  keysPacked(): PackedStrings;
+
+  /**
+   * Returns all raw entries packed into a single buffer without creating JS strings
+   * @returns Packed bytes where key i is string 2i and its value is string 2i + 1
+   */
+  entriesPacked(): PackedStrings;
+
+  /**
+   * Opens a named collection stored in the same database file
+   * @param name The collection name (1-255 characters)
+   * @returns The collection handle
+   * @throws {TypeError} If name is not a string
+   */
+  collection(name: string): Collection;
+
+  /**
+   * Lists the names of all collections
+   * @returns Collection names
+   */
+  collections(): string[];
+
+  /**
+   * Removes a collection and all of its keys
+   * @param name The collection name
+   * @returns True if the collection existed
+   */
+  dropCollection(name: string): boolean;
+
+  /**
+   * Reports how values are split between memory and the cold file
+   * @returns Tiered storage statistics
+   */
+  tierStats(): TierStats;
+
+  /**
+   * Write-ahead log statistics
+   */
+  walStats(): WalStats;
+
+  /**
+   * Latency histograms of the operations run inside the addon
+   * @param options reset: clear the histograms after reading them
+   */
+  metrics(options?: { reset?: boolean }): Metrics;
+
+  /**
+   * Operation, I/O, memory, cache, compaction and checkpoint counters in
+   * the OpenMetrics text format
+   */
+  metricsText(): string;
+
+  /**
+   * Operations that took longer than `slowLogThreshold`, newest first
+   * @param options reset: empty the log after reading it
+   */
+  slowLog(options?: { reset?: boolean }): SlowOperation[];
+
+  /**
+   * The most accessed keys, from sampled gets and sets, most accessed first
+   * @param n keys to return (1-1024, default 10)
+   * @param options reset: start counting afresh after reading
+   */
+  hotKeys(n?: number, options?: { reset?: boolean }): HotKey[];
+
+  /**
+   * Bytes one key holds in memory, including allocator overhead
+   * @returns null if the key does not exist
+   */
+  memoryUsage(key: string): KeyMemoryUsage | null;
+
+  /**
+   * Memory by key prefix and nested path
+   * @param options groupBy: prefix depth (default 1); separator: between
+   *   prefix parts (default ':'); samples: keys to estimate from (default
+   *   10000); limit: groups per list (default 50)
+   */
+  memoryReport(options?: { groupBy?: number; separator?: string; samples?: number; limit?: number }): MemoryReport;
+
+  /**
+   * Restores the state as of an earlier sequence number or time, replaying
+   * the retained log forward from the nearest checkpoint
+   * @param target The sequence number or time to restore to
+   */
+  restoreTo(target: RestoreTarget): RestoreResult;
+
+  /**
+   * Applies the log records the leader has written since the last call.
+   * Followers call this on their own every `followInterval` ms.
+   * @returns The number of records applied
+   */
+  catchUp(): number;
+
+  /**
+   * Replication role and, on a follower, how far it lags the leader
+   */
+  replicationStatus(): ReplicationStatus;
+
+  /**
+   * Turns a follower into the leader once the old leader has stopped
+   * @returns Whether the log could be taken over
+   */
+  promote(): boolean;
+
+  /**
+   * Serves the database to Redis clients (GET, SET, DEL, EXISTS, MGET, INCRBY, SCAN)
+   * from a background I/O thread until stopServer()
+   * @returns The port the server is listening on
+   */
+  startServer(options?: ServerOptions): number;
+
+  /**
+   * Stops the RESP server and closes its connections
+   * @returns Whether a server was running
+   */
+  stopServer(): boolean;
+
+  /**
+   * Connection and command counters of the RESP server
+   */
+  serverStats(): ServerStats;
+
+  /**
+   * Clears all data from the default collection. Named collections are kept.
    * @returns Returns the database instance for chaining
    */
   clear(): this;
@@ -117,6 +551,45 @@ export default class Database {
    */
   push(key: string, element: any): number;
 
+  /**
+   * Appends numbers to a numeric array created with a Float64Array or Int32Array value
+   * @param key The key of the numeric array
+   * @param values The numbers to append
+   * @returns The new length, or null if the key does not hold a numeric array
+   * @throws {TypeError} If key is not a string
+   */
+  append(key: string, values: number | number[] | Float64Array | Int32Array): number | null;
+
+  /**
+   * Copies part of a numeric array, with Array.prototype.slice semantics
+   * @param key The key of the numeric array
+   * @param start First element index (negative counts from the end)
+   * @param end Index after the last element (negative counts from the end)
+   * @returns The selected elements, or null if the key does not hold a numeric array
+   */
+  slice(key: string, start?: number, end?: number): Float64Array | Int32Array | null;
+
+  /**
+   * Sums a numeric array natively
+   * @param key The key of the numeric array
+   * @returns The sum, or null if the key does not hold a numeric array
+   */
+  sum(key: string): number | null;
+
+  /**
+   * Returns the smallest element of a numeric array
+   * @param key The key of the numeric array
+   * @returns The minimum, or null if the array is empty or missing
+   */
+  min(key: string): number | null;
+
+  /**
+   * Returns the largest element of a numeric array
+   * @param key The key of the numeric array
+   * @returns The maximum, or null if the array is empty or missing
+   */
+  max(key: string): number | null;
+
   /**
    * Removes all instances of an element from an array
    * @param key The key of the array (supports dot notation)
@@ -165,6 +638,47 @@ export default class Database {
    */
   sync(): boolean;
 
+  /**
+   * Compiles the default collection into an immutable file indexed by a
+   * minimal perfect hash. Opening that file maps it read-only.
+   * @param filename The output filename
+   * @returns The number of keys written
+   * @throws {Error} If the file cannot be written
+   */
+  compile(filename: string): number;
+
+  /**
+   * Writes [key, value] pairs, sorted by key in UTF-8 byte order, to a
+   * sorted table file for ingest()
+   * @returns The number of entries written
+   * @throws {RangeError} If the keys are not strictly ascending
+   */
+  static buildFile(entries: Array<[string, any]>, filename: string, options?: { bloomBitsPerKey?: number }): number;
+
+  /**
+   * Links a file written by Database.buildFile() into the database; its keys
+   * override existing values
+   * @returns The number of entries in the file
+   */
+  ingest(filename: string): number;
+
+  /**
+   * Streams a snapshot to a file on a background thread in constant memory
+   * @returns Resolves with the number of entries and bytes written
+   */
+  exportTo(filename: string, options?: ExportOptions): Promise<{ entries: number; bytes: number }>;
+
+  /**
+   * Projects the records under a nested path into a columnar file
+   * @returns The number of rows and columns written
+   */
+  exportColumns(path: string, filename: string): { rows: number; columns: number };
+
+  /**
+   * Opens a columnar file as typed array views without copying
+   */
+  static readColumns(filename: string): { rows: number; columns: Record<string, Column> };
+
   /**
    * Creates a backup of the database to a JSON file with metadata
    * @param filename The backup filename
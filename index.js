@@ -12,6 +12,21 @@ const { FastDB } = require('./build/Release/fastdb');
  * @property {SnapshotOptions} [snapshots] Snapshot configuration options
  * @property {boolean} [autoSync=true] Whether to automatically sync changes to disk
  * @property {number} [maxFileSize=100000000] Maximum file size in bytes (100MB default)
+ * @property {number} [partitions=1] Number of files keys are hash-partitioned into (1-256)
+ * @property {string[]} [directories] Directories the partition files are spread across, round-robin
+ * @property {number} [bloomBitsPerKey=10] Bloom filter bits per key in file footers (0-64, 0 disables; 10 gives ~1% false positives)
+ * @property {boolean} [readOnly=false] Serve the file from a shared memory mapping; mutations throw
+ * @property {number} [memoryLimit=0] Bytes of values kept in RAM; colder values spill to `<filename>.cold` (0 = unlimited)
+ * @property {boolean} [deferLoad=false] Leave the files unread until loadAsync(); writes throw until it completes
+ * @property {boolean} [wal=false] Append each write to `<filename>.wal` instead of rewriting the data files; replayed on open
+ * @property {boolean} [walSync=false] fsync the log after every write, so acknowledged writes survive power loss
+ * @property {number} [checkpointBytes=67108864] Log size that triggers a checkpoint (data files rewritten, log emptied)
+ * @property {number} [retainCheckpoints=0] Checkpoints to keep, with the logs between them, for restoreTo() (requires wal)
+ * @property {boolean} [follow=false] Serve reads from another process's files, applying its write-ahead log as it grows; writes throw until promote()
+ * @property {number} [followInterval=100] Milliseconds between checks of the leader's log
+ * @property {number} [slowLogThreshold=0] Operations slower than this many milliseconds go to slowLog() (0 disables)
+ * @property {number} [slowLogSize=128] Slow operations kept, oldest dropped first (1-100000)
+ * @property {number} [hotKeySampling=16] One in this many gets and sets is counted for hotKeys() (0 disables)
  */
 
 /**
@@ -30,6 +45,19 @@ const { FastDB } = require('./build/Release/fastdb');
  * @property {any} value The value associated with the key
  */
 
+/**
+ * @typedef {object} Collection
+ * @property {function(string, any): Collection} set Sets a key-value pair in the collection
+ * @property {function(string, any=): any} get Gets a value, or the default value if missing
+ * @property {function(string): boolean} delete Deletes a key from the collection
+ * @property {function(string): boolean} has Checks if a key exists in the collection
+ * @property {function(): Collection} clear Removes every key from the collection
+ * @property {function(): number} size Number of keys in the collection
+ * @property {function(): string[]} keys All keys in the collection
+ * @property {function(): any[]} values All values in the collection
+ * @property {function(): string} name The collection name
+ */
+
 /**
  * FastDB - Ultra-fast native database for Node.js
  * High-performance C++ key-value store with dot notation support
@@ -41,11 +69,47 @@ class Database extends FastDB {
      * @param {DatabaseOptions} [options={}] Database configuration options
      */
     constructor(filename = 'fastdb.bin', options = {}) {
-        super(filename);
+        if (Array.isArray(options.directories)) {
+            const fs = require('fs');
+            for (const dir of options.directories) {
+                fs.mkdirSync(dir, { recursive: true });
+            }
+        }
+        super(filename, {
+            partitions: options.partitions,
+            directories: options.directories,
+            memoryLimit: options.memoryLimit,
+            bloomBitsPerKey: options.bloomBitsPerKey,
+            readOnly: options.readOnly === true,
+            deferLoad: options.deferLoad === true,
+            wal: options.wal === true,
+            walSync: options.walSync === true,
+            checkpointBytes: options.checkpointBytes,
+            retainCheckpoints: options.retainCheckpoints,
+            follow: options.follow === true,
+            slowLogThreshold: options.slowLogThreshold,
+            slowLogSize: options.slowLogSize,
+            hotKeySampling: options.hotKeySampling
+        });
         this.filename = filename;
         this.options = {
             autoSync: options.autoSync !== false,
             maxFileSize: options.maxFileSize || 100000000,
+            partitions: options.partitions || 1,
+            directories: options.directories || [],
+            memoryLimit: options.memoryLimit || 0,
+            bloomBitsPerKey: options.bloomBitsPerKey ?? 10,
+            readOnly: options.readOnly === true,
+            deferLoad: options.deferLoad === true,
+            wal: options.wal === true,
+            walSync: options.walSync === true,
+            checkpointBytes: options.checkpointBytes || 64 * 1024 * 1024,
+            retainCheckpoints: options.retainCheckpoints || 0,
+            follow: options.follow === true,
+            followInterval: options.followInterval || 100,
+            slowLogThreshold: options.slowLogThreshold || 0,
+            slowLogSize: options.slowLogSize || 128,
+            hotKeySampling: options.hotKeySampling ?? 16,
             snapshots: {
                 enabled: options.snapshots?.enabled || false,
                 interval: options.snapshots?.interval || 86400000,
@@ -56,6 +120,40 @@ class Database extends FastDB {
         if (this.options.snapshots.enabled) {
             this._initSnapshots();
         }
+        if (this.options.follow) {
+            this._initFollower();
+        }
+    }
+
+    /**
+     * Opens a database without blocking the event loop: the files are read
+     * on a background thread and the promise resolves once every key is in
+     * memory.
+     * @param {string} [filename='fastdb.bin'] The path of the database file
+     * @param {DatabaseOptions & {onProgress?: function({bytes: number, totalBytes: number, keys: number}): void}} [options={}]
+     * @returns {Promise<Database>} The loaded database
+     */
+    static open(filename = 'fastdb.bin', options = {}) {
+        try {
+            const db = new this(filename, { ...options, deferLoad: true });
+            return db.loadAsync(options.onProgress);
+        } catch (error) {
+            return Promise.reject(error);
+        }
+    }
+
+    /**
+     * Loads a database created with `deferLoad: true` on a background thread.
+     * Reads made before the promise resolves see the keys loaded so far;
+     * writes throw until it resolves.
+     * @param {function({bytes: number, totalBytes: number, keys: number}): void} [onProgress] Called as batches of keys arrive
+     * @returns {Promise<Database>} Resolves with this database once loading completes
+     */
+    loadAsync(onProgress) {
+        if (onProgress !== undefined && typeof onProgress !== 'function') {
+            return Promise.reject(new TypeError('onProgress must be a function'));
+        }
+        return super.loadAsync(onProgress);
     }
 
     /**
@@ -166,7 +264,22 @@ class Database extends FastDB {
     }
 
     /**
-     * Clears all data from the database
+     * Opens a named collection stored in the same database file. Each collection
+     * has its own index, so its operations never scan other collections.
+     * @param {string} name The collection name (1-255 characters)
+     * @returns {Collection} The collection handle
+     * @throws {TypeError} If name is not a string
+     */
+    collection(name) {
+        if (typeof name !== 'string') {
+            throw new TypeError('Collection name must be a string');
+        }
+
+        return super.collection(name);
+    }
+
+    /**
+     * Clears all data from the default collection. Named collections are kept.
      * @returns {Database} Returns the database instance for chaining
      */
     clear() {
@@ -185,6 +298,12 @@ class Database extends FastDB {
             throw new TypeError('Key must be a string');
         }
         
+        // Numeric arrays are appended natively without a JSON round trip
+        if (typeof element === 'number') {
+            const length = super.append(key, element);
+            if (length !== null) return length;
+        }
+        
         let arr = this.get(key, '[]');
         if (typeof arr === 'string') {
             try {
@@ -203,6 +322,21 @@ class Database extends FastDB {
         return arr.length;
     }
 
+    /**
+     * Appends numbers to a numeric array created with a Float64Array or Int32Array value
+     * @param {string} key The key of the numeric array
+     * @param {number|number[]|Float64Array|Int32Array} values The numbers to append
+     * @returns {number|null} The new length, or null if the key does not hold a numeric array
+     * @throws {TypeError} If key is not a string
+     */
+    append(key, values) {
+        if (typeof key !== 'string') {
+            throw new TypeError('Key must be a string');
+        }
+
+        return super.append(key, values);
+    }
+
     /**
      * Removes all instances of an element from an array
      * @param {string} key The key of the array (supports dot notation)
@@ -289,6 +423,52 @@ class Database extends FastDB {
         return this.save();
     }
 
+    /**
+     * Compiles the default collection into an immutable file indexed by a
+     * minimal perfect hash. Opening that file maps it read-only instead of
+     * loading it, so open time is constant and lookups do no parsing.
+     * @param {string} filename The output filename
+     * @returns {number} The number of keys written
+     * @throws {Error} If the filename is not provided or the file cannot be written
+     */
+    compile(filename) {
+        if (typeof filename !== 'string' || !filename) {
+            throw new TypeError('Compile filename is required');
+        }
+        return super.compile(filename);
+    }
+
+    /**
+     * Writes sorted [key, value] pairs to an immutable sorted table file
+     * that ingest() can link into a database. Needs no open database, so
+     * files can be built offline, in workers or on another machine.
+     * @param {Array<[string, *]>} entries Pairs sorted by key in UTF-8 byte order, without duplicates
+     * @param {string} filename The output filename
+     * @param {{bloomBitsPerKey?: number}} [options] Bloom filter bits per key (default 10, 0 disables)
+     * @returns {number} The number of entries written
+     * @throws {RangeError} If the keys are not strictly ascending
+     */
+    static buildFile(entries, filename, options = {}) {
+        if (typeof filename !== 'string' || !filename) {
+            throw new TypeError('Output filename is required');
+        }
+        return super.buildFile(entries, filename, options);
+    }
+
+    /**
+     * Links a file written by Database.buildFile() into the database without
+     * loading or re-inserting its entries. Its keys override existing values.
+     * @param {string} filename The sorted table file
+     * @returns {number} The number of entries in the ingested file
+     * @throws {Error} If the file is not a sorted table or cannot be linked
+     */
+    ingest(filename) {
+        if (typeof filename !== 'string' || !filename) {
+            throw new TypeError('Ingest filename is required');
+        }
+        return super.ingest(filename);
+    }
+
     /**
      * Creates a backup of the database to a JSON file with metadata
      * @param {string} filename The backup filename
@@ -317,6 +497,165 @@ class Database extends FastDB {
         }
     }
 
+    /**
+     * Restores the database to its state at an earlier point by replaying
+     * the retained log forward from the nearest checkpoint. Needs the `wal`
+     * and `retainCheckpoints` options.
+     * @param {{sequence?: number, timestamp?: number|Date}} target A log sequence number, or a time
+     * @returns {{sequence: number, timestamp: number, checkpoint: number, records: number}} The last record applied, the checkpoint started from and the records replayed
+     */
+    restoreTo(target) {
+        if (target && target.timestamp instanceof Date) {
+            target = { timestamp: target.timestamp.getTime() };
+        }
+        return super.restoreTo(target);
+    }
+
+    /**
+     * Turns a follower into the leader: applies the rest of the log and
+     * takes it over, so writes are accepted from then on. Call it only once
+     * the old leader has stopped.
+     * @returns {boolean} Whether the log could be taken over
+     */
+    promote() {
+        clearInterval(this._followInterval);
+        this._followInterval = null;
+        const promoted = super.promote();
+        this.options.follow = false;
+        this.options.wal = true;
+        return promoted;
+    }
+
+    /**
+     * Serves the database to Redis clients (RESP) from a background I/O
+     * thread. Supported commands: GET, SET, DEL, EXISTS, MGET, INCRBY, SCAN,
+     * PING and QUIT. Pipelined commands run in batches on this thread, and
+     * without a write-ahead log each batch's writes are saved together.
+     * The server keeps the process alive until stopServer().
+     * @param {Object} [options]
+     * @param {number} [options.port=6379] TCP port; 0 picks a free one
+     * @param {string} [options.host='127.0.0.1'] IPv4 address to listen on
+     * @returns {number} The port the server is listening on
+     * @throws {Error} If a server is already running or the port cannot be bound
+     */
+    startServer(options = {}) {
+        if (typeof options !== 'object' || options === null) {
+            throw new TypeError('Server options must be an object');
+        }
+        if (options.host !== undefined && typeof options.host !== 'string') {
+            throw new TypeError('host must be a string');
+        }
+        return super.startServer(options);
+    }
+
+    /**
+     * Stops the RESP server and closes its connections
+     * @returns {boolean} Whether a server was running
+     */
+    stopServer() {
+        return super.stopServer();
+    }
+
+    /**
+     * Streams a snapshot of the database to a file on a background thread,
+     * using constant memory regardless of size. Writes made after the call
+     * are not included.
+     * @param {string} filename The output filename
+     * @param {Object} [options]
+     * @param {'ndjson'|'binary'} [options.format='ndjson'] One JSON object per line, or a FastDB data file
+     * @param {function({entries: number, total: number, bytes: number}): void} [options.onProgress] Called as the export advances
+     * @returns {Promise<{entries: number, bytes: number}>} Resolves once the file is complete
+     */
+    exportTo(filename, options = {}) {
+        if (typeof filename !== 'string' || !filename) {
+            return Promise.reject(new TypeError('Export filename is required'));
+        }
+        try {
+            return super.exportTo(filename, options);
+        } catch (error) {
+            return Promise.reject(error);
+        }
+    }
+
+    /**
+     * Projects the records under a nested path (e.g. `orders` for keys like
+     * `orders.<id>.total`) into a columnar file for analytics: one row per
+     * record, an `id` column plus one typed column per field. Numeric fields
+     * become float64, `true`/`false` fields booleans, everything else
+     * dictionary-encoded strings.
+     * @param {string} path The nested path holding the records
+     * @param {string} filename The output filename
+     * @returns {{rows: number, columns: number}} What was written
+     */
+    exportColumns(path, filename) {
+        if (typeof path !== 'string' || !path) {
+            throw new TypeError('Nested path is required');
+        }
+        if (typeof filename !== 'string' || !filename) {
+            throw new TypeError('Output filename is required');
+        }
+        return super.exportColumns(path, filename);
+    }
+
+    /**
+     * Opens a file written by exportColumns(). Column buffers are typed array
+     * views over the file contents, so nothing is copied or parsed per row.
+     * @param {string} filename The columnar file
+     * @returns {{rows: number, columns: Object.<string, Object>}} Columns by name; each has `type`,
+     *   `nulls`, `validity` (Uint8Array bitmap or null) and `values` (Float64Array, Uint8Array bitmap or
+     *   Int32Array dictionary indices); dictionary columns also have `dictionary` (string[]) and the id
+     *   column has `offsets`/`data` plus `get(i)`
+     */
+    static readColumns(filename) {
+        const fs = require('fs');
+        let buffer = fs.readFileSync(filename);
+        if (buffer.toString('latin1', 0, 6) !== 'FSTCOL' || buffer.readUInt16LE(6) !== 1) {
+            throw new Error('Not a columnar file: ' + filename);
+        }
+        if (buffer.byteOffset % 8 !== 0) {
+            buffer = Buffer.from(buffer);
+        }
+        const schemaLength = buffer.readUInt32LE(8);
+        const schema = JSON.parse(buffer.toString('utf8', 12, 12 + schemaLength));
+        const view = (Type, ref) => ref
+            ? new Type(buffer.buffer, buffer.byteOffset + ref[0], ref[1] / Type.BYTES_PER_ELEMENT)
+            : null;
+        const decoder = new TextDecoder();
+        const strings = (offsets, data, count) => {
+            const result = new Array(count);
+            for (let i = 0; i < count; i++) {
+                result[i] = decoder.decode(data.subarray(offsets[i], offsets[i + 1]));
+            }
+            return result;
+        };
+
+        const columns = {};
+        for (const column of schema.columns) {
+            if (column.type === 'utf8') {
+                const offsets = view(Int32Array, column.offsets);
+                const data = view(Uint8Array, column.data) || new Uint8Array(0);
+                columns[column.name] = {
+                    type: 'utf8', nulls: 0, validity: null, offsets, data,
+                    get: i => decoder.decode(data.subarray(offsets[i], offsets[i + 1]))
+                };
+                continue;
+            }
+            const Type = column.type === 'float64' ? Float64Array : column.type === 'bool' ? Uint8Array : Int32Array;
+            const result = {
+                type: column.type,
+                nulls: column.nulls,
+                validity: view(Uint8Array, column.validity),
+                values: view(Type, column.values) || new Type(0)
+            };
+            if (column.type === 'dictionary') {
+                const { size, offsets, data } = column.dictionary;
+                result.dictionary = strings(view(Int32Array, offsets), view(Uint8Array, data) || new Uint8Array(0), size);
+            }
+            columns[column.name] = result;
+        }
+        return { rows: schema.rows, columns };
+    }
+
     /**
      * Returns all data as a plain JavaScript object
      * @returns {Object.<string, any>} All database data as key-value pairs
@@ -326,7 +665,7 @@ class Database extends FastDB {
         const result = {};
         
         for (const item of all) {
-            result[item.key] = item.value;
+            result[item.key] = ArrayBuffer.isView(item.value) ? Array.from(item.value) : item.value;
         }
         
         return result;
@@ -421,6 +760,22 @@ class Database extends FastDB {
             }
         }, this.options.snapshots.interval);
     }
+
+    /**
+     * Start applying the leader's log in the background (internal method)
+     * @private
+     */
+    _initFollower() {
+        this._followInterval = setInterval(() => {
+            try {
+                this.catchUp();
+            } catch (error) {
+                console.error('Follower catch-up failed:', error.message);
+            }
+        }, this.options.followInterval);
+        // A follower alone must not keep the process alive
+        this._followInterval.unref();
+    }
 }
 
 module.exports = Database; 
\ No newline at end of file
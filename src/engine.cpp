@@ -0,0 +1,4707 @@
+#include "engine.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GLIBC__) || defined(_WIN32)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+#include <random>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FASTDB_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define FASTDB_NEON 1
+#endif
+
+namespace fastdb {
+
+static uint64_t mix64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t hashBytes(const char* key, size_t length, uint64_t seed) {
+    uint64_t h = 14695981039346656037ULL ^ seed;
+    for (size_t i = 0; i < length; i++) {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ULL;
+    }
+    return mix64(h);
+}
+
+uint32_t crc32(const char* data, size_t length) {
+    static uint32_t table[256];
+    static bool initialized = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)initialized;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+uint64_t nowMillis() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+bool syncFile(const std::string& path, LatencyHistogram* latency) {
+    LatencyTimer timer(latency);
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    bool success = FlushFileBuffers(handle) != 0;
+    CloseHandle(handle);
+    return success;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    bool success = fsync(fd) == 0;
+    ::close(fd);
+    return success;
+#endif
+}
+
+void syncDirectory(const std::string& path, LatencyHistogram* latency) {
+#ifndef _WIN32
+    LatencyTimer timer(latency);
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    fsync(fd);
+    ::close(fd);
+#else
+    (void)path;
+    (void)latency;
+#endif
+}
+
+bool replaceFile(const std::string& tmpPath, const std::string& path) {
+    if (std::rename(tmpPath.c_str(), path.c_str()) == 0) return true;
+    std::remove(path.c_str());
+    if (std::rename(tmpPath.c_str(), path.c_str()) == 0) return true;
+    std::remove(tmpPath.c_str());
+    return false;
+}
+
+// Position of the highest set bit of a nonzero value
+static int highestBit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(value);
+#else
+    int bit = 0;
+    while (value >>= 1) bit++;
+    return bit;
+#endif
+}
+
+LatencyHistogram::LatencyHistogram() : shards(new Shard[SHARDS]) {
+    reset();
+}
+
+size_t LatencyHistogram::bucketOf(uint64_t nanos) {
+    if (nanos < SUB_BUCKETS) return static_cast<size_t>(nanos);
+    nanos = std::min(nanos, (uint64_t(1) << MAX_EXPONENT) - 1);
+    int exponent = highestBit(nanos);
+    size_t sub = static_cast<size_t>(nanos >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketMax(size_t bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    int shift = static_cast<int>(bucket / SUB_BUCKETS) - 1;
+    uint64_t lowest = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return lowest + (uint64_t(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanos) {
+    // Threads are spread over the shards in the order they first record
+    static std::atomic<size_t> threads(0);
+    static thread_local size_t shardIndex = threads.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    Shard& shard = shards[shardIndex];
+    shard.buckets[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(nanos, std::memory_order_relaxed);
+    uint64_t max = shard.max.load(std::memory_order_relaxed);
+    while (nanos > max && !shard.max.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {}
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot merged;
+    merged.buckets.assign(BUCKETS, 0);
+    for (size_t i = 0; i < SHARDS; i++) {
+        const Shard& shard = shards[i];
+        for (size_t b = 0; b < BUCKETS; b++) merged.buckets[b] += shard.buckets[b].load(std::memory_order_relaxed);
+        merged.count += shard.count.load(std::memory_order_relaxed);
+        merged.sum += shard.sum.load(std::memory_order_relaxed);
+        merged.max = std::max(merged.max, shard.max.load(std::memory_order_relaxed));
+    }
+    return merged;
+}
+
+void LatencyHistogram::reset() {
+    for (size_t i = 0; i < SHARDS; i++) {
+        Shard& shard = shards[i];
+        for (auto& bucket : shard.buckets) bucket.store(0, std::memory_order_relaxed);
+        shard.count.store(0, std::memory_order_relaxed);
+        shard.sum.store(0, std::memory_order_relaxed);
+        shard.max.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const {
+    if (count == 0) return 0;
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * static_cast<double>(count))));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < buckets.size(); b++) {
+        seen += buckets[b];
+        if (seen >= rank) return std::min(bucketMax(b), max);
+    }
+    return max;
+}
+
+HotKeySketch::HotKeySketch(size_t capacity) : capacity(capacity) {}
+
+void HotKeySketch::record(const std::string& key, bool write) {
+    auto found = positions.find(key);
+    size_t i;
+    bool added = false;
+    if (found != positions.end()) {
+        i = found->second;
+    } else if (heap.size() < capacity) {
+        i = heap.size();
+        added = true;
+        heap.emplace_back();
+        heap[i].key = key;
+        positions.emplace(key, i);
+    } else {
+        // Take over the least counted slot
+        i = 0;
+        positions.erase(heap[0].key);
+        heap[0].error = heap[0].count();
+        heap[0].reads = 0;
+        heap[0].writes = 0;
+        heap[0].key = key;
+        positions.emplace(key, 0);
+    }
+    if (write) {
+        heap[i].writes++;
+    } else {
+        heap[i].reads++;
+    }
+    // A new leaf counts 1 and may sit under higher counts; any other slot
+    // only grew, so it can only have to move down
+    if (added) {
+        siftUp(i);
+    } else {
+        siftDown(i);
+    }
+}
+
+void HotKeySketch::siftUp(size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (heap[parent].count() <= heap[i].count()) return;
+        std::swap(heap[i], heap[parent]);
+        positions[heap[i].key] = i;
+        positions[heap[parent].key] = parent;
+        i = parent;
+    }
+}
+
+void HotKeySketch::siftDown(size_t i) {
+    for (;;) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < heap.size() && heap[left].count() < heap[smallest].count()) smallest = left;
+        if (right < heap.size() && heap[right].count() < heap[smallest].count()) smallest = right;
+        if (smallest == i) return;
+        std::swap(heap[i], heap[smallest]);
+        positions[heap[i].key] = i;
+        positions[heap[smallest].key] = smallest;
+        i = smallest;
+    }
+}
+
+std::vector<HotKeySketch::Counter> HotKeySketch::top(size_t n) const {
+    std::vector<Counter> counters(heap);
+    n = std::min(n, counters.size());
+    std::partial_sort(counters.begin(), counters.begin() + n, counters.end(), [](const Counter& a, const Counter& b) {
+        return a.count() != b.count() ? a.count() > b.count() : a.key < b.key;
+    });
+    counters.resize(n);
+    return counters;
+}
+
+void HotKeySketch::clear() {
+    heap.clear();
+    positions.clear();
+}
+
+Engine::Engine()
+    : layoutChanged(false), memoryLimit(0), hotBytes(0), nextCoolDown(0), coldFileSize(0), promotions(0),
+      demotions(0), walEnabled(false), walSync(false), walCheckpointBytes(64 * 1024 * 1024), walFile(nullptr),
+      walBytes(0), walRecords(0), walSequence(0), checkpoints(0), recoveredRecords(0), truncatedBytes(0),
+      walFirstSequence(1), retainCheckpoints(0), bloomBitsPerKey(10), readOnly(false), runOnly(0), nextRunId(0),
+      runsDirty(false), loading(false), loadStarted(false), follower(false), followFirstSequence(0),
+      followOffset(0), followRecords(0), followReloads(0), autoSync(true), deferSave(false), savePending(false), logicalBytes(0),
+      bytesWritten(0), bytesRead(0), writtenTo(), readFrom(), logicalBy(), writtenBy(), readBy(),
+      ioOperation(OPERATION_COUNT), cacheHits(0), cacheMisses(0), changes(1), censusChanges(0),
+      slowLogThreshold(0), slowLogSize(128), slowLogged(0), tracing(false), inPhase(false), tracePhases(),
+      hotKeySampling(16), hotKeySketch(HOT_KEY_CAPACITY), hotKeysSince(std::chrono::steady_clock::now()) {}
+
+Engine::~Engine() {
+    closeLog();
+    if (coldFile.is_open()) {
+        coldFile.close();
+        std::remove(coldPath.c_str());
+    }
+}
+
+bool Engine::open(const std::string& filename, const Options& options, std::string& error) {
+    if (!configure(filename, options, error)) return false;
+    if (!loading) load();
+    return true;
+}
+
+// The addon checks the types and ranges itself to throw the matching JS
+// errors before calling this
+bool Engine::configure(const std::string& filename, const Options& options, std::string& error) {
+    if (!IsValidFilename(filename)) {
+        error = "Invalid filename";
+        return false;
+    }
+    if (options.checkpointBytes < 1) {
+        error = "checkpointBytes must be a positive number of bytes";
+        return false;
+    }
+    if (options.retainCheckpoints > 1000) {
+        error = "retainCheckpoints must be 0-1000";
+        return false;
+    }
+    if (options.retainCheckpoints > 0 && !options.wal) {
+        error = "retainCheckpoints requires the wal option";
+        return false;
+    }
+    if (options.follow && (options.wal || options.readOnly || options.deferLoad || options.memoryLimit > 0)) {
+        error = "follow cannot be combined with wal, readOnly, deferLoad or memoryLimit";
+        return false;
+    }
+    if (options.bloomBitsPerKey > 64) {
+        error = "bloomBitsPerKey must be 0-64";
+        return false;
+    }
+    if (options.partitions < 1 || options.partitions > 256) {
+        error = "partitions must be 1-256";
+        return false;
+    }
+    if (!(options.slowLogThreshold >= 0)) {
+        error = "slowLogThreshold must be a number of milliseconds";
+        return false;
+    }
+    if (options.slowLogSize < 1 || options.slowLogSize > 100000) {
+        error = "slowLogSize must be 1-100000";
+        return false;
+    }
+    if (options.hotKeySampling > 65536) {
+        error = "hotKeySampling must be 0-65536";
+        return false;
+    }
+    
+    this->filename = filename;
+    memoryLimit = options.memoryLimit;
+    readOnly = options.readOnly;
+    walEnabled = options.wal;
+    walSync = options.walSync;
+    walCheckpointBytes = options.checkpointBytes;
+    retainCheckpoints = options.retainCheckpoints;
+    follower = options.follow;
+    bloomBitsPerKey = options.bloomBitsPerKey;
+    autoSync = options.autoSync;
+    slowLogThreshold = static_cast<uint64_t>(options.slowLogThreshold * 1e6);
+    slowLogSize = options.slowLogSize;
+    hotKeySampling = options.hotKeySampling;
+    loading = options.deferLoad;
+    
+    if (options.partitions > 1) {
+        size_t slash = filename.find_last_of("/\\");
+        std::string base = slash == std::string::npos ? filename : filename.substr(slash + 1);
+        std::string home = slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+        
+        for (uint32_t i = 0; i < options.partitions; i++) {
+            std::string dir = home;
+            if (!options.directories.empty()) {
+                dir = options.directories[i % options.directories.size()];
+                if (!dir.empty() && dir.back() != '/' && dir.back() != '\\') dir += '/';
+            }
+            partitionPaths.push_back(dir + base + ".part" + std::to_string(i));
+        }
+        dirtyPartitions.assign(options.partitions, 0);
+    }
+    
+    if (memoryLimit > 0 && !readOnly) {
+        coldPath = filename + ".cold";
+        nextCoolDown = memoryLimit;
+        resetColdFile();
+    }
+    
+    // One log for the whole database: with partitions every write still
+    // appends to this file, next to the manifest, whatever directories say
+    if (walEnabled && !readOnly) walPath = filename + ".wal";
+    return true;
+}
+
+void Engine::load() {
+    if (follower) {
+        reloadFollower();
+        return;
+    }
+    LoadFromBinary();
+}
+
+const char* Engine::operationName(Operation op) {
+    static const char* const names[OPERATION_COUNT] = {
+        "get", "set", "nestedGet", "nestedSet", "save", "load", "compaction", "fsync"
+    };
+    return op < OPERATION_COUNT ? names[op] : "";
+}
+
+void Engine::resetLatency() {
+    for (auto& histogram : latency) histogram.reset();
+}
+
+const char* Engine::ioSourceName(IoSource source) {
+    static const char* const names[IO_SOURCE_COUNT] = { "log", "data", "checkpoint", "cold", "compaction" };
+    return source < IO_SOURCE_COUNT ? names[source] : "";
+}
+
+void Engine::countLogical(uint64_t bytes) {
+    logicalBytes += bytes;
+    if (ioOperation < OPERATION_COUNT) logicalBy[ioOperation] += bytes;
+}
+
+void Engine::countWrite(IoSource source, uint64_t bytes) {
+    bytesWritten += bytes;
+    writtenTo[source] += bytes;
+    if (ioOperation < OPERATION_COUNT) writtenBy[ioOperation] += bytes;
+}
+
+void Engine::countRead(IoSource source, uint64_t bytes, Operation op) {
+    bytesRead += bytes;
+    readFrom[source] += bytes;
+    if (op < OPERATION_COUNT) readBy[op] += bytes;
+}
+
+MappedStore::BloomCounts Engine::bloomCounts() const {
+    MappedStore::BloomCounts total;
+    auto add = [&total](const MappedStore& store) {
+        MappedStore::BloomCounts counts = store.bloomCounts();
+        total.probes += counts.probes;
+        total.negatives += counts.negatives;
+        total.falsePositives += counts.falsePositives;
+    };
+    if (store) add(*store);
+    for (const auto& run : runs) add(*run);
+    return total;
+}
+
+Engine::IoStats Engine::ioStats() const {
+    IoStats stats;
+    stats.logical = logicalBytes.load();
+    stats.written = bytesWritten.load();
+    stats.read = bytesRead.load();
+    for (int i = 0; i < IO_SOURCE_COUNT; i++) {
+        stats.writtenTo[i] = writtenTo[i].load();
+        stats.readFrom[i] = readFrom[i].load();
+    }
+    for (int i = 0; i < OPERATION_COUNT; i++) {
+        stats.logicalBy[i] = logicalBy[i].load();
+        stats.writtenBy[i] = writtenBy[i].load();
+        stats.readBy[i] = readBy[i].load();
+    }
+    return stats;
+}
+
+// Bytes malloc takes for a request: glibc rounds the request plus its size
+// header up to 16 bytes, with a 32-byte minimum. Allocators that round
+// differently report the real size through allocatedBytes instead.
+static uint64_t chunkBytes(size_t requested) {
+    return std::max<uint64_t>(32, (requested + sizeof(size_t) + 15) & ~static_cast<uint64_t>(15));
+}
+
+// Bytes the allocator holds for a live block of `requested` bytes
+static uint64_t allocatedBytes(const void* block, size_t requested) {
+#if defined(__GLIBC__)
+    (void)requested;
+    return malloc_usable_size(const_cast<void*>(block)) + sizeof(size_t);
+#elif defined(__APPLE__)
+    (void)requested;
+    return malloc_size(block);
+#elif defined(_WIN32)
+    (void)requested;
+    return _msize(const_cast<void*>(block)) + 2 * sizeof(void*);
+#else
+    (void)block;
+    return chunkBytes(requested);
+#endif
+}
+
+// Heap bytes behind a string; short strings live inside the object
+static uint64_t heapBytes(const std::string& text) {
+    static const size_t inlineCapacity = std::string().capacity();
+    return text.capacity() > inlineCapacity ? allocatedBytes(text.data(), text.capacity() + 1) : 0;
+}
+
+// A node holds the next pointer, the key and entry, and the cached hash
+static const size_t NODE_BYTES = sizeof(void*) + sizeof(Index::value_type) + sizeof(size_t);
+
+Engine::MemoryUsage Engine::memoryUsage() {
+    if (censusChanges == changes) return census;
+    
+    MemoryUsage usage;
+    auto count = [&](const Index& index) {
+        usage.index += index.bucket_count() * sizeof(void*) + index.size() * chunkBytes(NODE_BYTES);
+        for (const auto& pair : index) {
+            usage.keys += heapBytes(pair.first);
+            if (pair.first == "__root__") {
+                usage.nestedDocument += heapBytes(pair.second.value);
+            } else {
+                usage.values += heapBytes(pair.second.value);
+            }
+            usage.coldLive += pair.second.coldLength;
+        }
+    };
+    count(data);
+    for (const auto& pair : collections) {
+        usage.keys += heapBytes(pair.first);
+        count(pair.second);
+    }
+    census = usage;
+    censusChanges = changes;
+    return usage;
+}
+
+bool Engine::keyMemory(const std::string& key, KeyMemory& out) {
+    out = KeyMemory();
+    if (key.find('.') != std::string::npos) {
+        std::vector<std::string> path = splitPath(key);
+        SimpleJSON::Value root;
+        if (path.empty() || !(store ? findStoredRoot(root) : loadRoot(data, root))) return false;
+        std::string subtree = getNestedProperty(root, path);
+        if (subtree.empty()) return false;
+        out.value = subtree.size();
+        return true;
+    }
+    
+    RecordView record;
+    if (store) {
+        if (!store->find(key.data(), key.size(), record)) return false;
+        out.disk = record.valueLength;
+        return true;
+    }
+    auto it = data.find(key);
+    if (it == data.end()) {
+        if (!findInRuns(key, record)) return false;
+        out.disk = record.valueLength;
+        return true;
+    }
+    out.key = heapBytes(it->first);
+    out.value = heapBytes(it->second.value);
+    out.disk = it->second.coldLength;
+    out.node = chunkBytes(NODE_BYTES) + data.bucket_count() * sizeof(void*) / data.size();
+    return true;
+}
+
+Engine::MemoryReport Engine::memoryReport(uint32_t depth, char separator, size_t samples, size_t limit) {
+    MemoryReport report;
+    report.totalKeys = data.size() - data.count("__root__");
+    auto finish = [limit](std::unordered_map<std::string, MemoryGroup>& groups, std::vector<MemoryGroup>& out) {
+        for (auto& pair : groups) out.push_back(std::move(pair.second));
+        std::sort(out.begin(), out.end(), [](const MemoryGroup& a, const MemoryGroup& b) {
+            return a.bytes != b.bytes ? a.bytes > b.bytes : a.prefix < b.prefix;
+        });
+        if (out.size() > limit) out.resize(limit);
+    };
+    
+    std::unordered_map<std::string, MemoryGroup> prefixes;
+    const uint64_t nodeBytes = chunkBytes(NODE_BYTES);
+    auto visit = [&](const Index::value_type& pair) {
+        if (pair.first == "__root__") return;
+        size_t end = 0;
+        for (uint32_t part = 0; part < depth && end != std::string::npos; part++) {
+            end = pair.first.find(separator, part ? end + 1 : 0);
+        }
+        std::string prefix = pair.first.substr(0, end);
+        MemoryGroup& group = prefixes[prefix];
+        if (group.keys++ == 0) group.prefix = std::move(prefix);
+        group.bytes += nodeBytes + heapBytes(pair.first) + heapBytes(pair.second.value);
+        report.sampledKeys++;
+    };
+    if (data.size() <= samples) {
+        for (const auto& pair : data) visit(pair);
+    } else if (samples > 0) {
+        // Whole buckets at random: every key is equally likely to be picked,
+        // and no walk over the index is needed to find the n-th one
+        std::mt19937_64 random(static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+        size_t buckets = data.bucket_count();
+        for (size_t attempt = 0; report.sampledKeys < samples && attempt < samples * 8; attempt++) {
+            size_t bucket = static_cast<size_t>(random() % buckets);
+            for (auto it = data.cbegin(bucket); it != data.cend(bucket); ++it) visit(*it);
+        }
+    }
+    if (report.sampledKeys > 0 && report.sampledKeys < report.totalKeys) {
+        double scale = static_cast<double>(report.totalKeys) / static_cast<double>(report.sampledKeys);
+        for (auto& pair : prefixes) {
+            pair.second.keys = static_cast<uint64_t>(pair.second.keys * scale + 0.5);
+            pair.second.bytes = static_cast<uint64_t>(pair.second.bytes * scale + 0.5);
+        }
+    }
+    finish(prefixes, report.prefixes);
+    
+    // The nested document, by path: the serialized size of each subtree and
+    // the number of leaves under it
+    SimpleJSON::Value root;
+    if (depth > 0 && !store && loadRoot(data, root) && root.type == SimpleJSON::Value::OBJECT) {
+        std::unordered_map<std::string, MemoryGroup> paths;
+        std::function<uint64_t(const SimpleJSON::Value&)> leaves = [&](const SimpleJSON::Value& value) -> uint64_t {
+            uint64_t count = 0;
+            if (value.type == SimpleJSON::Value::OBJECT) {
+                for (const auto& child : value.object_value) count += leaves(child.second);
+            } else if (value.type == SimpleJSON::Value::ARRAY) {
+                for (const auto& child : value.array_value) count += leaves(child);
+            }
+            return count ? count : 1;
+        };
+        std::function<void(const SimpleJSON::Value&, const std::string&, uint32_t)> walk =
+            [&](const SimpleJSON::Value& value, const std::string& path, uint32_t level) {
+            for (const auto& child : value.object_value) {
+                std::string childPath = path.empty() ? child.first : path + "." + child.first;
+                if (level + 1 < depth && child.second.type == SimpleJSON::Value::OBJECT) {
+                    walk(child.second, childPath, level + 1);
+                    continue;
+                }
+                MemoryGroup& group = paths[childPath];
+                group.prefix = childPath;
+                group.keys = leaves(child.second);
+                group.bytes = SimpleJSON::stringify(child.second).size();
+            }
+        };
+        walk(root, "", 0);
+        finish(paths, report.nestedPaths);
+    }
+    return report;
+}
+
+std::string Engine::metricsText() {
+    std::string out;
+    char number[32];
+    auto family = [&](const char* name, const char* type, const char* unit, const char* help) {
+        out += "# TYPE ";
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+        if (*unit) {
+            out += "# UNIT ";
+            out += name;
+            out += ' ';
+            out += unit;
+            out += '\n';
+        }
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += help;
+        out += '\n';
+    };
+    auto sample = [&](const std::string& name, const std::string& labels, double value) {
+        out += name;
+        if (!labels.empty()) out += '{' + labels + '}';
+        if (std::isnan(value)) {
+            out += " NaN\n";
+            return;
+        }
+        snprintf(number, sizeof(number), " %.9g\n", value);
+        out += number;
+    };
+    auto ratio = [](uint64_t part, uint64_t whole) {
+        return whole > 0 ? static_cast<double>(part) / static_cast<double>(whole) : std::nan("");
+    };
+    
+    family("fastdb_operation_latency_seconds", "summary", "seconds", "Latency of operations run by the engine.");
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    uint64_t compactions = 0;
+    for (int i = 0; i < OPERATION_COUNT; i++) {
+        Operation op = static_cast<Operation>(i);
+        LatencyHistogram::Snapshot snapshot = latencyOf(op);
+        if (op == OP_COMPACTION) compactions = snapshot.count;
+        std::string label = std::string("operation=\"") + operationName(op) + "\"";
+        for (double q : quantiles) {
+            snprintf(number, sizeof(number), "%g", q);
+            sample("fastdb_operation_latency_seconds", label + ",quantile=\"" + number + "\"",
+                   static_cast<double>(snapshot.percentile(q)) / 1e9);
+        }
+        sample("fastdb_operation_latency_seconds_sum", label, static_cast<double>(snapshot.sum) / 1e9);
+        sample("fastdb_operation_latency_seconds_count", label, static_cast<double>(snapshot.count));
+    }
+    
+    family("fastdb_keys", "gauge", "", "Keys in the default collection.");
+    sample("fastdb_keys", "", static_cast<double>(size()));
+    
+    uint64_t logical = logicalBytes.load();
+    uint64_t written = bytesWritten.load();
+    family("fastdb_logical_write_bytes", "counter", "bytes", "Bytes of keys and values mutated by writes.");
+    sample("fastdb_logical_write_bytes_total", "", static_cast<double>(logical));
+    family("fastdb_written_bytes", "counter", "bytes", "Bytes written to the data files, the log and the cold file.");
+    sample("fastdb_written_bytes_total", "", static_cast<double>(written));
+    family("fastdb_read_bytes", "counter", "bytes", "Bytes read from the data files, the log and the cold file.");
+    sample("fastdb_read_bytes_total", "", static_cast<double>(bytesRead.load()));
+    family("fastdb_write_amplification_ratio", "gauge", "ratio", "Bytes written per byte mutated.");
+    sample("fastdb_write_amplification_ratio", "", ratio(written, logical));
+    
+    IoStats io = ioStats();
+    auto label = [](const char* name, const char* value) { return std::string(name) + "=\"" + value + '"'; };
+    family("fastdb_source_written_bytes", "counter", "bytes", "Bytes written, by file and purpose.");
+    for (int i = 0; i < IO_SOURCE_COUNT; i++) {
+        sample("fastdb_source_written_bytes_total", label("source", ioSourceName(static_cast<IoSource>(i))),
+               static_cast<double>(io.writtenTo[i]));
+    }
+    family("fastdb_source_read_bytes", "counter", "bytes", "Bytes read, by file and purpose.");
+    for (int i = 0; i < IO_SOURCE_COUNT; i++) {
+        sample("fastdb_source_read_bytes_total", label("source", ioSourceName(static_cast<IoSource>(i))),
+               static_cast<double>(io.readFrom[i]));
+    }
+    family("fastdb_operation_written_bytes", "counter", "bytes", "Bytes written on behalf of each operation.");
+    for (int i = 0; i < OP_FSYNC; i++) {
+        sample("fastdb_operation_written_bytes_total", label("operation", operationName(static_cast<Operation>(i))),
+               static_cast<double>(io.writtenBy[i]));
+    }
+    
+    MappedStore::BloomCounts bloom = bloomCounts();
+    family("fastdb_bloom_probes", "counter", "", "Bloom filter probes of lookups served from disk.");
+    sample("fastdb_bloom_probes_total", "", static_cast<double>(bloom.probes));
+    family("fastdb_bloom_negatives", "counter", "", "Lookups the Bloom filter answered as absent.");
+    sample("fastdb_bloom_negatives_total", "", static_cast<double>(bloom.negatives));
+    family("fastdb_bloom_false_positives", "counter", "", "Keys the Bloom filter let through that were absent.");
+    sample("fastdb_bloom_false_positives_total", "", static_cast<double>(bloom.falsePositives));
+    
+    MemoryUsage memory = memoryUsage();
+    family("fastdb_memory_bytes", "gauge", "bytes", "Heap bytes held by the in-memory indexes.");
+    sample("fastdb_memory_bytes", "component=\"index\"", static_cast<double>(memory.index));
+    sample("fastdb_memory_bytes", "component=\"keys\"", static_cast<double>(memory.keys));
+    sample("fastdb_memory_bytes", "component=\"values\"", static_cast<double>(memory.values));
+    sample("fastdb_memory_bytes", "component=\"nested_document\"", static_cast<double>(memory.nestedDocument));
+    
+    family("fastdb_cache_hits", "counter", "", "Reads served from memory.");
+    sample("fastdb_cache_hits_total", "", static_cast<double>(cacheHits));
+    family("fastdb_cache_misses", "counter", "", "Reads that went to the cold file.");
+    sample("fastdb_cache_misses_total", "", static_cast<double>(cacheMisses));
+    family("fastdb_cache_hit_ratio", "gauge", "ratio", "Share of reads served from memory.");
+    sample("fastdb_cache_hit_ratio", "", ratio(cacheHits, cacheHits + cacheMisses));
+    
+    // Cold values are compacted once the garbage passes 64 MB and the live data
+    family("fastdb_cold_file_bytes", "gauge", "bytes", "Size of the cold file.");
+    sample("fastdb_cold_file_bytes", "", static_cast<double>(coldFileSize));
+    family("fastdb_cold_file_live_bytes", "gauge", "bytes", "Bytes of the cold file still referenced.");
+    sample("fastdb_cold_file_live_bytes", "", static_cast<double>(std::min<uint64_t>(memory.coldLive, coldFileSize)));
+    family("fastdb_compactions", "counter", "", "Cold file compactions.");
+    sample("fastdb_compactions_total", "", static_cast<double>(compactions));
+    
+    // A checkpoint rewrites the data files once the log reaches checkpointBytes
+    family("fastdb_wal_bytes", "gauge", "bytes", "Size of the write-ahead log.");
+    sample("fastdb_wal_bytes", "", static_cast<double>(walPath.empty() ? 0 : walBytes));
+    family("fastdb_checkpoint_progress_ratio", "gauge", "ratio", "Share of checkpointBytes the log has reached.");
+    sample("fastdb_checkpoint_progress_ratio", "", walPath.empty() ? 0 : ratio(walBytes, walCheckpointBytes));
+    family("fastdb_checkpoints", "counter", "", "Checkpoints taken.");
+    sample("fastdb_checkpoints_total", "", static_cast<double>(checkpoints));
+    
+    out += "# EOF\n";
+    return out;
+}
+
+Engine::OperationTimer::OperationTimer(Engine& engine, Operation op, const std::string* key)
+    : engine(engine), op(op), key(key), outermost(!engine.tracing), start(std::chrono::steady_clock::now()) {
+    if (!outermost) return;
+    engine.tracing = true;
+    engine.ioOperation = op;
+    std::fill(std::begin(engine.tracePhases), std::end(engine.tracePhases), 0);
+    if (key && engine.hotKeySampling > 0) engine.sampleHotKey(op, *key);
+}
+
+Engine::OperationTimer::~OperationTimer() {
+    uint64_t nanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    engine.latency[op].record(nanos);
+    if (!outermost) return;
+    engine.tracing = false;
+    engine.ioOperation = OPERATION_COUNT;
+    if (engine.slowLogThreshold > 0 && nanos >= engine.slowLogThreshold) engine.logSlowOperation(op, key, nanos);
+}
+
+Engine::PhaseTimer::PhaseTimer(Engine& engine, Phase phase)
+    : engine(engine), phase(phase), active(engine.tracing && !engine.inPhase && engine.slowLogThreshold > 0) {
+    if (!active) return;
+    engine.inPhase = true;
+    start = std::chrono::steady_clock::now();
+}
+
+Engine::PhaseTimer::~PhaseTimer() {
+    if (!active) return;
+    engine.tracePhases[phase] += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    engine.inPhase = false;
+}
+
+void Engine::logSlowOperation(Operation op, const std::string* key, uint64_t nanos) {
+    SlowOperation entry;
+    entry.id = slowLogged;
+    entry.timestamp = nowMillis();
+    entry.operation = op;
+    if (key) entry.key = key->substr(0, MAX_SLOW_KEY);
+    entry.nanos = nanos;
+    std::copy(std::begin(tracePhases), std::end(tracePhases), entry.phases);
+    if (slowOperations.size() < slowLogSize) {
+        slowOperations.push_back(std::move(entry));
+    } else {
+        slowOperations[slowLogged % slowLogSize] = std::move(entry);
+    }
+    slowLogged++;
+}
+
+std::vector<Engine::SlowOperation> Engine::slowLog() const {
+    std::vector<SlowOperation> entries;
+    entries.reserve(slowOperations.size());
+    for (size_t i = 1; i <= slowOperations.size(); i++) {
+        entries.push_back(slowOperations[(slowLogged - i) % slowLogSize]);
+    }
+    return entries;
+}
+
+void Engine::sampleHotKey(Operation op, const std::string& key) {
+    // xorshift rather than a counter, so a pattern that repeats every
+    // hotKeySampling operations cannot hide a key
+    static thread_local uint64_t state = 0x9e3779b97f4a7c15ULL;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    if (hotKeySampling > 1 && state % hotKeySampling != 0) return;
+    hotKeySketch.record(key, op == OP_SET || op == OP_NESTED_SET);
+}
+
+std::vector<Engine::HotKey> Engine::hotKeys(size_t n) const {
+    double scale = std::max<uint32_t>(hotKeySampling, 1);
+    double seconds = std::max(1e-3, std::chrono::duration<double>(std::chrono::steady_clock::now() - hotKeysSince).count());
+    std::vector<HotKey> keys;
+    for (const auto& counter : hotKeySketch.top(n)) {
+        HotKey key;
+        key.key = counter.key;
+        key.reads = counter.reads * scale;
+        key.writes = counter.writes * scale;
+        key.error = counter.error * scale;
+        key.readRate = key.reads / seconds;
+        key.writeRate = key.writes / seconds;
+        keys.push_back(std::move(key));
+    }
+    return keys;
+}
+
+void Engine::resetHotKeys() {
+    hotKeySketch.clear();
+    hotKeysSince = std::chrono::steady_clock::now();
+}
+
+void Engine::resetSlowLog() {
+    slowOperations.clear();
+    slowLogged = 0;
+}
+
+bool Engine::writable() const {
+    return !loading && !follower && !store;
+}
+
+Engine::WriteState Engine::writeState() const {
+    if (loading) return LOADING;
+    if (follower) return FOLLOWING;
+    return store ? READ_ONLY : WRITABLE;
+}
+
+Index* Engine::findCollection(const std::string& collection) {
+    if (collection.empty()) return &data;
+    auto it = collections.find(collection);
+    return it != collections.end() ? &it->second : nullptr;
+}
+
+const Index* Engine::findCollection(const std::string& collection) const {
+    if (collection.empty()) return &data;
+    auto it = collections.find(collection);
+    return it != collections.end() ? &it->second : nullptr;
+}
+
+void Engine::createCollection(const std::string& name) {
+    if (IsValidCollectionName(name)) collections[name];
+}
+
+std::vector<std::string> Engine::collectionNames() const {
+    std::vector<std::string> names;
+    names.reserve(collections.size());
+    for (const auto& pair : collections) names.push_back(pair.first);
+    return names;
+}
+
+bool Engine::dropCollection(const std::string& name) {
+    if (!writable() || collections.erase(name) == 0) return false;
+    markAllDirty();
+    persistIn(LOG_DROP, name, std::string(), nullptr);
+    return true;
+}
+
+bool Engine::lookup(const std::string& collection, const std::string& key, RecordView& out, std::string& scratch) {
+    OperationTimer timer(*this, OP_GET, &key);
+    // The default collection of a mapped file lives in the mapping
+    bool mapped = store && collection.empty();
+    Index* index = mapped ? nullptr : findCollection(collection);
+    if (key.find('.') != std::string::npos) {
+        timer.retarget(OP_NESTED_GET);
+        std::vector<std::string> path = splitPath(key);
+        SimpleJSON::Value root;
+        bool found = !path.empty() && (mapped ? findStoredRoot(root) : index && loadRoot(*index, root));
+        if (!found) return false;
+        scratch = getNestedProperty(root, path);
+        out = { key.data(), key.size(), scratch.data(), scratch.size(), Entry::STRING };
+        return !scratch.empty();
+    }
+    
+    if (mapped) return store->find(key.data(), key.size(), out);
+    if (!index) return false;
+    Index::iterator it;
+    {
+        PhaseTimer phase(*this, PHASE_LOOKUP);
+        it = index->find(key);
+    }
+    if (it != index->end()) {
+        const Entry& entry = touch(it->second);
+        out = { key.data(), key.size(), entry.value.data(), entry.value.size(), entry.type };
+        return true;
+    }
+    return index == &data && findInRuns(key, out);
+}
+
+bool Engine::get(const std::string& key, std::string& value, Entry::Type* type) {
+    RecordView record;
+    std::string scratch;
+    if (!lookup(std::string(), key, record, scratch)) return false;
+    value.assign(record.value, record.valueLength);
+    if (type) *type = record.type;
+    return true;
+}
+
+bool Engine::put(const std::string& key, const std::string& value) {
+    if (!writable() || key.empty()) return false;
+    return setString(data, key, std::string(value));
+}
+
+bool Engine::put(const std::string& collection, const std::string& key, Entry&& entry) {
+    if (!writable() || key.empty() || (!collection.empty() && !IsValidCollectionName(collection))) return false;
+    Index& index = collection.empty() ? data : collections[collection];
+    if (!entry.isNumericArray()) return setString(index, key, std::move(entry.value));
+    
+    OperationTimer timer(*this, OP_SET, &key);
+    if (key.find('.') != std::string::npos) return false;
+    shadowRunKey(index, key);
+    Entry& stored = (index[key] = std::move(entry));
+    accountHot(stored.value.size(), &stored);
+    markDirty(key);
+    persist(LOG_PUT, index, key);
+    return true;
+}
+
+bool Engine::remove(const std::string& key) {
+    return writable() && eraseKey(data, key);
+}
+
+bool Engine::remove(const std::string& collection, const std::string& key) {
+    Index* index = findCollection(collection);
+    return writable() && index && eraseKey(*index, key);
+}
+
+bool Engine::contains(const std::string& key) {
+    return contains(std::string(), key);
+}
+
+bool Engine::contains(const std::string& collection, const std::string& key) {
+    if (!store || !collection.empty()) {
+        Index* index = findCollection(collection);
+        return index && containsKey(*index, key);
+    }
+    if (key.find('.') == std::string::npos) {
+        RecordView record;
+        return store->find(key.data(), key.size(), record);
+    }
+    std::vector<std::string> path = splitPath(key);
+    SimpleJSON::Value root;
+    return !path.empty() && findStoredRoot(root) && hasNestedProperty(root, path);
+}
+
+bool Engine::clear(const std::string& collection) {
+    if (!writable()) return false;
+    Index* index = findCollection(collection);
+    if (!index) return true;
+    index->clear();
+    if (index == &data) dropRuns();
+    markAllDirty();
+    persist(LOG_CLEAR, *index, std::string());
+    return true;
+}
+
+size_t Engine::size() const {
+    return size(std::string());
+}
+
+size_t Engine::size(const std::string& collection) const {
+    if (store && collection.empty()) return store->size();
+    const Index* index = findCollection(collection);
+    if (!index) return 0;
+    return index->size() + (index == &data ? static_cast<size_t>(runOnly) : 0);
+}
+
+void Engine::scan(const std::function<bool(std::string_view key, std::string_view value)>& visit) {
+    scan(std::string(), [&](const RecordView& record) {
+        return visit({ record.key, record.keyLength }, { record.value, record.valueLength });
+    });
+}
+
+void Engine::scan(const std::string& collection, const std::function<bool(const RecordView& record)>& visit,
+                  bool keysOnly) {
+    RecordView record;
+    if (store && collection.empty()) {
+        for (size_t i = 0; i < store->size() && store->at(i, record); i++) {
+            if (!visit(record)) return;
+        }
+        return;
+    }
+    Index* index = findCollection(collection);
+    if (!index) return;
+    std::string cold;
+    for (const auto& pair : *index) {
+        const Entry& entry = pair.second;
+        record = { pair.first.data(), pair.first.size(), entry.value.data(), entry.value.size(), entry.type };
+        if (entry.cold) {
+            if (!keysOnly) cold = readCold(entry);
+            record.value = keysOnly ? nullptr : cold.data();
+            record.valueLength = keysOnly ? valueSize(entry) : cold.size();
+        }
+        if (!visit(record)) return;
+    }
+    if (index != &data) return;
+    bool stopped = false;
+    forEachRunRecord([&](const RecordView& run) {
+        if (!stopped) stopped = !visit(run);
+    });
+}
+
+// Cursors below RUN_CURSOR are hash table buckets of the default index.
+// Keys that only live in sorted runs follow, with the run index and the
+// position in the run packed into the cursor. A mapped store is walked by
+// position. The index growing mid-scan can repeat or skip keys.
+uint64_t Engine::scanFrom(uint64_t cursor, size_t count, const std::function<void(const char* key, size_t length)>& visit) {
+    static const uint64_t RUN_CURSOR = 1ULL << 62;
+    static const int POSITION_BITS = 40;
+    
+    uint64_t next = 0;
+    size_t examined = 0;
+    RecordView record;
+    if (store) {
+        size_t size = store->size();
+        size_t position = static_cast<size_t>(cursor);
+        for (; position < size && examined < count; position++, examined++) {
+            if (store->at(position, record)) visit(record.key, record.keyLength);
+        }
+        return position < size ? position : 0;
+    }
+    
+    if (cursor < RUN_CURSOR) {
+        size_t bucket = static_cast<size_t>(cursor);
+        for (; bucket < data.bucket_count() && examined < count; bucket++) {
+            for (auto it = data.begin(bucket); it != data.end(bucket); ++it, examined++) {
+                visit(it->first.data(), it->first.size());
+            }
+        }
+        if (bucket < data.bucket_count()) {
+            next = bucket;
+        } else {
+            next = runs.empty() ? 0 : RUN_CURSOR;
+            cursor = next;
+        }
+    }
+    if (cursor >= RUN_CURSOR && examined < count) {
+        size_t run = static_cast<size_t>((cursor - RUN_CURSOR) >> POSITION_BITS);
+        size_t position = static_cast<size_t>(cursor & ((1ULL << POSITION_BITS) - 1));
+        next = 0;
+        for (; run < runs.size(); run++, position = 0) {
+            SSTableFile& file = *runs[run];
+            for (; position < file.size() && examined < count; position++, examined++) {
+                if (file.at(position, record) && runRecordVisible(run, record)) visit(record.key, record.keyLength);
+            }
+            if (position < file.size()) {
+                next = RUN_CURSOR + (static_cast<uint64_t>(run) << POSITION_BITS) + position;
+                break;
+            }
+        }
+    }
+    return next;
+}
+
+const Entry* Engine::numericArray(const std::string& key) {
+    if (!store) {
+        auto it = data.find(key);
+        if (it != data.end()) return it->second.isNumericArray() ? &touch(it->second) : nullptr;
+    }
+    RecordView record;
+    bool found = store ? store->find(key.data(), key.size(), record) : findInRuns(key, record);
+    if (!found || record.type == Entry::STRING) return nullptr;
+    storeScratch.value.assign(record.value, record.valueLength);
+    storeScratch.type = record.type;
+    return &storeScratch;
+}
+
+// JavaScript's ToInt32, as storing into an Int32Array does: the integer
+// part wrapped modulo 2^32, with NaN and infinities becoming 0
+static int32_t toInt32(double number) {
+    if (!std::isfinite(number)) return 0;
+    double wrapped = std::fmod(std::trunc(number), 4294967296.0);
+    if (wrapped < 0) wrapped += 4294967296.0;
+    return static_cast<int32_t>(static_cast<uint32_t>(wrapped));
+}
+
+// Grows the array in place; any copy of it in the cold file goes stale
+bool Engine::append(const std::string& key, const Entry& elements, size_t& length, std::string& error) {
+    if (!writable()) return false;
+    auto it = data.find(key);
+    RecordView record;
+    if (it == data.end() && findInRuns(key, record) && record.type != Entry::STRING) {
+        // Bring the array out of its sorted run so it can grow in place
+        shadowRunKey(data, key);
+        it = data.emplace(key, Entry(std::string(record.value, record.valueLength), record.type)).first;
+    }
+    if (it == data.end() || !it->second.isNumericArray() || !elements.isNumericArray()) return false;
+    
+    Entry& entry = touch(it->second);
+    size_t count = NumericArray::length(elements);
+    size_t added = count * NumericArray::elementSize(entry.type);
+    if (entry.value.size() + added > 10000000) {
+        error = "Value too large (max 10MB)";
+        return false;
+    }
+    if (elements.type == entry.type) {
+        entry.value += elements.value;
+    } else {
+        entry.value.reserve(entry.value.size() + added);
+        for (size_t i = 0; i < count; i++) {
+            if (entry.type == Entry::FLOAT64_ARRAY) {
+                int32_t source;
+                memcpy(&source, elements.value.data() + i * sizeof(source), sizeof(source));
+                double element = source;
+                entry.value.append(reinterpret_cast<const char*>(&element), sizeof(element));
+            } else {
+                double source;
+                memcpy(&source, elements.value.data() + i * sizeof(source), sizeof(source));
+                int32_t element = toInt32(source);
+                entry.value.append(reinterpret_cast<const char*>(&element), sizeof(element));
+            }
+        }
+    }
+    entry.coldLength = 0;
+    length = NumericArray::length(entry);
+    accountHot(added, &entry);
+    markDirty(key);
+    persist(LOG_PUT, data, key);
+    return true;
+}
+
+bool Engine::checkpoint() {
+    if (!writable()) return false;
+    savePending = false;
+    return SaveToBinary();
+}
+
+bool Engine::save() {
+    if (!writable()) return false;
+    markAllDirty();
+    return SaveToBinary();
+}
+
+bool Engine::reload() {
+    if (loading) return false;
+    return follower ? reloadFollower() : LoadFromBinary();
+}
+
+void Engine::beginBatch() {
+    deferSave = true;
+}
+
+bool Engine::endBatch() {
+    deferSave = false;
+    if (!savePending || !autoSync) return true;
+    savePending = false;
+    return SaveToBinary();
+}
+
+Engine::TierStats Engine::tierStats() const {
+    TierStats stats;
+    auto count = [&](const Index& index) {
+        for (const auto& pair : index) {
+            if (pair.second.cold) {
+                stats.coldBytes += pair.second.coldLength;
+                stats.coldEntries++;
+            } else {
+                stats.hotBytes += pair.second.value.size();
+            }
+        }
+    };
+    count(data);
+    for (const auto& pair : collections) count(pair.second);
+    stats.memoryLimit = memoryLimit;
+    stats.coldFileSize = coldFileSize;
+    stats.promotions = promotions;
+    stats.demotions = demotions;
+    return stats;
+}
+
+Engine::WalStats Engine::walStats() const {
+    WalStats stats;
+    stats.enabled = !walPath.empty();
+    stats.bytes = walPath.empty() ? 0 : walBytes;
+    stats.records = walRecords;
+    stats.sequence = walSequence;
+    stats.checkpoints = checkpoints;
+    stats.recoveredRecords = recoveredRecords;
+    stats.truncatedBytes = truncatedBytes;
+    stats.retainCheckpoints = retainCheckpoints;
+    stats.retainedCheckpoints = checkpointHistory.size();
+    stats.retainedSegments = logSegments.size();
+    if (!checkpointHistory.empty()) {
+        stats.oldestRestoreSequence = checkpointHistory.front().sequence;
+        stats.oldestRestoreTimestamp = checkpointHistory.front().timestamp;
+    }
+    return stats;
+}
+
+// FNV-1a, so a key always lands in the same partition file across runs
+static size_t partitionOfKey(const char* key, size_t length, size_t partitions) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(key[i]);
+        hash *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash % partitions);
+}
+
+int Engine::partitionOf(const std::string& key) const {
+    return static_cast<int>(partitionOfKey(key.data(), key.size(), partitionPaths.size()));
+}
+
+void Engine::markDirty(const std::string& key) {
+    changes++;
+    if (!partitionPaths.empty()) dirtyPartitions[partitionOf(key)] = 1;
+}
+
+void Engine::markAllDirty() {
+    changes++;
+    std::fill(dirtyPartitions.begin(), dirtyPartitions.end(), 1);
+}
+
+bool Engine::IsValidFilename(const std::string& filename) {
+    if (filename.empty() || filename.length() > 255) return false;
+    
+    std::string invalid_chars = "<>:\"|?*";
+    for (char c : invalid_chars) {
+        if (filename.find(c) != std::string::npos) return false;
+    }
+    return true;
+}
+
+void Engine::WriteString(std::ofstream& file, const std::string& str) {
+    if (!file.is_open()) return;
+    
+    uint32_t length = static_cast<uint32_t>(str.length());
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    if (length > 0) {
+        file.write(str.c_str(), length);
+    }
+}
+
+std::string Engine::ReadString(std::ifstream& file) {
+    if (!file.is_open()) return "";
+    
+    uint32_t length;
+    file.read(reinterpret_cast<char*>(&length), sizeof(length));
+    if (file.fail() || file.eof() || length > 10000000) return "";
+    
+    if (length == 0) return "";
+    
+    std::string str(length, '\0');
+    file.read(&str[0], length);
+    if (file.fail() || file.eof()) return "";
+    
+    return str;
+}
+
+bool Engine::SaveToBinary() {
+    OperationTimer timer(*this, OP_SAVE);
+    PhaseTimer phase(*this, PHASE_IO);
+    bool success = true;
+    
+    if (partitionPaths.empty()) {
+        success = WriteDataFile(filename, -1);
+    } else {
+        std::vector<std::thread> writers;
+        std::vector<char> results(partitionPaths.size(), 1);
+        for (size_t i = 0; i < partitionPaths.size(); i++) {
+            if (!dirtyPartitions[i]) continue;
+            writers.emplace_back([this, i, &results]() {
+                results[i] = WriteDataFile(partitionPaths[i], static_cast<int>(i));
+            });
+        }
+        for (auto& writer : writers) writer.join();
+        
+        for (size_t i = 0; i < partitionPaths.size(); i++) {
+            if (results[i]) {
+                dirtyPartitions[i] = 0;
+            } else {
+                success = false;
+            }
+        }
+        if (success && layoutChanged) {
+            success = WriteManifest();
+            if (success) layoutChanged = false;
+        }
+    }
+    
+    if (success && runsDirty) {
+        success = WriteRunsManifest();
+    }
+    
+    // A checkpoint is installed once its renames are durable; only then
+    // may the log it supersedes be replaced
+    if (success && !walPath.empty()) {
+        syncDirectory(filename, &latency[OP_FSYNC]);
+        for (const auto& path : partitionPaths) syncDirectory(path, &latency[OP_FSYNC]);
+        if (retainCheckpoints > 0) success = archiveCheckpoint();
+        success = success && startLog();
+        if (success) checkpoints++;
+    }
+    
+    // Files from a previous layout are removed once the new one is on disk
+    if (success && !obsoletePaths.empty()) {
+        for (const auto& path : obsoletePaths) std::remove(path.c_str());
+        obsoletePaths.clear();
+    }
+    return success;
+}
+
+// Writes one data file. partition is -1 for everything, otherwise only keys
+// hashing to that partition are written.
+// Files are written beside their target and renamed into place, so a reader
+// that has the old file mapped never sees it truncated or half written
+bool Engine::WriteDataFile(const std::string& path, int partition, bool withRuns) {
+    std::string tmpPath = path + ".tmp";
+    bool success = false;
+    try {
+        std::vector<char> buffer(1 << 16);
+        std::ofstream file;
+        file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        file.open(tmpPath, std::ios::binary | std::ios::trunc);
+        if (file.is_open()) {
+            success = WriteDataStream(file, partition, withRuns);
+            std::streamoff size = file.tellp();
+            file.close();
+            success = success && !file.fail();
+            if (success && size > 0) countWrite(walPath.empty() ? IO_DATA : IO_CHECKPOINT, static_cast<uint64_t>(size));
+        }
+    } catch (...) {
+        success = false;
+    }
+    if (success && !walPath.empty()) success = syncFile(tmpPath, &latency[OP_FSYNC]);
+    if (!success) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return replaceFile(tmpPath, path);
+}
+
+// withRuns also writes the visible run records, making the file a complete
+// copy of the database
+bool Engine::WriteDataStream(std::ofstream& file, int partition, bool withRuns) {
+    const char magic[] = "FSTDB";
+    file.write(magic, 5);
+    
+    uint32_t version = 4;
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    
+    if (!WriteEntries(file, data, partition, withRuns)) return false;
+    
+    uint32_t collectionCount = static_cast<uint32_t>(collections.size());
+    file.write(reinterpret_cast<const char*>(&collectionCount), sizeof(collectionCount));
+    for (const auto& pair : collections) {
+        WriteString(file, pair.first);
+        if (!WriteEntries(file, pair.second, partition)) return false;
+    }
+    
+    // v4 footer: Bloom filter over this file's default-collection keys
+    BloomFilter filter;
+    if (bloomBitsPerKey > 0) {
+        std::vector<const std::string*> keys;
+        keys.reserve(partition >= 0 ? data.size() / partitionPaths.size() : data.size());
+        for (const auto& pair : data) {
+            if (partition < 0 || partitionOf(pair.first) == partition) keys.push_back(&pair.first);
+        }
+        filter.init(keys.size() + (withRuns ? runOnly : 0), bloomBitsPerKey);
+        for (const std::string* key : keys) filter.add(key->data(), key->size());
+        if (withRuns) {
+            forEachRunRecord([&](const RecordView& record) { filter.add(record.key, record.keyLength); });
+        }
+    }
+    filter.write(file);
+    
+    file.flush();
+    return file.good();
+}
+
+bool Engine::WriteManifest() {
+    std::string tmpPath = filename + ".tmp";
+    try {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        
+        const char magic[] = "FSTDP";
+        file.write(magic, 5);
+        
+        uint32_t version = 1;
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        
+        uint32_t count = static_cast<uint32_t>(partitionPaths.size());
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& path : partitionPaths) {
+            WriteString(file, path);
+        }
+        
+        file.flush();
+        file.close();
+        if (file.fail() || (!walPath.empty() && !syncFile(tmpPath, &latency[OP_FSYNC]))) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return replaceFile(tmpPath, filename);
+    } catch (...) {
+        return false;
+    }
+}
+
+bool Engine::ReadManifest(std::ifstream& file, std::vector<std::string>& paths) {
+    uint32_t version;
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (file.fail() || version != 1) return false;
+    
+    uint32_t count;
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (file.fail() || count > 256) return false;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        std::string path = ReadString(file);
+        if (file.fail() || path.empty()) return false;
+        paths.push_back(std::move(path));
+    }
+    return true;
+}
+
+// Reads the magic of `filename` and, for a partitioned database, the
+// partition files its manifest lists
+bool Engine::ReadLayout(std::string& magic, std::vector<std::string>& loadedPaths) {
+    char buffer[6] = {0};
+    std::ifstream file(filename, std::ios::binary);
+    if (file.is_open()) {
+        file.read(buffer, 5);
+        if (!file.fail() && std::string(buffer) == "FSTDP" && !ReadManifest(file, loadedPaths)) {
+            return false;
+        }
+    }
+    magic = buffer;
+    return true;
+}
+
+// Common tail of synchronous and background loads, once the data files
+// are in memory
+bool Engine::FinishLoad(const std::vector<std::string>& loadedPaths) {
+    changes++;
+    bool success = LoadRuns();
+    if (!walPath.empty()) {
+        if (retainCheckpoints > 0 && !LoadHistory()) success = false;
+        if (!ReplayLog()) success = false;
+        if (retainCheckpoints > 0) {
+            // Sequences continue from the history even when the log was
+            // folded in by an open without it
+            uint64_t latest = checkpointHistory.empty() ? 0 : checkpointHistory.back().sequence;
+            if (!logSegments.empty()) latest = std::max(latest, logSegments.back().lastSequence);
+            if (latest > walSequence) {
+                walSequence = latest;
+                if (walRecords == 0 && !startLog()) success = false;
+            }
+            // Restores start from a checkpoint, so the first open takes one
+            if (checkpointHistory.empty() && !SaveToBinary()) success = false;
+        }
+    } else if (!readOnly && !follower && std::filesystem::exists(filename + ".wal")) {
+        // Opened without the log it was written with: fold the log into the
+        // data files so a later open with the log cannot replay stale records
+        walPath = filename + ".wal";
+        bool replayed = ReplayLog();
+        closeLog();
+        walPath.clear();
+        if (replayed && SaveToBinary()) {
+            std::remove((filename + ".wal").c_str());
+        } else {
+            success = false;
+        }
+    }
+    
+    // Switching layouts (single file <-> partitions, or a different
+    // partition count) rewrites everything on the next save
+    if (loadedPaths != partitionPaths) {
+        layoutChanged = !partitionPaths.empty();
+        markAllDirty();
+        for (const auto& path : loadedPaths) {
+            if (std::find(partitionPaths.begin(), partitionPaths.end(), path) == partitionPaths.end()) {
+                obsoletePaths.push_back(path);
+            }
+        }
+    }
+    return success;
+}
+
+// Engine deferred load
+
+Engine::LoadStart Engine::startLoad(std::vector<std::string>& paths, std::string& error) {
+    if (loadStarted) return LOAD_RUNNING;
+    if (!loading) return LOAD_NOT_DEFERRED;
+    
+    std::string magic;
+    loadingPaths.clear();
+    obsoletePaths.clear();
+    if (!ReadLayout(magic, loadingPaths) || magic == "FSTMP" || readOnly) {
+        // Nothing to stream: a broken manifest fails as in load(), and
+        // mapped files open in constant time
+        loading = false;
+        if (LoadFromBinary()) return LOAD_DONE;
+        error = "Failed to load " + filename;
+        return LOAD_FAILED;
+    }
+    
+    data.clear();
+    collections.clear();
+    store.reset();
+    if (memoryLimit > 0) resetColdFile();
+    paths = magic == "FSTDP" ? loadingPaths : std::vector<std::string>(1, filename);
+    loadStarted = true;
+    return LOAD_STREAM;
+}
+
+// Same format and first-wins rule as ReadDataFile. A file that does not
+// exist or is not a data file reads as empty.
+bool Engine::readLoadFile(const std::string& path, size_t batchSize,
+                          const std::function<void(std::unique_ptr<LoadBatch>)>& push,
+                          std::atomic<uint64_t>& bytes, std::atomic<uint64_t>& keys) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return true;
+    
+    char magic[6] = {0};
+    file.read(magic, 5);
+    if (file.fail() || std::string(magic) != "FSTDB") return true;
+    uint32_t version;
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (file.fail() || version < 1 || version > 4) return false;
+    
+    // Hands the batch over and starts a fresh one in the same section
+    std::unique_ptr<LoadBatch> batch(new LoadBatch());
+    auto flush = [&]() {
+        if (batch->entries.empty()) return;
+        std::unique_ptr<LoadBatch> fresh(new LoadBatch());
+        fresh->inCollection = batch->inCollection;
+        fresh->collection = batch->collection;
+        fresh->sectionCount = batch->sectionCount;
+        push(std::move(batch));
+        batch = std::move(fresh);
+    };
+    auto readSection = [&]() {
+        uint32_t count;
+        file.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (file.fail() || count > 10000000) return false;
+        batch->sectionCount = count;
+        batch->entries.reserve(std::min<size_t>(count, batchSize));
+        
+        for (uint32_t i = 0; i < count; i++) {
+            std::string key = ReadString(file);
+            uint8_t type = Entry::STRING;
+            if (version >= 2) file.read(reinterpret_cast<char*>(&type), sizeof(type));
+            std::string value = ReadString(file);
+            if (file.fail() || file.eof()) break;
+            
+            bytes += 2 * sizeof(uint32_t) + (version >= 2 ? 1 : 0) + key.size() + value.size();
+            if (type > Entry::INT32_ARRAY || key.empty()) continue;
+            if (batch->entries.emplace(std::move(key), Entry(std::move(value), static_cast<Entry::Type>(type))).second) keys++;
+            if (batch->entries.size() >= batchSize) {
+                flush();
+                batch->entries.reserve(batchSize);
+            }
+        }
+        return true;
+    };
+    
+    if (!readSection()) return false;
+    if (version >= 3) {
+        uint32_t collectionCount = 0;
+        file.read(reinterpret_cast<char*>(&collectionCount), sizeof(collectionCount));
+        for (uint32_t i = 0; i < collectionCount && !file.fail(); i++) {
+            std::string name = ReadString(file);
+            if (file.fail() || name.empty()) break;
+            flush();
+            batch->inCollection = true;
+            batch->collection = name;
+            if (!readSection()) break;
+        }
+    }
+    
+    flush();
+    return true;
+}
+
+// Batches are hash maps already, so merging only relinks nodes
+void Engine::mergeLoaded(std::vector<std::unique_ptr<LoadBatch>>& batches) {
+    if (!batches.empty()) changes++;
+    for (auto& batch : batches) {
+        Index& index = batch->inCollection ? collections[batch->collection] : data;
+        if (index.bucket_count() < batch->sectionCount) index.reserve(batch->sectionCount);
+        if (memoryLimit > 0) {
+            for (auto& pair : batch->entries) {
+                if (!index.count(pair.first)) admitLoaded(pair.second);
+            }
+        }
+        // Keys already present (an earlier file won) stay in the batch
+        index.merge(batch->entries);
+    }
+}
+
+bool Engine::finishLoad(bool read, uint64_t bytes, uint64_t nanos) {
+    bool success = read && FinishLoad(loadingPaths);
+    if (read) {
+        countRead(IO_DATA, bytes, OP_LOAD);
+        latency[OP_LOAD].record(nanos);
+    }
+    loading = false;
+    loadStarted = false;
+    return success;
+}
+
+bool Engine::LoadFromBinary() {
+    OperationTimer timer(*this, OP_LOAD);
+    PhaseTimer phase(*this, PHASE_IO);
+    changes++;
+    try {
+        std::vector<std::string> loadedPaths;
+        bool success = true;
+        obsoletePaths.clear();
+        
+        std::string magic;
+        if (!ReadLayout(magic, loadedPaths)) return false;
+        
+        data.clear();
+        collections.clear();
+        store.reset();
+        if (memoryLimit > 0) resetColdFile();
+        
+        if (magic == "FSTMP") {
+            std::unique_ptr<PerfectHashFile> compiled(new PerfectHashFile());
+            if (!compiled->open(filename)) return false;
+            store = std::move(compiled);
+            return true;
+        }
+        
+        if (readOnly) {
+            std::vector<std::string> paths = loadedPaths;
+            if (magic != "FSTDP") paths.assign(1, filename);
+            std::unique_ptr<MappedDataStore> mapped(new MappedDataStore());
+            success = mapped->open(paths, collections);
+            store = std::move(mapped);
+            return success;
+        }
+        
+        if (magic == "FSTDP") {
+            std::vector<Index> parts(loadedPaths.size());
+            std::vector<CollectionMap> partCollections(loadedPaths.size());
+            std::vector<char> results(loadedPaths.size(), 1);
+            std::vector<std::thread> readers;
+            for (size_t i = 0; i < loadedPaths.size(); i++) {
+                readers.emplace_back([this, i, &loadedPaths, &parts, &partCollections, &results]() {
+                    results[i] = ReadDataFile(loadedPaths[i], parts[i], partCollections[i]);
+                });
+            }
+            for (auto& reader : readers) reader.join();
+            
+            for (size_t i = 0; i < loadedPaths.size(); i++) {
+                if (!results[i]) success = false;
+                data.merge(parts[i]);
+                for (auto& pair : partCollections[i]) {
+                    collections[pair.first].merge(pair.second);
+                }
+            }
+        } else {
+            success = ReadDataFile(filename, data, collections);
+        }
+        
+        if (!FinishLoad(loadedPaths)) success = false;
+        return success;
+    } catch (...) {
+        data.clear();
+        collections.clear();
+        return false;
+    }
+}
+
+// The v4 Bloom filter footer is left unread: keys loaded into the index
+// are looked up there directly
+bool Engine::ReadDataFile(const std::string& path, Index& index, CollectionMap& cols) {
+    std::vector<char> buffer(1 << 16);
+    std::ifstream file;
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    file.open(path, std::ios::binary);
+    if (!file.is_open()) return true;
+    
+    char magic[6] = {0};
+    file.read(magic, 5);
+    if (file.fail() || std::string(magic) != "FSTDB") {
+        file.close();
+        return true;
+    }
+    
+    uint32_t version;
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (file.fail() || version < 1 || version > 4) {
+        file.close();
+        return false;
+    }
+    
+    if (!ReadEntries(file, version, index)) {
+        file.close();
+        return false;
+    }
+    
+    if (version >= 3) {
+        uint32_t collectionCount;
+        file.read(reinterpret_cast<char*>(&collectionCount), sizeof(collectionCount));
+        for (uint32_t i = 0; i < collectionCount && !file.fail(); i++) {
+            std::string name = ReadString(file);
+            if (file.fail() || name.empty()) break;
+            if (!ReadEntries(file, version, cols[name])) break;
+        }
+    }
+    
+    file.close();
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(path, error);
+    if (!error) countRead(IO_DATA, size);
+    return true;
+}
+
+// The count is patched in afterwards because a partition's share of the index
+// is only known once it has been filtered.
+bool Engine::WriteEntries(std::ofstream& file, const Index& index, int partition, bool withRuns) {
+    std::streampos countPos = file.tellp();
+    uint32_t count = 0;
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    
+    for (const auto& pair : index) {
+        if (partition >= 0 && partitionOf(pair.first) != partition) continue;
+        WriteString(file, pair.first);
+        uint8_t type = pair.second.type;
+        file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+        WriteString(file, pair.second.cold ? readCold(pair.second) : pair.second.value);
+        if (file.fail()) return false;
+        count++;
+    }
+    if (withRuns && &index == &data) {
+        forEachRunRecord([&](const RecordView& record) {
+            WriteString(file, std::string(record.key, record.keyLength));
+            uint8_t type = record.type;
+            file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+            WriteString(file, std::string(record.value, record.valueLength));
+            count++;
+        });
+    }
+    
+    std::streampos endPos = file.tellp();
+    file.seekp(countPos);
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.seekp(endPos);
+    return !file.fail();
+}
+
+// Reads one count-prefixed run of entries. Returns false when the count is
+// unreadable; a truncated run keeps the entries read so far.
+bool Engine::ReadEntries(std::ifstream& file, uint32_t version, Index& index) {
+    uint32_t count;
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (file.fail() || count > 10000000) return false;
+    
+    index.reserve(count);
+    
+    for (uint32_t i = 0; i < count; i++) {
+        std::string key = ReadString(file);
+        uint8_t type = Entry::STRING;
+        if (version >= 2) {
+            file.read(reinterpret_cast<char*>(&type), sizeof(type));
+        }
+        std::string value = ReadString(file);
+        
+        if (file.fail() || file.eof()) break;
+        if (type > Entry::INT32_ARRAY) continue;
+        if (!key.empty()) {
+            auto result = index.emplace(std::move(key), Entry(std::move(value), static_cast<Entry::Type>(type)));
+            if (result.second && memoryLimit > 0) admitLoaded(result.first->second);
+        }
+    }
+    return true;
+}
+
+bool Engine::IsValidCollectionName(const std::string& name) {
+    return !name.empty() && name.length() <= 255;
+}
+
+// Stores a string value. Dotted keys set a property of the nested root
+// document; false when that path cannot be set.
+bool Engine::setString(Index& index, const std::string& key, std::string&& value) {
+    OperationTimer timer(*this, OP_SET, &key);
+    // Handle nested properties with dot notation
+    if (key.find('.') != std::string::npos) {
+        timer.retarget(OP_NESTED_SET);
+        std::vector<std::string> path = splitPath(key);
+        if (!path.empty()) {
+            // Get current root data
+            SimpleJSON::Value root;
+            if (!loadRoot(index, root)) {
+                root.type = SimpleJSON::Value::OBJECT;
+            }
+            
+            // Set nested property
+            if (setNestedProperty(root, path, value)) {
+                shadowRunKey(index, "__root__");
+                std::string document;
+                {
+                    PhaseTimer phase(*this, PHASE_SERIALIZE);
+                    document = SimpleJSON::stringify(root);
+                }
+                Entry* slot;
+                {
+                    PhaseTimer phase(*this, PHASE_LOOKUP);
+                    slot = &index["__root__"];
+                }
+                Entry& stored = (*slot = std::move(document));
+                accountHot(stored.value.size(), &stored);
+                markDirty("__root__");
+                persist(LOG_PUT, index, "__root__");
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    shadowRunKey(index, key);
+    Entry* slot;
+    {
+        PhaseTimer phase(*this, PHASE_LOOKUP);
+        slot = &index[key];
+    }
+    Entry& stored = (*slot = std::move(value));
+    accountHot(stored.value.size(), &stored);
+    markDirty(key);
+    persist(LOG_PUT, index, key);
+    return true;
+}
+
+bool Engine::eraseKey(Index& index, const std::string& key) {
+    // Handle nested properties with dot notation
+    if (key.find('.') != std::string::npos) {
+        std::vector<std::string> path = splitPath(key);
+        SimpleJSON::Value root;
+        if (!path.empty() && loadRoot(index, root) && deleteNestedProperty(root, path)) {
+            shadowRunKey(index, "__root__");
+            index["__root__"] = SimpleJSON::stringify(root);
+            markDirty("__root__");
+            persist(LOG_PUT, index, "__root__");
+            return true;
+        }
+        return false;
+    }
+    
+    auto it = index.find(key);
+    if (it != index.end()) {
+        index.erase(it);
+        hideRunKey(index, key, false);
+        markDirty(key);
+        persist(LOG_DELETE, index, key);
+        return true;
+    }
+    
+    if (hideRunKey(index, key, true)) {
+        persist(LOG_DELETE, index, key);
+        return true;
+    }
+    
+    return false;
+}
+
+bool Engine::containsKey(Index& index, const std::string& key) {
+    // Handle nested properties with dot notation
+    if (key.find('.') != std::string::npos) {
+        std::vector<std::string> path = splitPath(key);
+        SimpleJSON::Value root;
+        return !path.empty() && loadRoot(index, root) && hasNestedProperty(root, path);
+    }
+    
+    RecordView record;
+    return index.find(key) != index.end() || (&index == &data && findInRuns(key, record));
+}
+
+SimpleJSON::Value SimpleJSON::parse(const std::string& json_str) {
+    size_t pos = 0;
+    skipWhitespace(json_str, pos);
+    if (pos >= json_str.length()) return Value();
+    return parseValue(json_str, pos);
+}
+
+std::string SimpleJSON::stringify(const Value& value) {
+    switch (value.type) {
+        case Value::STRING:
+            return "\"" + escapeString(value.string_value) + "\"";
+        case Value::NUMBER:
+            return std::to_string(value.number_value);
+        case Value::BOOLEAN:
+            return value.boolean_value ? "true" : "false";
+        case Value::NULL_VALUE:
+            return "null";
+        case Value::OBJECT: {
+            std::string result = "{";
+            bool first = true;
+            for (const auto& pair : value.object_value) {
+                if (!first) result += ",";
+                result += "\"" + escapeString(pair.first) + "\":" + stringify(pair.second);
+                first = false;
+            }
+            result += "}";
+            return result;
+        }
+        case Value::ARRAY: {
+            std::string result = "[";
+            bool first = true;
+            for (const auto& item : value.array_value) {
+                if (!first) result += ",";
+                result += stringify(item);
+                first = false;
+            }
+            result += "]";
+            return result;
+        }
+    }
+    return "null";
+}
+
+SimpleJSON::Value SimpleJSON::parseValue(const std::string& str, size_t& pos) {
+    skipWhitespace(str, pos);
+    if (pos >= str.length()) return Value();
+    
+    char c = str[pos];
+    if (c == '{') return parseObject(str, pos);
+    if (c == '[') return parseArray(str, pos);
+    if (c == '"') return Value(parseString(str, pos));
+    if (c == 't' || c == 'f') {
+        if (str.substr(pos, 4) == "true") {
+            pos += 4;
+            return Value(true);
+        }
+        if (str.substr(pos, 5) == "false") {
+            pos += 5;
+            return Value(false);
+        }
+    }
+    if (c == 'n' && str.substr(pos, 4) == "null") {
+        pos += 4;
+        return Value();
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        return Value(parseNumber(str, pos));
+    }
+    return Value();
+}
+
+SimpleJSON::Value SimpleJSON::parseObject(const std::string& str, size_t& pos) {
+    Value obj;
+    obj.type = Value::OBJECT;
+    pos++; // skip '{'
+    
+    skipWhitespace(str, pos);
+    if (pos < str.length() && str[pos] == '}') {
+        pos++;
+        return obj;
+    }
+    
+    while (pos < str.length()) {
+        skipWhitespace(str, pos);
+        if (pos >= str.length() || str[pos] != '"') break;
+        
+        std::string key = parseString(str, pos);
+        skipWhitespace(str, pos);
+        if (pos >= str.length() || str[pos] != ':') break;
+        pos++; // skip ':'
+        
+        Value value = parseValue(str, pos);
+        obj.object_value[key] = value;
+        
+        skipWhitespace(str, pos);
+        if (pos >= str.length()) break;
+        if (str[pos] == '}') {
+            pos++;
+            break;
+        }
+        if (str[pos] == ',') {
+            pos++;
+            continue;
+        }
+        break;
+    }
+    return obj;
+}
+
+SimpleJSON::Value SimpleJSON::parseArray(const std::string& str, size_t& pos) {
+    Value arr;
+    arr.type = Value::ARRAY;
+    pos++; // skip '['
+    
+    skipWhitespace(str, pos);
+    if (pos < str.length() && str[pos] == ']') {
+        pos++;
+        return arr;
+    }
+    
+    while (pos < str.length()) {
+        Value value = parseValue(str, pos);
+        arr.array_value.push_back(value);
+        
+        skipWhitespace(str, pos);
+        if (pos >= str.length()) break;
+        if (str[pos] == ']') {
+            pos++;
+            break;
+        }
+        if (str[pos] == ',') {
+            pos++;
+            continue;
+        }
+        break;
+    }
+    return arr;
+}
+
+std::string SimpleJSON::parseString(const std::string& str, size_t& pos) {
+    if (pos >= str.length() || str[pos] != '"') return "";
+    pos++; // skip opening quote
+    
+    std::string result;
+    while (pos < str.length() && str[pos] != '"') {
+        if (str[pos] == '\\' && pos + 1 < str.length()) {
+            pos++;
+            char escaped = str[pos];
+            switch (escaped) {
+                case '"': result += '"'; break;
+                case '\\': result += '\\'; break;
+                case '/': result += '/'; break;
+                case 'b': result += '\b'; break;
+                case 'f': result += '\f'; break;
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                default: result += escaped; break;
+            }
+        } else {
+            result += str[pos];
+        }
+        pos++;
+    }
+    if (pos < str.length()) pos++; // skip closing quote
+    return result;
+}
+
+double SimpleJSON::parseNumber(const std::string& str, size_t& pos) {
+    size_t start = pos;
+    if (str[pos] == '-') pos++;
+    while (pos < str.length() && ((str[pos] >= '0' && str[pos] <= '9') || str[pos] == '.')) {
+        pos++;
+    }
+    return std::stod(str.substr(start, pos - start));
+}
+
+void SimpleJSON::skipWhitespace(const std::string& str, size_t& pos) {
+    while (pos < str.length() && (str[pos] == ' ' || str[pos] == '\t' || str[pos] == '\n' || str[pos] == '\r')) {
+        pos++;
+    }
+}
+
+std::string SimpleJSON::escapeString(const std::string& str) {
+    std::string result;
+    for (char c : str) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\b': result += "\\b"; break;
+            case '\f': result += "\\f"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    result += escaped;
+                } else {
+                    result += c;
+                }
+                break;
+        }
+    }
+    return result;
+}
+
+// Engine nested property helpers
+std::vector<std::string> Engine::splitPath(const std::string& path) {
+    std::vector<std::string> parts;
+    std::stringstream ss(path);
+    std::string part;
+    
+    while (std::getline(ss, part, '.')) {
+        if (!part.empty()) {
+            parts.push_back(part);
+        }
+    }
+    return parts;
+}
+
+bool Engine::setNestedProperty(SimpleJSON::Value& root, const std::vector<std::string>& path, const std::string& value) {
+    if (path.empty()) return false;
+    
+    if (root.type != SimpleJSON::Value::OBJECT) {
+        root.type = SimpleJSON::Value::OBJECT;
+        root.object_value.clear();
+    }
+    
+    SimpleJSON::Value* current = &root;
+    for (size_t i = 0; i < path.size() - 1; i++) {
+        if (current->object_value.find(path[i]) == current->object_value.end() ||
+            current->object_value[path[i]].type != SimpleJSON::Value::OBJECT) {
+            current->object_value[path[i]].type = SimpleJSON::Value::OBJECT;
+            current->object_value[path[i]].object_value.clear();
+        }
+        current = &current->object_value[path[i]];
+    }
+    
+    current->object_value[path.back()] = SimpleJSON::Value(value);
+    return true;
+}
+
+std::string Engine::getNestedProperty(const SimpleJSON::Value& root, const std::vector<std::string>& path) {
+    if (path.empty() || root.type != SimpleJSON::Value::OBJECT) return "";
+    
+    const SimpleJSON::Value* current = &root;
+    for (const std::string& part : path) {
+        if (current->type != SimpleJSON::Value::OBJECT ||
+            current->object_value.find(part) == current->object_value.end()) {
+            return "";
+        }
+        current = &current->object_value.at(part);
+    }
+    
+    if (current->type == SimpleJSON::Value::STRING) {
+        return current->string_value;
+    }
+    return SimpleJSON::stringify(*current);
+}
+
+bool Engine::deleteNestedProperty(SimpleJSON::Value& root, const std::vector<std::string>& path) {
+    if (path.empty() || root.type != SimpleJSON::Value::OBJECT) return false;
+    
+    SimpleJSON::Value* current = &root;
+    for (size_t i = 0; i < path.size() - 1; i++) {
+        if (current->type != SimpleJSON::Value::OBJECT ||
+            current->object_value.find(path[i]) == current->object_value.end()) {
+            return false;
+        }
+        current = &current->object_value[path[i]];
+    }
+    
+    if (current->type == SimpleJSON::Value::OBJECT &&
+        current->object_value.find(path.back()) != current->object_value.end()) {
+        current->object_value.erase(path.back());
+        return true;
+    }
+    return false;
+}
+
+bool Engine::hasNestedProperty(const SimpleJSON::Value& root, const std::vector<std::string>& path) {
+    if (path.empty() || root.type != SimpleJSON::Value::OBJECT) return false;
+    
+    const SimpleJSON::Value* current = &root;
+    for (const std::string& part : path) {
+        if (current->type != SimpleJSON::Value::OBJECT ||
+            current->object_value.find(part) == current->object_value.end()) {
+            return false;
+        }
+        current = &current->object_value.at(part);
+    }
+    return true;
+}
+
+// Engine tiered storage helpers
+
+// Counts an access and brings a demoted value back into memory
+Entry& Engine::touch(Entry& entry) {
+    if (entry.heat < 255) entry.heat++;
+    if (!entry.cold) {
+        cacheHits++;
+    } else {
+        cacheMisses++;
+        changes++;
+        PhaseTimer phase(*this, PHASE_IO);
+        entry.value = readCold(entry);
+        entry.cold = false;
+        promotions++;
+        accountHot(entry.value.size(), &entry);
+    }
+    return entry;
+}
+
+// pinned is the entry being worked on by the caller; it is never demoted
+void Engine::accountHot(size_t bytes, const Entry* pinned) {
+    if (memoryLimit == 0) return;
+    hotBytes += bytes;
+    if (hotBytes > nextCoolDown) coolDown(pinned);
+}
+
+// While loading, entries past the memory limit go straight to the cold file.
+// Called from the partition loader threads, hence the lock.
+void Engine::admitLoaded(Entry& entry) {
+    std::lock_guard<std::mutex> lock(coldMutex);
+    if (hotBytes + entry.value.size() > memoryLimit && entry.value.size() >= MIN_COLD_VALUE) {
+        if (demoteLocked(entry)) return;
+    }
+    hotBytes += entry.value.size();
+}
+
+// One cooling pass: recount hot bytes, then demote the least frequently
+// used entries until usage is back under 90% of the limit, halving every
+// access counter on the way so old popularity fades.
+void Engine::coolDown(const Entry* pinned) {
+    size_t hot = 0;
+    size_t liveCold = 0;
+    std::vector<size_t> histogram(256, 0);
+    auto scan = [&](Index& index) {
+        for (auto& pair : index) {
+            Entry& entry = pair.second;
+            liveCold += entry.coldLength;
+            if (entry.cold) continue;
+            hot += entry.value.size();
+            if (&entry != pinned && entry.value.size() >= MIN_COLD_VALUE) {
+                histogram[entry.heat] += entry.value.size();
+            }
+        }
+    };
+    scan(data);
+    for (auto& pair : collections) scan(pair.second);
+    uint64_t garbage = coldFileSize - liveCold;
+    
+    size_t target = memoryLimit - memoryLimit / 10;
+    size_t need = hot > target ? hot - target : 0;
+    size_t threshold = 0;
+    size_t covered = 0;
+    while (threshold < 255 && covered + histogram[threshold] < need) {
+        covered += histogram[threshold++];
+    }
+    
+    size_t freed = 0;
+    auto cool = [&](Index& index) {
+        for (auto& pair : index) {
+            Entry& entry = pair.second;
+            if (freed < need && !entry.cold && &entry != pinned && entry.heat <= threshold &&
+                entry.value.size() >= MIN_COLD_VALUE) {
+                size_t size = entry.value.size();
+                if (demote(entry)) freed += size;
+            }
+            entry.heat >>= 1;
+        }
+    };
+    cool(data);
+    for (auto& pair : collections) cool(pair.second);
+    
+    hotBytes = hot - freed;
+    // If small or pinned values keep usage above the limit, wait for real
+    // growth before scanning again instead of rescanning on every write
+    nextCoolDown = std::max(memoryLimit, hotBytes + memoryLimit / 10);
+    
+    if (garbage > 64 * 1024 * 1024 && garbage > liveCold) {
+        compactColdFile();
+    }
+}
+
+bool Engine::demote(Entry& entry) {
+    std::lock_guard<std::mutex> lock(coldMutex);
+    return demoteLocked(entry);
+}
+
+bool Engine::demoteLocked(Entry& entry) {
+    if (entry.coldLength == 0) {
+        coldFile.seekp(static_cast<std::streamoff>(coldFileSize));
+        coldFile.write(entry.value.data(), entry.value.size());
+        if (coldFile.fail()) {
+            coldFile.clear();
+            return false;
+        }
+        entry.coldOffset = coldFileSize;
+        entry.coldLength = static_cast<uint32_t>(entry.value.size());
+        coldFileSize += entry.value.size();
+        countWrite(IO_COLD, entry.value.size());
+    }
+    std::string().swap(entry.value);
+    entry.cold = true;
+    demotions++;
+    return true;
+}
+
+std::string Engine::readCold(const Entry& entry) {
+    std::lock_guard<std::mutex> lock(coldMutex);
+    std::string value(entry.coldLength, '\0');
+    coldFile.seekg(static_cast<std::streamoff>(entry.coldOffset));
+    coldFile.read(&value[0], entry.coldLength);
+    if (coldFile.fail()) {
+        coldFile.clear();
+        return "";
+    }
+    countRead(IO_COLD, entry.coldLength);
+    return value;
+}
+
+size_t Engine::valueSize(const Entry& entry) const {
+    return entry.cold ? entry.coldLength : entry.value.size();
+}
+
+void Engine::resetColdFile() {
+    if (coldFile.is_open()) coldFile.close();
+    coldFile.open(coldPath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    coldFileSize = 0;
+    hotBytes = 0;
+}
+
+// Rewrites the cold file with only the values of cold entries. Clean copies
+// of hot entries are dropped rather than copied.
+void Engine::compactColdFile() {
+    OperationTimer timer(*this, OP_COMPACTION);
+    PhaseTimer phase(*this, PHASE_IO);
+    std::string tmpPath = coldPath + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return;
+    
+    std::vector<std::pair<Entry*, uint64_t>> moved;
+    uint64_t size = 0;
+    auto copy = [&](Index& index) {
+        for (auto& pair : index) {
+            Entry& entry = pair.second;
+            if (!entry.cold) continue;
+            std::string value = readCold(entry);
+            out.write(value.data(), value.size());
+            moved.emplace_back(&entry, size);
+            size += value.size();
+        }
+    };
+    copy(data);
+    for (auto& pair : collections) copy(pair.second);
+    out.close();
+    if (out.fail()) {
+        std::remove(tmpPath.c_str());
+        return;
+    }
+    countWrite(IO_COMPACTION, size);
+    
+    coldFile.close();
+    std::remove(coldPath.c_str());
+    if (std::rename(tmpPath.c_str(), coldPath.c_str()) != 0) {
+        // Keep serving from the compacted copy under its temporary name
+        coldPath = tmpPath;
+    }
+    coldFile.open(coldPath, std::ios::in | std::ios::out | std::ios::binary);
+    
+    auto dropCopies = [](Index& index) {
+        for (auto& pair : index) {
+            if (!pair.second.cold) pair.second.coldLength = 0;
+        }
+    };
+    dropCopies(data);
+    for (auto& pair : collections) dropCopies(pair.second);
+    for (auto& move : moved) move.first->coldOffset = move.second;
+    coldFileSize = size;
+}
+
+bool Engine::findStoredRoot(SimpleJSON::Value& root) {
+    RecordView record;
+    if (!store->find("__root__", 8, record) || record.type != Entry::STRING) return false;
+    root = SimpleJSON::parse(std::string(record.value, record.valueLength));
+    return true;
+}
+
+// Engine write-ahead log helpers
+
+// Makes a mutation of `index` durable: one log record when the log is on,
+// otherwise a rewrite of the dirty data files
+bool Engine::persist(LogOp op, const Index& index, const std::string& key) {
+    PhaseTimer phase(*this, PHASE_IO);
+    const Entry* entry = nullptr;
+    if (op == LOG_PUT) {
+        auto it = index.find(key);
+        if (it != index.end()) entry = &it->second;
+    }
+    countLogical(key.size() + (entry ? valueSize(*entry) : 0));
+    if (walPath.empty()) return saveOrDefer();
+    
+    std::string collection;
+    if (&index != &data) {
+        auto it = std::find_if(collections.begin(), collections.end(),
+                               [&](const CollectionMap::value_type& pair) { return &pair.second == &index; });
+        if (it == collections.end()) return true;
+        collection = it->first;
+    }
+    if (op == LOG_PUT && !entry) return true;
+    return persistIn(op, collection, key, entry);
+}
+
+bool Engine::persistIn(LogOp op, const std::string& collection, const std::string& key, const Entry* entry) {
+    if (walPath.empty()) return saveOrDefer();
+    // A record that cannot be logged is made durable by a checkpoint instead
+    if (!appendLog(op, collection, key, entry) || walBytes >= walCheckpointBytes) return SaveToBinary();
+    return true;
+}
+
+// Rewrites the dirty files now, or later: at the end of a server batch, or
+// at checkpoint() when autoSync is off
+bool Engine::saveOrDefer() {
+    if (!deferSave && autoSync) return SaveToBinary();
+    savePending = true;
+    return true;
+}
+
+// Record: u32 payload length, u32 CRC-32 of the payload, then the payload:
+// u64 sequence, u64 Unix time in ms, u8 op, collection, key, u8 type, value
+// (strings as u32 length + bytes)
+bool Engine::appendLog(LogOp op, const std::string& collection, const std::string& key, const Entry* entry) {
+    if (!walFile) return false;
+    
+    std::string coldValue;
+    if (entry && entry->cold) coldValue = readCold(*entry);
+    const std::string& value = entry && !entry->cold ? entry->value : coldValue;
+    uint8_t type = entry ? entry->type : Entry::STRING;
+    uint64_t sequence = walSequence + 1;
+    uint64_t timestamp = nowMillis();
+    
+    auto put = [this](const void* bytes, size_t length) {
+        walBuffer.append(static_cast<const char*>(bytes), length);
+    };
+    auto putString = [&](const std::string& text) {
+        uint32_t length = static_cast<uint32_t>(text.size());
+        put(&length, sizeof(length));
+        put(text.data(), text.size());
+    };
+    walBuffer.assign(2 * sizeof(uint32_t), '\0');
+    put(&sequence, sizeof(sequence));
+    put(&timestamp, sizeof(timestamp));
+    put(&op, sizeof(op));
+    putString(collection);
+    putString(key);
+    put(&type, sizeof(type));
+    putString(value);
+    
+    uint32_t length = static_cast<uint32_t>(walBuffer.size() - 2 * sizeof(uint32_t));
+    uint32_t checksum = crc32(walBuffer.data() + 2 * sizeof(uint32_t), length);
+    memcpy(&walBuffer[0], &length, sizeof(length));
+    memcpy(&walBuffer[sizeof(uint32_t)], &checksum, sizeof(checksum));
+    
+    if (std::fwrite(walBuffer.data(), 1, walBuffer.size(), walFile) != walBuffer.size() || std::fflush(walFile) != 0) {
+        return false;
+    }
+    if (walSync) {
+        LatencyTimer timer(&latency[OP_FSYNC]);
+#ifdef _WIN32
+        if (_commit(_fileno(walFile)) != 0) return false;
+#else
+        if (fsync(fileno(walFile)) != 0) return false;
+#endif
+    }
+    walSequence = sequence;
+    walBytes += walBuffer.size();
+    countWrite(IO_LOG, walBuffer.size());
+    walRecords++;
+    return true;
+}
+
+// Applies the log over the freshly loaded data files. Records are applied
+// until the first one that is incomplete or fails its checksum; that tail
+// was torn by a crash mid-append and is cut off so new records follow the
+// last good one.
+bool Engine::ReplayLog() {
+    closeLog();
+    walBytes = 0;
+    walRecords = 0;
+    
+    std::ifstream file(walPath, std::ios::binary);
+    if (!file.is_open()) return startLog();
+    
+    uint64_t firstSequence = 0;
+    if (!readLogHeader(file, firstSequence)) {
+        // A short header means we crashed while creating the log: it holds
+        // no records
+        if (!file.fail()) return false;
+        file.close();
+        return startLog();
+    }
+    walFirstSequence = firstSequence;
+    walSequence = firstSequence > 0 ? firstSequence - 1 : 0;
+    
+    // Recovery reads the whole log, then applies only the last record for
+    // each key, deduplicated in parallel as restoreTo() does
+    uint64_t goodEnd = LOG_HEADER;
+    std::string payload;
+    std::vector<LogRecord> records;
+    LogRecord record;
+    uint64_t recordSize = 0;
+    while (readLogRecord(file, payload, record, recordSize)) {
+        walSequence = std::max(walSequence, record.sequence);
+        goodEnd += recordSize;
+        walRecords++;
+        recoveredRecords++;
+        records.push_back(std::move(record));
+        record = LogRecord();
+    }
+    file.close();
+    countRead(IO_LOG, goodEnd);
+    applyLogRecords(records);
+    
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(walPath, error);
+    if (!error && size > goodEnd) {
+        std::filesystem::resize_file(walPath, goodEnd, error);
+        if (error) return false;
+        truncatedBytes += size - goodEnd;
+        syncFile(walPath, &latency[OP_FSYNC]);
+    }
+    
+    walFile = std::fopen(walPath.c_str(), "ab");
+    walBytes = goodEnd;
+    return walFile != nullptr;
+}
+
+// Reads and checks the log header; on a short read the stream is failed
+bool Engine::readLogHeader(std::ifstream& file, uint64_t& firstSequence) {
+    char magic[6] = {0};
+    uint32_t version = 0;
+    file.read(magic, 5);
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&firstSequence), sizeof(firstSequence));
+    return !file.fail() && std::string(magic) == "FSTWL" && version == 1;
+}
+
+// Reads the next record; false at the end of the log or at the first record
+// that is incomplete, fails its checksum or does not parse. size is the
+// record's length in the file.
+bool Engine::readLogRecord(std::ifstream& file, std::string& payload, LogRecord& record, uint64_t& size) {
+    uint32_t header[2];
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (file.fail() || header[0] > 16 * 1024 * 1024) return false;
+    payload.resize(header[0]);
+    file.read(&payload[0], header[0]);
+    if (file.fail() || crc32(payload.data(), payload.size()) != header[1]) return false;
+    
+    size_t pos = 0;
+    bool valid = true;
+    auto take = [&](void* out, size_t length) {
+        if (pos + length > payload.size()) valid = false;
+        if (!valid) return;
+        memcpy(out, payload.data() + pos, length);
+        pos += length;
+    };
+    auto takeString = [&](std::string& out) {
+        uint32_t length = 0;
+        take(&length, sizeof(length));
+        if (!valid || pos + length > payload.size()) {
+            valid = false;
+            return;
+        }
+        out.assign(payload.data() + pos, length);
+        pos += length;
+    };
+    uint8_t op = 0;
+    uint8_t type = 0;
+    take(&record.sequence, sizeof(record.sequence));
+    take(&record.timestamp, sizeof(record.timestamp));
+    take(&op, sizeof(op));
+    takeString(record.collection);
+    takeString(record.key);
+    take(&type, sizeof(type));
+    takeString(record.entry.value);
+    if (!valid || op < LOG_PUT || op > LOG_DROP || type > Entry::INT32_ARRAY) return false;
+    
+    record.op = static_cast<LogOp>(op);
+    record.entry.type = static_cast<Entry::Type>(type);
+    size = sizeof(header) + header[0];
+    return true;
+}
+
+void Engine::applyLogRecord(LogOp op, const std::string& collection, const std::string& key, Entry&& entry) {
+    if (op == LOG_DROP) {
+        collections.erase(collection);
+        markAllDirty();
+        return;
+    }
+    Index& index = collection.empty() ? data : collections[collection];
+    if (op == LOG_PUT) {
+        shadowRunKey(index, key);
+        Entry& stored = (index[key] = std::move(entry));
+        accountHot(stored.value.size(), &stored);
+        markDirty(key);
+    } else if (op == LOG_DELETE) {
+        bool erased = index.erase(key) > 0;
+        hideRunKey(index, key, !erased);
+        markDirty(key);
+    } else {
+        index.clear();
+        if (&index == &data) dropRuns();
+        markAllDirty();
+    }
+}
+
+// Installs an empty log that continues the sequence: written beside the
+// live log, flushed and renamed over it
+bool Engine::startLog() {
+    closeLog();
+    std::string tmpPath = walPath + ".tmp";
+    std::FILE* file = std::fopen(tmpPath.c_str(), "wb");
+    if (!file) return false;
+    
+    uint32_t version = 1;
+    uint64_t firstSequence = walSequence + 1;
+    bool success = std::fwrite("FSTWL", 1, 5, file) == 5 &&
+                   std::fwrite(&version, sizeof(version), 1, file) == 1 &&
+                   std::fwrite(&firstSequence, sizeof(firstSequence), 1, file) == 1;
+    success = std::fclose(file) == 0 && success && syncFile(tmpPath, &latency[OP_FSYNC]);
+    if (!success || !replaceFile(tmpPath, walPath)) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    syncDirectory(walPath, &latency[OP_FSYNC]);
+    
+    walFile = std::fopen(walPath.c_str(), "ab");
+    walFirstSequence = firstSequence;
+    walBytes = LOG_HEADER;
+    walRecords = 0;
+    return walFile != nullptr;
+}
+
+void Engine::closeLog() {
+    if (walFile) {
+        std::fclose(walFile);
+        walFile = nullptr;
+    }
+}
+
+// Engine point-in-time restore helpers
+
+// Keeps the checkpoint just installed and the log it supersedes. The log is
+// moved aside before the history lists it; a crash in between leaves an
+// unlisted segment, which costs restore points but never data.
+bool Engine::archiveCheckpoint() {
+    if (!checkpointHistory.empty() && walSequence <= checkpointHistory.back().sequence) {
+        walSequence = checkpointHistory.back().sequence + 1;
+    }
+    Checkpoint checkpoint = { walSequence, nowMillis(), filename + ".ckpt" + std::to_string(walSequence) };
+    if (!WriteCheckpoint(checkpoint.path)) return false;
+    
+    closeLog();
+    if (walRecords > 0) {
+        LogSegment segment = { walFirstSequence, walSequence, filename + ".wal" + std::to_string(walFirstSequence) };
+        if (!replaceFile(walPath, segment.path)) return false;
+        logSegments.push_back(segment);
+    }
+    checkpointHistory.push_back(checkpoint);
+    
+    std::vector<std::string> expired;
+    while (checkpointHistory.size() > retainCheckpoints) {
+        expired.push_back(checkpointHistory.front().path);
+        checkpointHistory.erase(checkpointHistory.begin());
+    }
+    while (!logSegments.empty() && logSegments.front().lastSequence <= checkpointHistory.front().sequence) {
+        expired.push_back(logSegments.front().path);
+        logSegments.erase(logSegments.begin());
+    }
+    if (!WriteHistory()) return false;
+    syncDirectory(filename, &latency[OP_FSYNC]);
+    for (const auto& path : expired) std::remove(path.c_str());
+    return true;
+}
+
+// A single data file without runs is only ever replaced, never modified, so
+// a hard link to it is a complete checkpoint. Anything else is written out.
+bool Engine::WriteCheckpoint(const std::string& path) {
+    std::remove(path.c_str());
+    if (partitionPaths.empty() && runs.empty()) {
+        std::error_code error;
+        std::filesystem::create_hard_link(filename, path, error);
+        if (!error) return true;
+    }
+    return WriteDataFile(path, -1, true);
+}
+
+// "FSTHS", u32 version, u32 checkpoint count + (u64 sequence, u64 timestamp,
+// path), u32 segment count + (u64 first sequence, u64 last sequence, path)
+bool Engine::WriteHistory() {
+    std::string path = filename + ".history";
+    std::string tmpPath = path + ".tmp";
+    try {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        
+        file.write("FSTHS", 5);
+        uint32_t version = 1;
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        uint32_t count = static_cast<uint32_t>(checkpointHistory.size());
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& checkpoint : checkpointHistory) {
+            file.write(reinterpret_cast<const char*>(&checkpoint.sequence), sizeof(checkpoint.sequence));
+            file.write(reinterpret_cast<const char*>(&checkpoint.timestamp), sizeof(checkpoint.timestamp));
+            WriteString(file, checkpoint.path);
+        }
+        count = static_cast<uint32_t>(logSegments.size());
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& segment : logSegments) {
+            file.write(reinterpret_cast<const char*>(&segment.firstSequence), sizeof(segment.firstSequence));
+            file.write(reinterpret_cast<const char*>(&segment.lastSequence), sizeof(segment.lastSequence));
+            WriteString(file, segment.path);
+        }
+        
+        file.close();
+        if (file.fail() || !syncFile(tmpPath, &latency[OP_FSYNC])) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    } catch (...) {
+        return false;
+    }
+    return replaceFile(tmpPath, path);
+}
+
+bool Engine::LoadHistory() {
+    checkpointHistory.clear();
+    logSegments.clear();
+    
+    std::ifstream file(filename + ".history", std::ios::binary);
+    if (!file.is_open()) return true;
+    
+    char magic[6] = {0};
+    uint32_t version = 0;
+    file.read(magic, 5);
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (file.fail() || std::string(magic) != "FSTHS" || version != 1) return false;
+    
+    uint32_t count = 0;
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    for (uint32_t i = 0; i < count && !file.fail(); i++) {
+        Checkpoint checkpoint;
+        file.read(reinterpret_cast<char*>(&checkpoint.sequence), sizeof(checkpoint.sequence));
+        file.read(reinterpret_cast<char*>(&checkpoint.timestamp), sizeof(checkpoint.timestamp));
+        checkpoint.path = ReadString(file);
+        if (!file.fail()) checkpointHistory.push_back(std::move(checkpoint));
+    }
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    for (uint32_t i = 0; i < count && !file.fail(); i++) {
+        LogSegment segment;
+        file.read(reinterpret_cast<char*>(&segment.firstSequence), sizeof(segment.firstSequence));
+        file.read(reinterpret_cast<char*>(&segment.lastSequence), sizeof(segment.lastSequence));
+        segment.path = ReadString(file);
+        if (!file.fail()) logSegments.push_back(std::move(segment));
+    }
+    return !file.fail();
+}
+
+// Collects the records of one log file that follow sequence `after`, up to
+// the target sequence or timestamp; done is set once a record passes it
+bool Engine::readLogRange(const std::string& path, uint64_t after, bool bySequence, uint64_t target,
+                          std::vector<LogRecord>& records, bool& done) {
+    std::ifstream file(path, std::ios::binary);
+    uint64_t firstSequence = 0;
+    if (!file.is_open() || !readLogHeader(file, firstSequence)) return false;
+    
+    std::string payload;
+    LogRecord record;
+    uint64_t size = 0;
+    while (readLogRecord(file, payload, record, size)) {
+        if (record.sequence <= after) continue;
+        if ((bySequence ? record.sequence : record.timestamp) > target) {
+            done = true;
+            break;
+        }
+        records.push_back(std::move(record));
+    }
+    return true;
+}
+
+// Every record carries a full value, so a key ends up as its last record
+// after the last clear or drop of its collection. Every record is hashed
+// once, by the thread whose slice holds it; threads that each own one hash
+// range then find the last record per key, and those are applied in a single
+// pass, one per key. Used by restoreTo() and by crash recovery.
+void Engine::applyLogRecords(std::vector<LogRecord>& records) {
+    std::unordered_map<std::string, size_t> barriers;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records[i].op == LOG_CLEAR || records[i].op == LOG_DROP) barriers[records[i].collection] = i;
+    }
+    for (const auto& pair : barriers) {
+        applyLogRecord(records[pair.second].op, pair.first, "", Entry());
+    }
+    
+    size_t threads = 1;
+    if (records.size() >= 65536) {
+        threads = std::min<size_t>(8, std::max<size_t>(1, std::thread::hardware_concurrency()));
+    }
+    // Two passes, each split over the threads. First every thread hashes
+    // its contiguous slice of the records once and sorts their positions
+    // into per-shard lists. Then each thread owns one shard and walks its
+    // lists slice by slice, so positions arrive in log order and the last
+    // record for a key wins.
+    std::vector<std::vector<std::vector<size_t>>> split(threads, std::vector<std::vector<size_t>>(threads));
+    auto partition = [&](size_t slice) {
+        size_t begin = records.size() * slice / threads;
+        size_t end = records.size() * (slice + 1) / threads;
+        for (size_t i = begin; i < end; i++) {
+            const LogRecord& record = records[i];
+            if (record.op != LOG_PUT && record.op != LOG_DELETE) continue;
+            auto barrier = barriers.find(record.collection);
+            if (barrier != barriers.end() && i < barrier->second) continue;
+            size_t shard = threads > 1 ? hashBytes(record.key.data(), record.key.size(), 0) % threads : 0;
+            split[slice][shard].push_back(i);
+        }
+    };
+    std::vector<std::vector<size_t>> latest(threads);
+    auto reduce = [&](size_t shard) {
+        std::unordered_map<std::string_view, std::unordered_map<std::string_view, size_t>> last;
+        for (size_t slice = 0; slice < threads; slice++) {
+            for (size_t i : split[slice][shard]) last[records[i].collection][records[i].key] = i;
+        }
+        for (const auto& collection : last) {
+            for (const auto& pair : collection.second) latest[shard].push_back(pair.second);
+        }
+    };
+    auto runAll = [threads](const std::function<void(size_t)>& work) {
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < threads; i++) workers.emplace_back(work, i);
+        work(0);
+        for (auto& worker : workers) worker.join();
+    };
+    runAll(partition);
+    runAll(reduce);
+    
+    // Applying stays on this thread: every shard writes the same indexes
+    for (const auto& shard : latest) {
+        for (size_t i : shard) {
+            LogRecord& record = records[i];
+            if (record.op == LOG_DELETE && !record.collection.empty() && !collections.count(record.collection)) continue;
+            applyLogRecord(record.op, record.collection, record.key, std::move(record.entry));
+        }
+    }
+}
+
+// Engine follower helpers
+
+// Loads the data files and tails the log that follows them. The log is
+// opened first: a checkpoint installs its data files before it replaces the
+// log, so the files loaded are at least as new as the log's first record,
+// and replaying records they already hold is harmless.
+bool Engine::reloadFollower() {
+    followFile.close();
+    followFile.clear();
+    followFile.open(filename + ".wal", std::ios::binary);
+    uint64_t firstSequence = 0;
+    if (followFile.is_open() && !readLogHeader(followFile, firstSequence)) followFile.close();
+    
+    bool success = LoadFromBinary();
+    followReloads++;
+    followFirstSequence = followFile.is_open() ? firstSequence : 0;
+    followOffset = LOG_HEADER;
+    walSequence = firstSequence > 0 ? firstSequence - 1 : 0;
+    if (followFile.is_open()) drainFollowLog();
+    return success;
+}
+
+// Applies the complete records after followOffset; a record still being
+// appended fails its length or checksum and is retried on the next call
+uint64_t Engine::drainFollowLog() {
+    std::string payload;
+    LogRecord record;
+    uint64_t size = 0;
+    uint64_t applied = 0;
+    followFile.clear();
+    followFile.seekg(static_cast<std::streamoff>(followOffset));
+    while (readLogRecord(followFile, payload, record, size)) {
+        followOffset += size;
+        countRead(IO_LOG, size);
+        if (record.sequence <= walSequence) continue;
+        applyLogRecord(record.op, record.collection, record.key, std::move(record.entry));
+        walSequence = record.sequence;
+        applied++;
+    }
+    followFile.clear();
+    followRecords += applied;
+    return applied;
+}
+
+// Drains the log being tailed, then follows checkpoints to the current log.
+// A replaced log is still readable through the open stream, so a follower
+// that keeps up moves to the next log without reloading anything.
+uint64_t Engine::followLog() {
+    uint64_t applied = followFile.is_open() ? drainFollowLog() : 0;
+    for (int attempt = 0; attempt < 8; attempt++) {
+        std::ifstream file(filename + ".wal", std::ios::binary);
+        uint64_t firstSequence = 0;
+        if (!file.is_open() || !readLogHeader(file, firstSequence) || firstSequence == followFirstSequence) break;
+        
+        if (followFirstSequence == 0 || firstSequence != walSequence + 1) {
+            uint64_t before = followRecords;
+            reloadFollower();
+            applied += followRecords - before;
+            continue;
+        }
+        followFile = std::move(file);
+        followFirstSequence = firstSequence;
+        followOffset = LOG_HEADER;
+        applied += drainFollowLog();
+    }
+    return applied;
+}
+
+uint64_t Engine::catchUp() {
+    return follower ? followLog() : 0;
+}
+
+// Failover: the leader must have stopped; a torn record it left behind is
+// cut off
+bool Engine::promote() {
+    if (!follower) return false;
+    followLog();
+    followFile.close();
+    follower = false;
+    walEnabled = true;
+    walPath = filename + ".wal";
+    return ReplayLog();
+}
+
+Engine::ReplicationStatus Engine::replicationStatus() {
+    ReplicationStatus status;
+    auto inspect = [&](std::ifstream& file, uint64_t offset) {
+        file.clear();
+        file.seekg(0, std::ios::end);
+        uint64_t size = static_cast<uint64_t>(file.tellg());
+        if (size <= offset) return;
+        status.pendingBytes += size - offset;
+        std::string payload;
+        LogRecord record;
+        uint64_t recordSize = 0;
+        file.seekg(static_cast<std::streamoff>(offset));
+        if (status.lagMs == 0 && readLogRecord(file, payload, record, recordSize)) status.lagMs = record.timestamp;
+        file.clear();
+    };
+    if (follower) {
+        if (followFile.is_open()) inspect(followFile, followOffset);
+        std::ifstream current(filename + ".wal", std::ios::binary);
+        uint64_t firstSequence = 0;
+        if (current.is_open() && readLogHeader(current, firstSequence) && firstSequence != followFirstSequence) {
+            inspect(current, LOG_HEADER);
+        }
+    }
+    // lagMs held the oldest pending timestamp until here
+    uint64_t now = nowMillis();
+    uint64_t oldest = status.lagMs;
+    status.lagMs = oldest > 0 && now > oldest ? now - oldest : 0;
+    status.role = follower ? "follower" : (walPath.empty() ? "standalone" : "leader");
+    status.sequence = walSequence;
+    status.appliedRecords = followRecords;
+    status.reloads = followReloads;
+    return status;
+}
+
+bool Engine::restoreTo(uint64_t target, bool bySequence, RestorePoint& restored, std::string& error) {
+    if (!writable()) {
+        error = "Database does not accept writes";
+        return false;
+    }
+    if (walPath.empty() || retainCheckpoints == 0) {
+        error = "restoreTo() needs the wal and retainCheckpoints options";
+        return false;
+    }
+    if (bySequence && target > walSequence) {
+        error = "Sequence " + std::to_string(target) + " has not been written yet";
+        return false;
+    }
+    
+    const Checkpoint* base = nullptr;
+    for (const auto& checkpoint : checkpointHistory) {
+        if ((bySequence ? checkpoint.sequence : checkpoint.timestamp) <= target) base = &checkpoint;
+    }
+    if (!base) {
+        error = "Restore target predates the oldest retained checkpoint";
+        return false;
+    }
+    Checkpoint checkpoint = *base;
+    
+    std::vector<LogRecord> records;
+    bool done = false;
+    bool complete = std::filesystem::exists(checkpoint.path);
+    for (const auto& segment : logSegments) {
+        if (!complete || done) break;
+        if (segment.lastSequence <= checkpoint.sequence) continue;
+        complete = readLogRange(segment.path, checkpoint.sequence, bySequence, target, records, done);
+    }
+    if (complete && !done) complete = readLogRange(walPath, checkpoint.sequence, bySequence, target, records, done);
+    if (!complete) {
+        error = "Retained history is incomplete; cannot restore";
+        return false;
+    }
+    
+    data.clear();
+    collections.clear();
+    if (memoryLimit > 0) resetColdFile();
+    std::vector<std::string> droppedRuns = runPaths;
+    runs.clear();
+    runPaths.clear();
+    tombstones.clear();
+    runOnly = 0;
+    runsDirty = true;
+    
+    if (!ReadDataFile(checkpoint.path, data, collections)) {
+        LoadFromBinary();
+        error = "Cannot read checkpoint " + checkpoint.path;
+        return false;
+    }
+    applyLogRecords(records);
+    markAllDirty();
+    
+    // The restored state gets a sequence of its own, distinct from the
+    // record it was restored to
+    walSequence++;
+    if (!SaveToBinary()) {
+        error = "Restored state could not be saved";
+        return false;
+    }
+    for (const auto& path : droppedRuns) std::remove(path.c_str());
+    
+    restored.sequence = records.empty() ? checkpoint.sequence : records.back().sequence;
+    restored.timestamp = records.empty() ? checkpoint.timestamp : records.back().timestamp;
+    restored.checkpoint = checkpoint.sequence;
+    restored.records = records.size();
+    return true;
+}
+
+// Engine sorted run helpers
+
+// Newest run first; tombstoned keys are skipped unless includeHidden
+bool Engine::findInRuns(const std::string& key, RecordView& out, bool includeHidden) {
+    if (runs.empty() || (!includeHidden && tombstones.count(key))) return false;
+    for (size_t i = runs.size(); i-- > 0;) {
+        if (runs[i]->find(key.data(), key.size(), out)) return true;
+    }
+    return false;
+}
+
+// Called before a key is added to the in-memory index
+void Engine::shadowRunKey(Index& index, const std::string& key) {
+    if (runs.empty() || &index != &data || index.count(key)) return;
+    RecordView record;
+    if (tombstones.erase(key)) {
+        runsDirty = true;
+    } else if (findInRuns(key, record)) {
+        runOnly--;
+        runsDirty = true;
+    }
+}
+
+// Hides a run key after a delete; counted says whether runOnly included it
+bool Engine::hideRunKey(Index& index, const std::string& key, bool counted) {
+    RecordView record;
+    if (&index != &data || !findInRuns(key, record)) return false;
+    tombstones.insert(key);
+    if (counted) runOnly--;
+    runsDirty = true;
+    return true;
+}
+
+bool Engine::loadRoot(Index& index, SimpleJSON::Value& root) {
+    auto it = index.find("__root__");
+    if (it != index.end()) {
+        const std::string& document = touch(it->second).value;
+        PhaseTimer phase(*this, PHASE_PARSE);
+        root = SimpleJSON::parse(document);
+        return true;
+    }
+    RecordView record;
+    if (&index == &data && findInRuns("__root__", record)) {
+        PhaseTimer phase(*this, PHASE_PARSE);
+        root = SimpleJSON::parse(std::string(record.value, record.valueLength));
+        return true;
+    }
+    return false;
+}
+
+// Visits run records that are visible: not in memory, not deleted and not
+// overridden by a newer run
+void Engine::forEachRunRecord(const std::function<void(const RecordView&)>& visit) {
+    RecordView record;
+    for (size_t i = 0; i < runs.size(); i++) {
+        for (uint64_t offset = runs[i]->firstRecord(); offset != 0;) {
+            offset = runs[i]->next(offset, record);
+            if (offset == 0) break;
+            if (runRecordVisible(i, record)) visit(record);
+        }
+    }
+}
+
+bool Engine::runRecordVisible(size_t run, const RecordView& record) {
+    std::string key(record.key, record.keyLength);
+    if (data.count(key) || tombstones.count(key)) return false;
+    RecordView newer;
+    for (size_t j = run + 1; j < runs.size(); j++) {
+        if (runs[j]->find(record.key, record.keyLength, newer)) return false;
+    }
+    return true;
+}
+
+std::string Engine::runPath(uint64_t id) const {
+    return filename + ".run" + std::to_string(id);
+}
+
+// "FSTRN", u32 version, u64 next run id, u64 runOnly, u32 run count + paths,
+// u32 tombstone count + keys. Removed once there are no runs left.
+bool Engine::WriteRunsManifest() {
+    std::string path = filename + ".runs";
+    if (runs.empty() && tombstones.empty()) {
+        std::remove(path.c_str());
+        runsDirty = false;
+        return true;
+    }
+    
+    std::string tmpPath = path + ".tmp";
+    try {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        
+        file.write("FSTRN", 5);
+        uint32_t version = 1;
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        file.write(reinterpret_cast<const char*>(&nextRunId), sizeof(nextRunId));
+        file.write(reinterpret_cast<const char*>(&runOnly), sizeof(runOnly));
+        uint32_t count = static_cast<uint32_t>(runPaths.size());
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& runFile : runPaths) WriteString(file, runFile);
+        count = static_cast<uint32_t>(tombstones.size());
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& key : tombstones) WriteString(file, key);
+        
+        file.close();
+        if (file.fail() || (!walPath.empty() && !syncFile(tmpPath, &latency[OP_FSYNC]))) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    } catch (...) {
+        return false;
+    }
+    if (!replaceFile(tmpPath, path)) return false;
+    runsDirty = false;
+    return true;
+}
+
+bool Engine::LoadRuns() {
+    runs.clear();
+    runPaths.clear();
+    tombstones.clear();
+    runOnly = 0;
+    nextRunId = 0;
+    runsDirty = false;
+    
+    std::ifstream file(filename + ".runs", std::ios::binary);
+    if (!file.is_open()) return true;
+    
+    char magic[6] = {0};
+    uint32_t version = 0;
+    file.read(magic, 5);
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (file.fail() || std::string(magic) != "FSTRN" || version != 1) return false;
+    file.read(reinterpret_cast<char*>(&nextRunId), sizeof(nextRunId));
+    file.read(reinterpret_cast<char*>(&runOnly), sizeof(runOnly));
+    
+    bool success = true;
+    uint32_t count = 0;
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    for (uint32_t i = 0; i < count && !file.fail(); i++) {
+        std::string path = ReadString(file);
+        std::unique_ptr<SSTableFile> run(new SSTableFile());
+        if (path.empty() || !run->open(path)) {
+            success = false;
+            continue;
+        }
+        runs.push_back(std::move(run));
+        runPaths.push_back(path);
+    }
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    for (uint32_t i = 0; i < count && !file.fail() && count <= 10000000; i++) {
+        std::string key = ReadString(file);
+        if (!key.empty()) tombstones.insert(std::move(key));
+    }
+    return success && !file.fail();
+}
+
+void Engine::dropRuns() {
+    if (runs.empty() && tombstones.empty()) return;
+    std::vector<std::string> dropped = runPaths;
+    runs.clear();
+    runPaths.clear();
+    tombstones.clear();
+    runOnly = 0;
+    if (WriteRunsManifest()) {
+        for (const auto& path : dropped) std::remove(path.c_str());
+    }
+}
+
+bool Engine::ingest(const std::string& path, size_t& count, std::string& error) {
+    if (!writable()) {
+        error = "Database does not accept writes";
+        return false;
+    }
+    {
+        SSTableFile probe;
+        if (!probe.open(path)) {
+            error = "Not a sorted table file: " + path;
+            return false;
+        }
+    }
+    
+    std::string target = runPath(nextRunId);
+    std::error_code failure;
+    std::filesystem::remove(target, failure);
+    failure.clear();
+    std::filesystem::create_hard_link(path, target, failure);
+    if (failure) {
+        failure.clear();
+        std::filesystem::copy_file(path, target, std::filesystem::copy_options::overwrite_existing, failure);
+    }
+    std::unique_ptr<SSTableFile> run(new SSTableFile());
+    if (failure || !run->open(target)) {
+        std::remove(target.c_str());
+        error = "Cannot link " + path + " into the database";
+        return false;
+    }
+    
+    // Work out how the new run changes what is visible before adding it
+    size_t shadowed = 0;
+    RecordView record;
+    RecordView existing;
+    for (uint64_t offset = run->firstRecord(); offset != 0;) {
+        offset = run->next(offset, record);
+        if (offset == 0) break;
+        std::string key(record.key, record.keyLength);
+        auto it = data.find(key);
+        if (it != data.end()) {
+            data.erase(it);
+            markDirty(key);
+            shadowed++;
+            runOnly++;
+        } else if (tombstones.erase(key) || !findInRuns(key, existing, true)) {
+            runOnly++;
+        }
+    }
+    
+    count = run->size();
+    runs.push_back(std::move(run));
+    runPaths.push_back(target);
+    nextRunId++;
+    runsDirty = true;
+    
+    // With a log, a checkpoint keeps older records from replaying over the run
+    bool success = shadowed > 0 || !walPath.empty() ? SaveToBinary() : WriteRunsManifest();
+    if (!success) error = "Failed to save after ingesting " + path;
+    return success;
+}
+
+// Engine export helpers
+
+bool Engine::compile(const std::string& path, size_t& count) {
+    std::vector<RecordView> records;
+    std::vector<std::string> coldValues;
+    if (store) {
+        records.resize(store->size());
+        for (size_t i = 0; i < records.size(); i++) store->at(i, records[i]);
+    } else {
+        records.reserve(data.size());
+        for (const auto& pair : data) {
+            if (pair.second.cold) coldValues.push_back(readCold(pair.second));
+        }
+        size_t nextCold = 0;
+        for (const auto& pair : data) {
+            const std::string& value = pair.second.cold ? coldValues[nextCold++] : pair.second.value;
+            records.push_back({ pair.first.data(), pair.first.size(), value.data(), value.size(), pair.second.type });
+        }
+        forEachRunRecord([&](const RecordView& record) { records.push_back(record); });
+    }
+    count = records.size();
+    return PerfectHashFile::build(records, path, bloomBitsPerKey);
+}
+
+// The files on disk are the snapshot, so they are brought up to date first,
+// including writes deferred with autoSync off. Saves replace them by rename,
+// so a stream opened now keeps reading the version it opened.
+bool Engine::snapshot(ExportSnapshot& out, std::string& error) {
+    if (follower) {
+        // The files on disk lag the records this follower has applied
+        error = "exportTo() is not available on a follower";
+        return false;
+    }
+    if (!readOnly && (savePending || layoutChanged || runsDirty || !obsoletePaths.empty() || walRecords > 0 ||
+                      std::find(dirtyPartitions.begin(), dirtyPartitions.end(), 1) != dirtyPartitions.end())) {
+        savePending = false;
+        SaveToBinary();
+    }
+    
+    std::vector<std::string> paths;
+    char magic[6] = {0};
+    {
+        std::ifstream file(filename, std::ios::binary);
+        if (file.is_open()) file.read(magic, 5);
+        if (std::string(magic) == "FSTDP" && !ReadManifest(file, paths)) paths.clear();
+    }
+    if (std::string(magic) == "FSTMP") {
+        out.store = store;
+    } else if (std::string(magic) == "FSTDB") {
+        paths.assign(1, filename);
+    }
+    for (const auto& dataPath : paths) {
+        std::unique_ptr<std::ifstream> file(new std::ifstream(dataPath, std::ios::binary));
+        if (file->is_open()) out.files.push_back(std::move(file));
+    }
+    
+    if (store) {
+        out.total = store->size();
+    } else {
+        out.total = data.size() + runOnly;
+        for (const auto& pair : collections) out.total += pair.second.size();
+    }
+    if (!readOnly && !runs.empty()) {
+        out.runs = runs;
+        out.hidden = tombstones;
+        RecordView record;
+        for (const auto& pair : data) {
+            if (findInRuns(pair.first, record, true)) out.hidden.insert(pair.first);
+        }
+    }
+    return true;
+}
+
+// Writes an export snapshot, holding one entry in memory at a time
+struct Engine::SnapshotWriter {
+    SnapshotWriter(ExportSnapshot& snapshot, ExportFormat format,
+                   const std::function<void(const ExportProgress&)>& progress, ExportProgress& written)
+        : snapshot(snapshot), format(format), progress(progress), written(written), collectionSections(0) {}
+    
+    ExportSnapshot& snapshot;
+    ExportFormat format;
+    const std::function<void(const ExportProgress&)>& progress;
+    ExportProgress& written;
+    std::ofstream out;
+    std::string line;
+    std::string error;
+    uint32_t collectionSections;
+    
+    struct Source {
+        uint32_t version;
+        std::streampos collections;
+    };
+    
+    // Default-collection entries from every source come first, then each
+    // file's collection sections; the binary format allows a collection name
+    // to repeat, so sections are never merged in memory.
+    bool writeAll() {
+        std::streampos countPos = 0;
+        uint32_t count = 0;
+        if (format == EXPORT_BINARY) {
+            out.write("FSTDB", 5);
+            uint32_t version = 4;
+            out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+            countPos = out.tellp();
+            out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        }
+        
+        std::vector<Source> sources(snapshot.files.size());
+        for (size_t i = 0; i < snapshot.files.size(); i++) {
+            std::ifstream& file = *snapshot.files[i];
+            char magic[6] = {0};
+            file.read(magic, 5);
+            file.read(reinterpret_cast<char*>(&sources[i].version), sizeof(uint32_t));
+            if (file.fail() || std::string(magic) != "FSTDB" || sources[i].version < 1 || sources[i].version > 4) {
+                error = "Unreadable data file in snapshot";
+                return false;
+            }
+            if (!copySection(file, sources[i].version, nullptr)) return false;
+            sources[i].collections = file.tellg();
+        }
+        
+        RecordView record;
+        if (snapshot.store) {
+            for (size_t i = 0; i < snapshot.store->size() && snapshot.store->at(i, record); i++) {
+                if (!emit(nullptr, record)) return false;
+            }
+        }
+        
+        // A run record is visible unless memory, a tombstone or a newer run
+        // hides it
+        RecordView newer;
+        const auto& runs = snapshot.runs;
+        for (size_t i = 0; i < runs.size(); i++) {
+            for (uint64_t offset = runs[i]->firstRecord(); offset != 0;) {
+                offset = runs[i]->next(offset, record);
+                if (offset == 0) break;
+                if (snapshot.hidden.count(std::string(record.key, record.keyLength))) continue;
+                bool overridden = false;
+                for (size_t j = i + 1; j < runs.size() && !overridden; j++) {
+                    overridden = runs[j]->find(record.key, record.keyLength, newer);
+                }
+                if (!overridden && !emit(nullptr, record)) return false;
+            }
+        }
+        
+        if (format == EXPORT_BINARY) {
+            patch(countPos, static_cast<uint32_t>(written.entries));
+            countPos = out.tellp();
+            out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        }
+        for (size_t i = 0; i < snapshot.files.size(); i++) {
+            if (sources[i].version < 3) continue;
+            std::ifstream& file = *snapshot.files[i];
+            file.seekg(sources[i].collections);
+            uint32_t collectionCount = 0;
+            file.read(reinterpret_cast<char*>(&collectionCount), sizeof(collectionCount));
+            for (uint32_t c = 0; c < collectionCount && !file.fail(); c++) {
+                std::string name = ReadString(file);
+                if (file.fail() || name.empty()) break;
+                if (format == EXPORT_BINARY) WriteString(out, name);
+                collectionSections++;
+                if (!copySection(file, sources[i].version, &name)) return false;
+            }
+        }
+        
+        if (format == EXPORT_BINARY) {
+            patch(countPos, collectionSections);
+            // Empty Bloom footer: every lookup falls through to the index
+            uint32_t noBlocks = 0;
+            out.write(reinterpret_cast<const char*>(&noBlocks), sizeof(noBlocks));
+            written.bytes = static_cast<uint64_t>(out.tellp());
+        }
+        return out.good();
+    }
+    
+    // Copies one "count + entries" section; in binary mode the count is
+    // rewritten in place once the entries are out
+    bool copySection(std::ifstream& file, uint32_t version, const std::string* collection) {
+        uint32_t count = 0;
+        file.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (file.fail() || count > 10000000) {
+            error = "Unreadable data file in snapshot";
+            return false;
+        }
+        
+        std::streampos countPos = out.tellp();
+        uint32_t copied = 0;
+        if (format == EXPORT_BINARY && collection) out.write(reinterpret_cast<const char*>(&copied), sizeof(copied));
+        
+        for (uint32_t i = 0; i < count; i++) {
+            std::string key = ReadString(file);
+            uint8_t type = Entry::STRING;
+            if (version >= 2) file.read(reinterpret_cast<char*>(&type), sizeof(type));
+            std::string value = ReadString(file);
+            if (file.fail() || file.eof()) break;
+            if (type > Entry::INT32_ARRAY || key.empty()) continue;
+            
+            RecordView record = { key.data(), key.size(), value.data(), value.size(), static_cast<Entry::Type>(type) };
+            if (!emit(collection, record)) return false;
+            copied++;
+        }
+        
+        if (format == EXPORT_BINARY && collection) patch(countPos, copied);
+        return true;
+    }
+    
+    bool emit(const std::string* collection, const RecordView& record) {
+        if (format == EXPORT_BINARY) {
+            uint32_t keyLength = static_cast<uint32_t>(record.keyLength);
+            uint32_t valueLength = static_cast<uint32_t>(record.valueLength);
+            uint8_t type = record.type;
+            out.write(reinterpret_cast<const char*>(&keyLength), sizeof(keyLength));
+            out.write(record.key, record.keyLength);
+            out.write(reinterpret_cast<const char*>(&type), sizeof(type));
+            out.write(reinterpret_cast<const char*>(&valueLength), sizeof(valueLength));
+            out.write(record.value, record.valueLength);
+            written.bytes += sizeof(keyLength) + record.keyLength + sizeof(type) + sizeof(valueLength) + record.valueLength;
+        } else {
+            line.clear();
+            if (collection) {
+                line += "{\"collection\":\"";
+                line += SimpleJSON::escapeString(*collection);
+                line += "\",\"key\":\"";
+            } else {
+                line += "{\"key\":\"";
+            }
+            line += SimpleJSON::escapeString(std::string(record.key, record.keyLength));
+            line += "\",\"value\":";
+            appendValue(record);
+            line += "}\n";
+            out.write(line.data(), line.size());
+            written.bytes += line.size();
+        }
+        if (out.fail()) return false;
+        
+        if (++written.entries % PROGRESS_INTERVAL == 0) progress(written);
+        return true;
+    }
+    
+    // Strings as JSON strings, numeric arrays as JSON arrays, matching export()
+    void appendValue(const RecordView& record) {
+        if (record.type == Entry::STRING) {
+            line += '"';
+            line += SimpleJSON::escapeString(std::string(record.value, record.valueLength));
+            line += '"';
+            return;
+        }
+        char number[32];
+        line += '[';
+        size_t length = record.valueLength / NumericArray::elementSize(record.type);
+        for (size_t i = 0; i < length; i++) {
+            if (i > 0) line += ',';
+            if (record.type == Entry::FLOAT64_ARRAY) {
+                double element;
+                memcpy(&element, record.value + i * sizeof(double), sizeof(double));
+                if (std::isfinite(element)) {
+                    snprintf(number, sizeof(number), "%.17g", element);
+                    line += number;
+                } else {
+                    line += "null";
+                }
+            } else {
+                int32_t element;
+                memcpy(&element, record.value + i * sizeof(int32_t), sizeof(int32_t));
+                line += std::to_string(element);
+            }
+        }
+        line += ']';
+    }
+    
+    void patch(std::streampos position, uint32_t value) {
+        std::streampos end = out.tellp();
+        out.seekp(position);
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        out.seekp(end);
+    }
+};
+
+bool Engine::exportSnapshot(ExportSnapshot& snapshot, const std::string& path, ExportFormat format,
+                            const std::function<void(const ExportProgress&)>& progress, ExportProgress& written,
+                            std::string& error) {
+    written = ExportProgress();
+    SnapshotWriter writer(snapshot, format, progress, written);
+    std::string tmpPath = path + ".tmp";
+    std::vector<char> buffer(1 << 20);
+    writer.out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+    writer.out.open(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!writer.out.is_open()) {
+        error = "Cannot write " + path;
+        return false;
+    }
+    
+    bool success = writer.writeAll();
+    writer.out.close();
+    if (!success || writer.out.fail() || !replaceFile(tmpPath, path)) {
+        std::remove(tmpPath.c_str());
+        error = writer.error.empty() ? "Export to " + path + " failed" : writer.error;
+        return false;
+    }
+    progress(written);
+    return true;
+}
+
+// One column of a columnar export, laid out as Arrow lays out its arrays:
+// an LSB-first validity bitmap (empty when nothing is null) and either
+// float64 values, a bit-packed boolean array, or int32 indices into a
+// dictionary of UTF-8 strings (int32 offsets + bytes) in first-seen order.
+struct ColumnBuffer {
+    enum Kind { FLOAT64, BOOL, DICTIONARY };
+    std::string name;
+    Kind kind;
+    uint64_t nulls;
+    std::string validity;
+    std::string values;
+    std::string dictionaryOffsets;
+    std::string dictionaryData;
+    uint32_t dictionarySize;
+    
+    ColumnBuffer() : kind(FLOAT64), nulls(0), dictionarySize(0) {}
+    
+    static bool parseNumber(const std::string& text, double& out) {
+        if (text.empty() || isspace(static_cast<unsigned char>(text[0]))) return false;
+        char* end = nullptr;
+        out = strtod(text.c_str(), &end);
+        return end == text.c_str() + text.size();
+    }
+    
+    // Leaves are strings (set() stores scalars as text), so the column type is
+    // whatever every present value parses as
+    void build(const std::vector<const SimpleJSON::Value*>& records) {
+        size_t rows = records.size();
+        std::vector<const SimpleJSON::Value*> cells(rows, nullptr);
+        bool numeric = true;
+        bool boolean = true;
+        double number = 0;
+        for (size_t row = 0; row < rows; row++) {
+            auto it = records[row]->object_value.find(name);
+            if (it == records[row]->object_value.end() || it->second.type == SimpleJSON::Value::NULL_VALUE) continue;
+            cells[row] = &it->second;
+            bool text = it->second.type == SimpleJSON::Value::STRING;
+            const std::string& value = it->second.string_value;
+            if (!text || !parseNumber(value, number)) numeric = false;
+            if (!text || (value != "true" && value != "false")) boolean = false;
+        }
+        kind = numeric ? FLOAT64 : (boolean ? BOOL : DICTIONARY);
+        
+        validity.assign((rows + 7) / 8, '\0');
+        if (kind == FLOAT64) values.assign(rows * sizeof(double), '\0');
+        if (kind == BOOL) values.assign((rows + 7) / 8, '\0');
+        if (kind == DICTIONARY) values.assign(rows * sizeof(int32_t), '\0');
+        
+        std::unordered_map<std::string, int32_t> dictionary;
+        int32_t offset = 0;
+        dictionaryOffsets.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        for (size_t row = 0; row < rows; row++) {
+            if (!cells[row]) {
+                nulls++;
+                continue;
+            }
+            validity[row / 8] |= static_cast<char>(1 << (row % 8));
+            const SimpleJSON::Value& cell = *cells[row];
+            if (kind == FLOAT64) {
+                parseNumber(cell.string_value, number);
+                memcpy(&values[row * sizeof(double)], &number, sizeof(double));
+            } else if (kind == BOOL) {
+                if (cell.string_value == "true") values[row / 8] |= static_cast<char>(1 << (row % 8));
+            } else {
+                std::string text = cell.type == SimpleJSON::Value::STRING ? cell.string_value : SimpleJSON::stringify(cell);
+                auto found = dictionary.emplace(text, static_cast<int32_t>(dictionary.size()));
+                if (found.second) {
+                    dictionaryData += text;
+                    offset = static_cast<int32_t>(dictionaryData.size());
+                    dictionaryOffsets.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+                }
+                memcpy(&values[row * sizeof(int32_t)], &found.first->second, sizeof(int32_t));
+            }
+        }
+        dictionarySize = static_cast<uint32_t>(dictionary.size());
+        if (nulls == 0) validity.clear();
+    }
+};
+
+// Columnar file: "FSTCOL", u16 version, u32 schema length, a JSON schema
+// giving each buffer's [offset, length], then the buffers, each aligned to
+// 64 bytes so readers can view them in place as typed arrays.
+static bool writeColumnFile(const std::string& path, const std::vector<std::string>& ids,
+                            const std::vector<ColumnBuffer>& columns) {
+    static const uint64_t ALIGNMENT = 64;
+    uint32_t rows = static_cast<uint32_t>(ids.size());
+    
+    // The id column is a plain UTF-8 array: int32 offsets + bytes
+    std::string idOffsets;
+    std::string idData;
+    int32_t offset = 0;
+    idOffsets.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    for (const auto& id : ids) {
+        idData += id;
+        offset = static_cast<int32_t>(idData.size());
+        idOffsets.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    }
+    
+    std::vector<const std::string*> buffers;
+    auto place = [&](const std::string& buffer) {
+        buffers.push_back(&buffer);
+        return buffers.size() - 1;
+    };
+    // Buffer positions are fixed once the schema length is known, so the
+    // schema is rendered twice: first to measure, then with real offsets
+    std::vector<uint64_t> positions;
+    auto ref = [&](size_t buffer) {
+        if (buffers[buffer]->empty()) return std::string("null");
+        return "[" + std::to_string(positions.empty() ? 0 : positions[buffer]) + "," +
+               std::to_string(buffers[buffer]->size()) + "]";
+    };
+    std::vector<size_t> slots;
+    slots.push_back(place(idOffsets));
+    slots.push_back(place(idData));
+    for (const auto& column : columns) {
+        slots.push_back(place(column.validity));
+        slots.push_back(place(column.values));
+        if (column.kind == ColumnBuffer::DICTIONARY) {
+            slots.push_back(place(column.dictionaryOffsets));
+            slots.push_back(place(column.dictionaryData));
+        }
+    }
+    auto render = [&]() {
+        size_t slot = 0;
+        std::string schema = "{\"rows\":" + std::to_string(rows) + ",\"columns\":[";
+        schema += "{\"name\":\"id\",\"type\":\"utf8\",\"nulls\":0,\"offsets\":" + ref(slots[slot]) +
+                  ",\"data\":" + ref(slots[slot + 1]) + "}";
+        slot += 2;
+        for (const auto& column : columns) {
+            static const char* kinds[] = { "float64", "bool", "dictionary" };
+            schema += ",{\"name\":\"" + SimpleJSON::escapeString(column.name) + "\",\"type\":\"" + kinds[column.kind] +
+                      "\",\"nulls\":" + std::to_string(column.nulls) + ",\"validity\":" + ref(slots[slot]) +
+                      ",\"values\":" + ref(slots[slot + 1]);
+            slot += 2;
+            if (column.kind == ColumnBuffer::DICTIONARY) {
+                schema += ",\"dictionary\":{\"size\":" + std::to_string(column.dictionarySize) +
+                          ",\"offsets\":" + ref(slots[slot]) + ",\"data\":" + ref(slots[slot + 1]) + "}";
+                slot += 2;
+            }
+            schema += "}";
+        }
+        return schema + "]}";
+    };
+    
+    const uint64_t prefix = 6 + sizeof(uint16_t) + sizeof(uint32_t);
+    std::string schema;
+    for (;;) {
+        schema = render();
+        std::vector<uint64_t> next(buffers.size(), 0);
+        uint64_t position = (prefix + schema.size() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        for (size_t i = 0; i < buffers.size(); i++) {
+            next[i] = position;
+            position = (position + buffers[i]->size() + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        }
+        if (next == positions) break;
+        positions.swap(next);
+    }
+    
+    std::string tmpPath = path + ".tmp";
+    try {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        
+        uint16_t version = 1;
+        uint32_t schemaLength = static_cast<uint32_t>(schema.size());
+        file.write("FSTCOL", 6);
+        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+        file.write(reinterpret_cast<const char*>(&schemaLength), sizeof(schemaLength));
+        file.write(schema.data(), schema.size());
+        
+        static const char padding[ALIGNMENT] = {0};
+        uint64_t written = prefix + schema.size();
+        for (size_t i = 0; i < buffers.size(); i++) {
+            file.write(padding, positions[i] - written);
+            file.write(buffers[i]->data(), buffers[i]->size());
+            written = positions[i] + buffers[i]->size();
+        }
+        file.close();
+        if (file.fail()) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    } catch (...) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return replaceFile(tmpPath, path);
+}
+
+
+// Leaves are read from the nested document, so the path is looked up the
+// same way get() reads a dotted key
+bool Engine::exportColumns(const std::string& nestedPath, const std::string& filename, size_t& rows,
+                           size_t& columnCount, std::string& error) {
+    std::vector<std::string> path = splitPath(nestedPath);
+    if (path.empty()) {
+        error = "Nested path must not be empty";
+        return false;
+    }
+    
+    SimpleJSON::Value root;
+    bool found = store ? findStoredRoot(root) : loadRoot(data, root);
+    const SimpleJSON::Value* parent = found ? &root : nullptr;
+    for (size_t i = 0; parent && i < path.size(); i++) {
+        auto it = parent->object_value.find(path[i]);
+        parent = parent->type == SimpleJSON::Value::OBJECT && it != parent->object_value.end() ? &it->second : nullptr;
+    }
+    
+    // Rows are the object children, in id order so exports are reproducible
+    std::vector<std::pair<const std::string*, const SimpleJSON::Value*>> children;
+    if (parent && parent->type == SimpleJSON::Value::OBJECT) {
+        for (const auto& pair : parent->object_value) {
+            if (pair.second.type == SimpleJSON::Value::OBJECT) children.push_back({ &pair.first, &pair.second });
+        }
+    }
+    std::sort(children.begin(), children.end(), [](const auto& a, const auto& b) { return *a.first < *b.first; });
+    std::vector<std::string> ids;
+    std::vector<const SimpleJSON::Value*> records;
+    std::set<std::string> names;
+    ids.reserve(children.size());
+    records.reserve(children.size());
+    for (const auto& child : children) {
+        ids.push_back(*child.first);
+        records.push_back(child.second);
+        for (const auto& field : child.second->object_value) names.insert(field.first);
+    }
+    // The record key is the id column; a field of the same name would clash
+    names.erase("id");
+    
+    std::vector<ColumnBuffer> columns(names.size());
+    size_t next = 0;
+    for (const auto& name : names) columns[next++].name = name;
+    
+    // Columns are encoded in parallel
+    std::atomic<size_t> claimed(0);
+    auto encode = [&]() {
+        for (size_t i = claimed++; i < columns.size(); i = claimed++) columns[i].build(records);
+    };
+    size_t threadCount = std::min<size_t>(columns.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threadCount; i++) workers.emplace_back(encode);
+    encode();
+    for (auto& worker : workers) worker.join();
+    
+    if (!writeColumnFile(filename, ids, columns)) {
+        error = "Cannot write " + filename;
+        return false;
+    }
+    rows = ids.size();
+    columnCount = columns.size() + 1;
+    return true;
+}
+
+// NumericArray reductions. Elements live in std::string storage, so every
+// vector load is unaligned.
+size_t NumericArray::elementSize(Entry::Type type) {
+    return type == Entry::FLOAT64_ARRAY ? sizeof(double) : sizeof(int32_t);
+}
+
+size_t NumericArray::length(const Entry& entry) {
+    return entry.value.size() / elementSize(entry.type);
+}
+
+double NumericArray::sum(const Entry& entry) {
+    if (entry.type == Entry::FLOAT64_ARRAY) {
+        return sumFloat64(reinterpret_cast<const double*>(entry.value.data()), length(entry));
+    }
+    return static_cast<double>(sumInt32(reinterpret_cast<const int32_t*>(entry.value.data()), length(entry)));
+}
+
+double NumericArray::min(const Entry& entry) {
+    if (entry.type == Entry::FLOAT64_ARRAY) {
+        return minFloat64(reinterpret_cast<const double*>(entry.value.data()), length(entry));
+    }
+    return minInt32(reinterpret_cast<const int32_t*>(entry.value.data()), length(entry));
+}
+
+double NumericArray::max(const Entry& entry) {
+    if (entry.type == Entry::FLOAT64_ARRAY) {
+        return maxFloat64(reinterpret_cast<const double*>(entry.value.data()), length(entry));
+    }
+    return maxInt32(reinterpret_cast<const int32_t*>(entry.value.data()), length(entry));
+}
+
+double NumericArray::sumFloat64(const double* v, size_t n) {
+    size_t i = 0;
+    double total = 0;
+#if defined(FASTDB_SSE2)
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(v + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(v + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    total = lanes[0] + lanes[1];
+#elif defined(FASTDB_NEON)
+    float64x2_t acc0 = vdupq_n_f64(0);
+    float64x2_t acc1 = vdupq_n_f64(0);
+    for (; i + 4 <= n; i += 4) {
+        acc0 = vaddq_f64(acc0, vld1q_f64(v + i));
+        acc1 = vaddq_f64(acc1, vld1q_f64(v + i + 2));
+    }
+    total = vaddvq_f64(vaddq_f64(acc0, acc1));
+#endif
+    for (; i < n; i++) total += v[i];
+    return total;
+}
+
+double NumericArray::minFloat64(const double* v, size_t n) {
+    size_t i = 0;
+    double result = v[0];
+#if defined(FASTDB_SSE2)
+    if (n >= 2) {
+        __m128d acc = _mm_loadu_pd(v);
+        for (i = 2; i + 2 <= n; i += 2) {
+            acc = _mm_min_pd(acc, _mm_loadu_pd(v + i));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        result = std::min(lanes[0], lanes[1]);
+    }
+#elif defined(FASTDB_NEON)
+    if (n >= 2) {
+        float64x2_t acc = vld1q_f64(v);
+        for (i = 2; i + 2 <= n; i += 2) {
+            acc = vminq_f64(acc, vld1q_f64(v + i));
+        }
+        result = vminvq_f64(acc);
+    }
+#endif
+    for (; i < n; i++) result = std::min(result, v[i]);
+    return result;
+}
+
+double NumericArray::maxFloat64(const double* v, size_t n) {
+    size_t i = 0;
+    double result = v[0];
+#if defined(FASTDB_SSE2)
+    if (n >= 2) {
+        __m128d acc = _mm_loadu_pd(v);
+        for (i = 2; i + 2 <= n; i += 2) {
+            acc = _mm_max_pd(acc, _mm_loadu_pd(v + i));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        result = std::max(lanes[0], lanes[1]);
+    }
+#elif defined(FASTDB_NEON)
+    if (n >= 2) {
+        float64x2_t acc = vld1q_f64(v);
+        for (i = 2; i + 2 <= n; i += 2) {
+            acc = vmaxq_f64(acc, vld1q_f64(v + i));
+        }
+        result = vmaxvq_f64(acc);
+    }
+#endif
+    for (; i < n; i++) result = std::max(result, v[i]);
+    return result;
+}
+
+int64_t NumericArray::sumInt32(const int32_t* v, size_t n) {
+    size_t i = 0;
+    int64_t total = 0;
+#if defined(FASTDB_SSE2)
+    // Sign-extend to 64-bit lanes so long arrays cannot overflow
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        __m128i sign = _mm_srai_epi32(x, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(x, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(x, sign));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    total = lanes[0] + lanes[1];
+#elif defined(FASTDB_NEON)
+    int64x2_t acc = vdupq_n_s64(0);
+    for (; i + 4 <= n; i += 4) {
+        acc = vpadalq_s32(acc, vld1q_s32(v + i));
+    }
+    total = vaddvq_s64(acc);
+#endif
+    for (; i < n; i++) total += v[i];
+    return total;
+}
+
+int32_t NumericArray::minInt32(const int32_t* v, size_t n) {
+    size_t i = 0;
+    int32_t result = v[0];
+#if defined(FASTDB_SSE2)
+    if (n >= 4) {
+        // SSE2 has no 32-bit min, so select through a compare mask
+        __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v));
+        for (i = 4; i + 4 <= n; i += 4) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+            __m128i less = _mm_cmplt_epi32(x, acc);
+            acc = _mm_or_si128(_mm_and_si128(less, x), _mm_andnot_si128(less, acc));
+        }
+        int32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        result = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    }
+#elif defined(FASTDB_NEON)
+    if (n >= 4) {
+        int32x4_t acc = vld1q_s32(v);
+        for (i = 4; i + 4 <= n; i += 4) {
+            acc = vminq_s32(acc, vld1q_s32(v + i));
+        }
+        result = vminvq_s32(acc);
+    }
+#endif
+    for (; i < n; i++) result = std::min(result, v[i]);
+    return result;
+}
+
+int32_t NumericArray::maxInt32(const int32_t* v, size_t n) {
+    size_t i = 0;
+    int32_t result = v[0];
+#if defined(FASTDB_SSE2)
+    if (n >= 4) {
+        __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v));
+        for (i = 4; i + 4 <= n; i += 4) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+            __m128i greater = _mm_cmpgt_epi32(x, acc);
+            acc = _mm_or_si128(_mm_and_si128(greater, x), _mm_andnot_si128(greater, acc));
+        }
+        int32_t lanes[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    }
+#elif defined(FASTDB_NEON)
+    if (n >= 4) {
+        int32x4_t acc = vld1q_s32(v);
+        for (i = 4; i + 4 <= n; i += 4) {
+            acc = vmaxq_s32(acc, vld1q_s32(v + i));
+        }
+        result = vmaxvq_s32(acc);
+    }
+#endif
+    for (; i < n; i++) result = std::max(result, v[i]);
+    return result;
+}
+
+void BloomFilter::init(size_t keyCount, uint32_t bitsPerKey) {
+    size_t bits = std::max<size_t>(keyCount * bitsPerKey, 1);
+    numBlocks = static_cast<uint32_t>((bits + 511) / 512);
+    words.assign(static_cast<size_t>(numBlocks) * WORDS_PER_BLOCK, 0);
+    external = nullptr;
+}
+
+void BloomFilter::attach(const uint64_t* blocks, uint32_t count) {
+    words.clear();
+    external = blocks;
+    numBlocks = count;
+}
+
+void BloomFilter::masks(uint64_t hash, uint64_t* out) {
+    static const uint32_t salts[WORDS_PER_BLOCK] = {
+        0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+        0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+    };
+    uint32_t low = static_cast<uint32_t>(hash);
+    for (size_t i = 0; i < WORDS_PER_BLOCK; i++) {
+        out[i] = 1ULL << ((low * salts[i]) >> 26);
+    }
+}
+
+size_t BloomFilter::blockOf(uint64_t hash) const {
+    return static_cast<size_t>(((hash >> 32) * numBlocks) >> 32);
+}
+
+void BloomFilter::add(const char* key, size_t length) {
+    if (numBlocks == 0 || external) return;
+    uint64_t h = hashBytes(key, length, 0);
+    uint64_t mask[WORDS_PER_BLOCK];
+    masks(h, mask);
+    uint64_t* block = &words[blockOf(h) * WORDS_PER_BLOCK];
+    for (size_t i = 0; i < WORDS_PER_BLOCK; i++) block[i] |= mask[i];
+}
+
+// An empty filter has no information, so it answers "maybe" for everything
+bool BloomFilter::mayContain(const char* key, size_t length) const {
+    if (numBlocks == 0) return true;
+    uint64_t h = hashBytes(key, length, 0);
+    uint64_t mask[WORDS_PER_BLOCK];
+    masks(h, mask);
+    const uint64_t* block = blocks() + blockOf(h) * WORDS_PER_BLOCK;
+#if defined(FASTDB_SSE2)
+    __m128i missing = _mm_setzero_si128();
+    for (size_t i = 0; i < WORDS_PER_BLOCK; i += 2) {
+        __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        missing = _mm_or_si128(missing, _mm_andnot_si128(b, m));
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(missing, _mm_setzero_si128())) == 0xFFFF;
+#elif defined(FASTDB_NEON)
+    uint64x2_t missing = vdupq_n_u64(0);
+    for (size_t i = 0; i < WORDS_PER_BLOCK; i += 2) {
+        missing = vorrq_u64(missing, vbicq_u64(vld1q_u64(mask + i), vld1q_u64(block + i)));
+    }
+    return (vgetq_lane_u64(missing, 0) | vgetq_lane_u64(missing, 1)) == 0;
+#else
+    uint64_t missing = 0;
+    for (size_t i = 0; i < WORDS_PER_BLOCK; i++) missing |= mask[i] & ~block[i];
+    return missing == 0;
+#endif
+}
+
+// Serialized as u32 block count + raw words; a count of 0 means no filter
+void BloomFilter::write(std::ostream& out) const {
+    out.write(reinterpret_cast<const char*>(&numBlocks), sizeof(numBlocks));
+    if (numBlocks > 0) {
+        out.write(reinterpret_cast<const char*>(blocks()), byteSize());
+    }
+}
+
+bool BloomFilter::read(std::istream& in) {
+    uint32_t blocks;
+    in.read(reinterpret_cast<char*>(&blocks), sizeof(blocks));
+    if (in.fail() || blocks > (1U << 26)) return false;
+    external = nullptr;
+    words.assign(static_cast<size_t>(blocks) * WORDS_PER_BLOCK, 0);
+    if (blocks > 0) {
+        in.read(reinterpret_cast<char*>(words.data()), words.size() * sizeof(uint64_t));
+        if (in.fail()) {
+            words.clear();
+            numBlocks = 0;
+            return false;
+        }
+    }
+    numBlocks = blocks;
+    return true;
+}
+
+size_t BloomFilter::read(const char* data, size_t size) {
+    uint32_t blocks;
+    if (size < sizeof(blocks)) return 0;
+    memcpy(&blocks, data, sizeof(blocks));
+    size_t bytes = static_cast<size_t>(blocks) * WORDS_PER_BLOCK * sizeof(uint64_t);
+    if (blocks > (1U << 26) || bytes > size - sizeof(blocks)) return 0;
+    external = nullptr;
+    words.assign(static_cast<size_t>(blocks) * WORDS_PER_BLOCK, 0);
+    if (bytes > 0) memcpy(words.data(), data + sizeof(blocks), bytes);
+    numBlocks = blocks;
+    return sizeof(blocks) + bytes;
+}
+
+bool MappedStore::find(const char* key, size_t length, RecordView& out) const {
+    const BloomFilter* filter = filterFor(key, length);
+    if (!filter || filter->empty()) return search(key, length, out);
+    bloomProbes.fetch_add(1, std::memory_order_relaxed);
+    if (!filter->mayContain(key, length)) {
+        bloomNegatives.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (search(key, length, out)) return true;
+    bloomFalsePositives.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+MappedStore::BloomCounts MappedStore::bloomCounts() const {
+    BloomCounts counts;
+    counts.probes = bloomProbes.load(std::memory_order_relaxed);
+    counts.negatives = bloomNegatives.load(std::memory_order_relaxed);
+    counts.falsePositives = bloomFalsePositives.load(std::memory_order_relaxed);
+    return counts;
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) return false;
+    base = static_cast<const char*>(view);
+    length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) return false;
+    base = static_cast<const char*>(view);
+    length = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+    if (!base) return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+#else
+    munmap(const_cast<char*>(base), length);
+#endif
+    base = nullptr;
+    length = 0;
+}
+
+uint64_t PerfectHashFile::bucketOf(uint64_t hash, uint64_t bucketCount) {
+    return ((hash >> 32) * bucketCount) >> 32;
+}
+
+uint64_t PerfectHashFile::position(uint64_t hash, uint32_t pilot, uint64_t tableSize) {
+    return (hash ^ mix64(pilot + 0x9e3779b97f4a7c15ULL)) % tableSize;
+}
+
+// Layout: header | u32 pilots | u64 remap | u64 slot offsets | Bloom blocks
+// | records (u32 key length, u32 value length, u8 type, key, value) laid out
+// in slot order. Written to a temporary file and renamed into place so a
+// process mapping the old file never sees a partial one.
+bool PerfectHashFile::build(const std::vector<RecordView>& records, const std::string& path, uint32_t bloomBitsPerKey) {
+    uint64_t n = records.size();
+    // Average bucket size 4 at load factor 0.98 keeps pilot searches short
+    uint64_t bucketCount = n / 4 + 1;
+    uint64_t tableSize = n + n / 50 + 1;
+    if (bucketCount > UINT32_MAX) return false;
+    
+    std::vector<uint64_t> hashes(n);
+    std::vector<uint32_t> pilotTable(bucketCount, 0);
+    std::vector<uint64_t> slotOf(n);
+    for (uint64_t seed = 0; seed < 32; seed++) {
+        for (uint64_t i = 0; i < n; i++) {
+            hashes[i] = hashBytes(records[i].key, records[i].keyLength, seed);
+        }
+        
+        // Group keys by bucket, then visit buckets largest first
+        std::vector<uint64_t> bucketStart(bucketCount + 1, 0);
+        for (uint64_t i = 0; i < n; i++) bucketStart[bucketOf(hashes[i], bucketCount) + 1]++;
+        size_t largest = 0;
+        for (uint64_t b = 0; b < bucketCount; b++) {
+            largest = std::max<size_t>(largest, bucketStart[b + 1]);
+            bucketStart[b + 1] += bucketStart[b];
+        }
+        std::vector<uint64_t> members(n);
+        std::vector<uint64_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+        for (uint64_t i = 0; i < n; i++) members[fill[bucketOf(hashes[i], bucketCount)]++] = i;
+        
+        std::vector<std::vector<uint64_t>> bySize(largest + 1);
+        for (uint64_t b = 0; b < bucketCount; b++) bySize[bucketStart[b + 1] - bucketStart[b]].push_back(b);
+        
+        std::vector<char> taken(tableSize, 0);
+        std::vector<uint64_t> candidate(largest);
+        bool placed = true;
+        for (size_t size = largest; size > 0 && placed; size--) {
+            for (uint64_t b : bySize[size]) {
+                const uint64_t* keys = &members[bucketStart[b]];
+                uint32_t pilot = 0;
+                for (;; pilot++) {
+                    if (pilot == (1U << 20)) {
+                        placed = false;
+                        break;
+                    }
+                    size_t j = 0;
+                    for (; j < size; j++) {
+                        uint64_t p = position(hashes[keys[j]], pilot, tableSize);
+                        if (taken[p] || std::find(candidate.begin(), candidate.begin() + j, p) != candidate.begin() + j) break;
+                        candidate[j] = p;
+                    }
+                    if (j == size) break;
+                }
+                if (!placed) break;
+                pilotTable[b] = pilot;
+                for (size_t j = 0; j < size; j++) {
+                    taken[candidate[j]] = 1;
+                    slotOf[keys[j]] = candidate[j];
+                }
+            }
+        }
+        
+        if (placed) {
+            // Move keys that landed past n into the holes below n
+            std::vector<uint64_t> remapTable(tableSize - n, 0);
+            uint64_t hole = 0;
+            for (uint64_t p = n; p < tableSize; p++) {
+                if (!taken[p]) continue;
+                while (taken[hole]) hole++;
+                remapTable[p - n] = hole++;
+            }
+            for (uint64_t i = 0; i < n; i++) {
+                if (slotOf[i] >= n) slotOf[i] = remapTable[slotOf[i] - n];
+            }
+            
+            std::vector<uint64_t> bySlot(n);
+            for (uint64_t i = 0; i < n; i++) bySlot[slotOf[i]] = i;
+            
+            BloomFilter filter;
+            if (bloomBitsPerKey > 0 && n > 0) {
+                filter.init(n, bloomBitsPerKey);
+                for (const auto& record : records) filter.add(record.key, record.keyLength);
+            }
+            
+            Header header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, "FSTMPH", 6);
+            header.version = 1;
+            header.keyCount = n;
+            header.bucketCount = bucketCount;
+            header.tableSize = tableSize;
+            header.seed = seed;
+            header.pilotsOffset = sizeof(Header);
+            header.remapOffset = (header.pilotsOffset + bucketCount * sizeof(uint32_t) + 7) & ~7ULL;
+            header.slotsOffset = header.remapOffset + (tableSize - n) * sizeof(uint64_t);
+            header.bloomOffset = header.slotsOffset + n * sizeof(uint64_t);
+            header.bloomBlocks = filter.blockCount();
+            uint64_t recordsOffset = header.bloomOffset + filter.byteSize();
+            
+            std::vector<uint64_t> slotOffsets(n);
+            uint64_t offset = recordsOffset;
+            for (uint64_t slot = 0; slot < n; slot++) {
+                slotOffsets[slot] = offset;
+                const RecordView& record = records[bySlot[slot]];
+                offset += RECORD_HEADER + record.keyLength + record.valueLength;
+            }
+            
+            std::string tmpPath = path + ".tmp";
+            {
+                std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+                if (!file.is_open()) return false;
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                file.write(reinterpret_cast<const char*>(pilotTable.data()), bucketCount * sizeof(uint32_t));
+                static const char padding[8] = {0};
+                file.write(padding, header.remapOffset - header.pilotsOffset - bucketCount * sizeof(uint32_t));
+                file.write(reinterpret_cast<const char*>(remapTable.data()), remapTable.size() * sizeof(uint64_t));
+                file.write(reinterpret_cast<const char*>(slotOffsets.data()), n * sizeof(uint64_t));
+                if (!filter.empty()) {
+                    file.write(reinterpret_cast<const char*>(filter.blocks()), filter.byteSize());
+                }
+                for (uint64_t slot = 0; slot < n; slot++) {
+                    writeRecord(file, records[bySlot[slot]]);
+                }
+                file.close();
+                if (file.fail()) {
+                    std::remove(tmpPath.c_str());
+                    return false;
+                }
+            }
+            return replaceFile(tmpPath, path);
+        }
+    }
+    return false;
+}
+
+bool PerfectHashFile::open(const std::string& path) {
+    if (!file.open(path) || file.size() < sizeof(Header)) return false;
+    memcpy(&header, file.data(), sizeof(Header));
+    if (memcmp(header.magic, "FSTMPH", 6) != 0 || header.version != 1) return false;
+    
+    uint64_t size = file.size();
+    if (header.keyCount > header.tableSize || header.bucketCount == 0 || header.bucketCount > UINT32_MAX ||
+        header.pilotsOffset + header.bucketCount * sizeof(uint32_t) > size ||
+        header.remapOffset + (header.tableSize - header.keyCount) * sizeof(uint64_t) > size ||
+        header.slotsOffset + header.keyCount * sizeof(uint64_t) > size ||
+        header.bloomOffset + header.bloomBlocks * 64 > size || header.bloomBlocks > UINT32_MAX ||
+        header.remapOffset % 8 != 0 || header.slotsOffset % 8 != 0 || header.bloomOffset % 8 != 0) {
+        return false;
+    }
+    
+    pilots = reinterpret_cast<const uint32_t*>(file.data() + header.pilotsOffset);
+    remap = reinterpret_cast<const uint64_t*>(file.data() + header.remapOffset);
+    slots = reinterpret_cast<const uint64_t*>(file.data() + header.slotsOffset);
+    if (header.bloomBlocks > 0) {
+        bloom.attach(reinterpret_cast<const uint64_t*>(file.data() + header.bloomOffset),
+                     static_cast<uint32_t>(header.bloomBlocks));
+    }
+    return true;
+}
+
+bool PerfectHashFile::at(size_t position, RecordView& out) const {
+    if (position >= header.keyCount) return false;
+    return readRecord(file.data(), file.size(), slots[position], out) != 0;
+}
+
+bool PerfectHashFile::search(const char* key, size_t length, RecordView& out) const {
+    if (header.keyCount == 0) return false;
+    
+    uint64_t h = hashBytes(key, length, header.seed);
+    uint64_t slot = position(h, pilots[bucketOf(h, header.bucketCount)], header.tableSize);
+    if (slot >= header.keyCount) slot = remap[slot - header.keyCount];
+    
+    return at(static_cast<size_t>(slot), out) && out.keyLength == length && memcmp(out.key, key, length) == 0;
+}
+
+// Scans every record of every file once to build the lookup table, so open
+// time and private memory grow with the key count; compile() writes a file
+// whose table is part of the mapping instead
+bool MappedDataStore::open(const std::vector<std::string>& paths, CollectionMap& cols) {
+    if (paths.size() > 256) return false;
+    bool success = true;
+    for (size_t i = 0; i < paths.size(); i++) {
+        files.emplace_back(new MappedFile());
+        versions.push_back(0);
+        filters.emplace_back();
+        // A missing or empty file is an empty database, as in LoadFromBinary
+        if (files.back()->open(paths[i]) && !scanFile(static_cast<uint8_t>(i), cols)) success = false;
+    }
+    
+    size_t capacity = 16;
+    while (capacity < records.size() + records.size() / 2) capacity <<= 1;
+    table.assign(capacity, 0);
+    tableMask = capacity - 1;
+    
+    // Keep the first record for a key, as ReadEntries does. Kept records are
+    // compacted to the front in place; find() only sees the kept prefix.
+    size_t kept = 0;
+    RecordView record;
+    for (size_t i = 0; i < records.size(); i++) {
+        uint64_t ref = records[i];
+        RecordView existing;
+        if (!parse(ref, record) || search(record.key, record.keyLength, existing)) continue;
+        
+        uint64_t h = hashBytes(record.key, record.keyLength, 0);
+        uint64_t slot = h & tableMask;
+        while (table[slot] != 0) slot = (slot + 1) & tableMask;
+        records[kept++] = ref;
+        table[slot] = (h >> 32) << 32 | kept;
+    }
+    records.resize(kept);
+    return success;
+}
+
+bool MappedDataStore::scanFile(uint8_t fileIndex, CollectionMap& cols) {
+    const MappedFile& file = *files[fileIndex];
+    if (file.size() < 9 || memcmp(file.data(), "FSTDB", 5) != 0) return true;
+    
+    uint32_t version;
+    memcpy(&version, file.data() + 5, sizeof(version));
+    if (version < 1 || version > 4) return false;
+    versions[fileIndex] = version;
+    
+    size_t pos = parseEntries(fileIndex, 9, nullptr, &records);
+    if (pos == 0) return false;
+    
+    if (version >= 3 && pos + 4 <= file.size()) {
+        uint32_t collectionCount;
+        memcpy(&collectionCount, file.data() + pos, sizeof(collectionCount));
+        pos += 4;
+        for (uint32_t i = 0; i < collectionCount && pos + 4 <= file.size(); i++) {
+            uint32_t nameLength;
+            memcpy(&nameLength, file.data() + pos, sizeof(nameLength));
+            if (nameLength == 0 || pos + 4 + nameLength > file.size()) return true;
+            std::string name(file.data() + pos + 4, nameLength);
+            pos = parseEntries(fileIndex, pos + 4 + nameLength, &cols[name], nullptr);
+            if (pos == 0) return true;
+        }
+    }
+    if (version >= 4 && pos < file.size()) filters[fileIndex].read(file.data() + pos, file.size() - pos);
+    return true;
+}
+
+// Walks one count-prefixed entry list starting at pos, either collecting
+// record references or copying entries into an index. Returns the position
+// after the list, or 0 if the count is unreadable. A truncated list ends
+// the walk early, like ReadEntries.
+size_t MappedDataStore::parseEntries(uint8_t fileIndex, size_t pos, Index* into, std::vector<uint64_t>* refs) const {
+    const MappedFile& file = *files[fileIndex];
+    const char* base = file.data();
+    size_t size = file.size();
+    
+    if (pos + 4 > size) return 0;
+    uint32_t count;
+    memcpy(&count, base + pos, sizeof(count));
+    if (count > 10000000) return 0;
+    pos += 4;
+    if (refs) refs->reserve(refs->size() + count);
+    
+    uint64_t fileTag = static_cast<uint64_t>(fileIndex) << FILE_SHIFT;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t ref = fileTag | pos;
+        RecordView record;
+        if (!parse(ref, record)) return size;
+        pos = static_cast<size_t>(record.value + record.valueLength - base);
+        if (record.type > Entry::INT32_ARRAY || record.keyLength == 0) continue;
+        if (refs) refs->push_back(ref);
+        if (into) {
+            into->emplace(std::string(record.key, record.keyLength),
+                          Entry(std::string(record.value, record.valueLength), record.type));
+        }
+    }
+    return pos;
+}
+
+bool MappedDataStore::parse(uint64_t ref, RecordView& out) const {
+    size_t fileIndex = static_cast<size_t>(ref >> FILE_SHIFT);
+    size_t pos = static_cast<size_t>(ref & ((1ULL << FILE_SHIFT) - 1));
+    const MappedFile& file = *files[fileIndex];
+    const char* base = file.data();
+    size_t size = file.size();
+    
+    uint32_t keyLength;
+    if (pos + 4 > size) return false;
+    memcpy(&keyLength, base + pos, sizeof(keyLength));
+    if (keyLength > 10000000 || pos + 4 + keyLength > size) return false;
+    out.key = base + pos + 4;
+    out.keyLength = keyLength;
+    pos += 4 + keyLength;
+    
+    uint8_t type = Entry::STRING;
+    if (versions[fileIndex] >= 2) {
+        if (pos + 1 > size) return false;
+        type = static_cast<uint8_t>(base[pos++]);
+    }
+    out.type = static_cast<Entry::Type>(type);
+    
+    uint32_t valueLength;
+    if (pos + 4 > size) return false;
+    memcpy(&valueLength, base + pos, sizeof(valueLength));
+    if (valueLength > 10000000 || pos + 4 + valueLength > size) return false;
+    out.value = base + pos + 4;
+    out.valueLength = valueLength;
+    return true;
+}
+
+bool MappedDataStore::at(size_t position, RecordView& out) const {
+    return position < records.size() && parse(records[position], out);
+}
+
+// Partitioned files hold only the keys of their partition, so only that
+// file's filter is probed
+const BloomFilter* MappedDataStore::filterFor(const char* key, size_t length) const {
+    if (filters.empty()) return nullptr;
+    return &filters[filters.size() > 1 ? partitionOfKey(key, length, filters.size()) : 0];
+}
+
+bool MappedDataStore::search(const char* key, size_t length, RecordView& out) const {
+    if (table.empty()) return false;
+    uint64_t h = hashBytes(key, length, 0);
+    uint64_t fingerprint = h >> 32;
+    for (uint64_t slot = h & tableMask; table[slot] != 0; slot = (slot + 1) & tableMask) {
+        if ((table[slot] >> 32) != fingerprint) continue;
+        if (parse(records[(table[slot] & 0xffffffffULL) - 1], out) &&
+            out.keyLength == length && memcmp(out.key, key, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void writeRecord(std::ostream& out, const RecordView& record) {
+    uint32_t keyLength = static_cast<uint32_t>(record.keyLength);
+    uint32_t valueLength = static_cast<uint32_t>(record.valueLength);
+    uint8_t type = record.type;
+    out.write(reinterpret_cast<const char*>(&keyLength), sizeof(keyLength));
+    out.write(reinterpret_cast<const char*>(&valueLength), sizeof(valueLength));
+    out.write(reinterpret_cast<const char*>(&type), sizeof(type));
+    out.write(record.key, record.keyLength);
+    out.write(record.value, record.valueLength);
+}
+
+uint64_t readRecord(const char* base, uint64_t end, uint64_t offset, RecordView& out) {
+    if (offset + RECORD_HEADER > end) return 0;
+    const char* record = base + offset;
+    uint32_t keyLength;
+    uint32_t valueLength;
+    memcpy(&keyLength, record, sizeof(keyLength));
+    memcpy(&valueLength, record + 4, sizeof(valueLength));
+    uint64_t next = offset + RECORD_HEADER + keyLength + valueLength;
+    if (next > end) return 0;
+    
+    out.type = static_cast<Entry::Type>(static_cast<uint8_t>(record[8]));
+    out.key = record + RECORD_HEADER;
+    out.keyLength = keyLength;
+    out.value = out.key + keyLength;
+    out.valueLength = valueLength;
+    return next;
+}
+
+bool SSTableFile::open(const std::string& path) {
+    if (!file.open(path) || file.size() < sizeof(Header)) return false;
+    memcpy(&header, file.data(), sizeof(Header));
+    if (memcmp(header.magic, "FSTSST", 6) != 0 || header.version != 1) return false;
+    
+    uint64_t size = file.size();
+    if (header.indexOffset < sizeof(Header) || header.indexOffset % 8 != 0 || header.bloomOffset % 8 != 0 ||
+        header.indexOffset + header.indexCount * sizeof(uint64_t) > size ||
+        header.bloomBlocks > UINT32_MAX || header.bloomOffset + header.bloomBlocks * 64 > size ||
+        header.indexCount != (header.count + INDEX_INTERVAL - 1) / INDEX_INTERVAL) {
+        return false;
+    }
+    
+    index = reinterpret_cast<const uint64_t*>(file.data() + header.indexOffset);
+    if (header.bloomBlocks > 0) {
+        bloom.attach(reinterpret_cast<const uint64_t*>(file.data() + header.bloomOffset),
+                     static_cast<uint32_t>(header.bloomBlocks));
+    }
+    return true;
+}
+
+uint64_t SSTableFile::next(uint64_t offset, RecordView& out) const {
+    if (offset == 0) return 0;
+    return readRecord(file.data(), header.indexOffset, offset, out);
+}
+
+bool SSTableFile::at(size_t position, RecordView& out) const {
+    if (position >= header.count) return false;
+    uint64_t offset = index[position / INDEX_INTERVAL];
+    for (size_t i = position % INDEX_INTERVAL; offset != 0; i--) {
+        offset = next(offset, out);
+        if (i == 0) return offset != 0;
+    }
+    return false;
+}
+
+static int compareKeys(const char* a, size_t aLength, const char* b, size_t bLength) {
+    int result = memcmp(a, b, std::min(aLength, bLength));
+    if (result != 0) return result;
+    return aLength < bLength ? -1 : (aLength > bLength ? 1 : 0);
+}
+
+bool SSTableFile::search(const char* key, size_t length, RecordView& out) const {
+    if (header.count == 0) return false;
+    
+    // Last sampled record whose key is <= the one searched for
+    size_t lo = 0;
+    size_t hi = static_cast<size_t>(header.indexCount);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (next(index[mid], out) == 0) return false;
+        if (compareKeys(out.key, out.keyLength, key, length) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) return false;
+    
+    uint64_t offset = index[lo - 1];
+    for (size_t i = 0; i < INDEX_INTERVAL && offset != 0; i++) {
+        offset = next(offset, out);
+        if (offset == 0) return false;
+        int order = compareKeys(out.key, out.keyLength, key, length);
+        if (order == 0) return true;
+        if (order > 0) return false;
+    }
+    return false;
+}
+
+bool SSTableBuilder::open(const std::string& target, uint64_t count, uint32_t bloomBitsPerKey) {
+    abort();
+    path = target;
+    tmpPath = target + ".tmp";
+    file.clear();
+    file.open(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+    
+    // The header is written again by finish() once the offsets are known
+    SSTableFile::Header header;
+    memset(&header, 0, sizeof(header));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    
+    filter = BloomFilter();
+    if (bloomBitsPerKey > 0 && count > 0) filter.init(count, bloomBitsPerKey);
+    sparse.clear();
+    sparse.reserve(count / SSTableFile::INDEX_INTERVAL + 1);
+    offset = sizeof(header);
+    added = 0;
+    previous.clear();
+    return true;
+}
+
+bool SSTableBuilder::add(const RecordView& record) {
+    std::string key(record.key, record.keyLength);
+    if (added > 0 && key <= previous) return false;
+    
+    if (added % SSTableFile::INDEX_INTERVAL == 0) sparse.push_back(offset);
+    writeRecord(file, record);
+    filter.add(record.key, record.keyLength);
+    offset += RECORD_HEADER + record.keyLength + record.valueLength;
+    added++;
+    previous.swap(key);
+    return true;
+}
+
+bool SSTableBuilder::finish() {
+    if (!file.is_open()) return false;
+    
+    SSTableFile::Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "FSTSST", 6);
+    header.version = 1;
+    header.count = added;
+    
+    static const char padding[8] = {0};
+    header.indexOffset = (offset + 7) & ~7ULL;
+    header.indexCount = sparse.size();
+    header.bloomOffset = header.indexOffset + sparse.size() * sizeof(uint64_t);
+    header.bloomBlocks = filter.blockCount();
+    file.write(padding, header.indexOffset - offset);
+    file.write(reinterpret_cast<const char*>(sparse.data()), sparse.size() * sizeof(uint64_t));
+    if (!filter.empty()) {
+        file.write(reinterpret_cast<const char*>(filter.blocks()), filter.byteSize());
+    }
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    if (file.fail() || !replaceFile(tmpPath, path)) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    tmpPath.clear();
+    return true;
+}
+
+void SSTableBuilder::abort() {
+    if (file.is_open()) file.close();
+    if (!tmpPath.empty()) std::remove(tmpPath.c_str());
+    tmpPath.clear();
+}
+
+} // namespace fastdb
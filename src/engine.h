@@ -0,0 +1,1134 @@
+// Storage engine of FastDB: the in-memory indexes, the file formats, the
+// write-ahead log and everything else that does not depend on Node. The
+// N-API addon (fastdb.cpp) wraps an Engine and only converts arguments and
+// results; C++ programs can link the libfastdb static library and use the
+// same public API. An Engine is not thread safe: calls must come from one
+// thread at a time, except for the static ones.
+#ifndef FASTDB_ENGINE_H
+#define FASTDB_ENGINE_H
+
+#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <unordered_set>
+#include <filesystem>
+#include <cstdio>
+#include <cmath>
+#include <set>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+
+namespace fastdb {
+
+class SimpleJSON {
+public:
+    struct Value {
+        enum Type { STRING, OBJECT, ARRAY, NUMBER, BOOLEAN, NULL_VALUE };
+        Type type;
+        std::string string_value;
+        std::unordered_map<std::string, Value> object_value;
+        std::vector<Value> array_value;
+        double number_value;
+        bool boolean_value;
+        
+        Value() : type(NULL_VALUE) {}
+        Value(const std::string& s) : type(STRING), string_value(s) {}
+        Value(double n) : type(NUMBER), number_value(n) {}
+        Value(bool b) : type(BOOLEAN), boolean_value(b) {}
+    };
+    
+    static Value parse(const std::string& json_str);
+    static std::string stringify(const Value& value);
+    static std::string escapeString(const std::string& str);
+    
+private:
+    static Value parseValue(const std::string& str, size_t& pos);
+    static Value parseObject(const std::string& str, size_t& pos);
+    static Value parseArray(const std::string& str, size_t& pos);
+    static std::string parseString(const std::string& str, size_t& pos);
+    static double parseNumber(const std::string& str, size_t& pos);
+    static void skipWhitespace(const std::string& str, size_t& pos);
+};
+
+// A stored value. Strings are kept as-is; numeric arrays are kept as packed
+// native-endian elements so they round-trip to TypedArrays without parsing.
+// With tiered storage, a cold entry's value lives only in the cold file at
+// [coldOffset, coldOffset + coldLength); a hot entry may keep a clean copy
+// there so demoting it again costs no write.
+struct Entry {
+    enum Type : uint8_t { STRING = 0, FLOAT64_ARRAY = 1, INT32_ARRAY = 2 };
+    std::string value;
+    uint64_t coldOffset;
+    uint32_t coldLength;
+    Type type;
+    uint8_t heat;
+    bool cold;
+    
+    Entry() : coldOffset(0), coldLength(0), type(STRING), heat(0), cold(false) {}
+    Entry(const std::string& v, Type t = STRING) : value(v), coldOffset(0), coldLength(0), type(t), heat(0), cold(false) {}
+    Entry(std::string&& v, Type t = STRING) : value(std::move(v)), coldOffset(0), coldLength(0), type(t), heat(0), cold(false) {}
+    
+    bool isNumericArray() const { return type != STRING; }
+};
+
+class NumericArray {
+public:
+    static size_t elementSize(Entry::Type type);
+    static size_t length(const Entry& entry);
+    static double sum(const Entry& entry);
+    static double min(const Entry& entry);
+    static double max(const Entry& entry);
+    
+private:
+    static double sumFloat64(const double* v, size_t n);
+    static double minFloat64(const double* v, size_t n);
+    static double maxFloat64(const double* v, size_t n);
+    static int64_t sumInt32(const int32_t* v, size_t n);
+    static int32_t minInt32(const int32_t* v, size_t n);
+    static int32_t maxInt32(const int32_t* v, size_t n);
+};
+
+typedef std::unordered_map<std::string, Entry> Index;
+typedef std::unordered_map<std::string, Index> CollectionMap;
+
+// FNV-1a followed by a 64-bit finalizer so every bit is well mixed; file
+// formats depend on it, so it must never change for a given seed
+uint64_t hashBytes(const char* key, size_t length, uint64_t seed);
+
+// CRC-32 (IEEE, reflected) for write-ahead log records
+uint32_t crc32(const char* data, size_t length);
+
+// Unix time in milliseconds, as stamped on log records and checkpoints
+uint64_t nowMillis();
+
+// Latency histogram with HDR-style log-linear buckets: every power of two
+// is split into 16 buckets, so a reported value is within 1/16 of the one
+// recorded. Values are nanoseconds, clamped to 2^40 (about 18 minutes).
+// record() is a relaxed increment in the calling thread's shard, so worker
+// threads can record without contending; snapshot() merges the shards.
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 4;
+    static const int MAX_EXPONENT = 40;
+    static const size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static const size_t BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+    static const size_t SHARDS = 4;
+    
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        std::vector<uint64_t> buckets;
+        
+        // Highest value of the bucket holding the p-th fraction of the
+        // samples, capped at max; 0 when nothing was recorded
+        uint64_t percentile(double p) const;
+        double mean() const { return count ? static_cast<double>(sum) / count : 0; }
+    };
+    
+    LatencyHistogram();
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+    
+    void record(uint64_t nanos);
+    Snapshot snapshot() const;
+    void reset();
+    
+    static size_t bucketOf(uint64_t nanos);
+    static uint64_t bucketMax(size_t bucket);
+    
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+    std::unique_ptr<Shard[]> shards;
+};
+
+// Records the time from construction to destruction in a histogram
+class LatencyTimer {
+public:
+    explicit LatencyTimer(LatencyHistogram* histogram)
+        : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~LatencyTimer() {
+        if (histogram) {
+            histogram->record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count()));
+        }
+    }
+    LatencyTimer(const LatencyTimer&) = delete;
+    LatencyTimer& operator=(const LatencyTimer&) = delete;
+    
+    // Records into another histogram, once the operation turns out to be
+    // a different kind
+    void retarget(LatencyHistogram* other) { histogram = other; }
+    
+private:
+    LatencyHistogram* histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Space-Saving top-k counter. It keeps at most `capacity` keys in a min-heap
+// by count; a key not yet tracked replaces the least counted one and
+// inherits its count as `error`, the most it can be overcounted by. Any key
+// seen more than total / capacity times is always tracked.
+class HotKeySketch {
+public:
+    struct Counter {
+        std::string key;
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        uint64_t error = 0;
+        uint64_t count() const { return reads + writes + error; }
+    };
+    
+    explicit HotKeySketch(size_t capacity);
+    void record(const std::string& key, bool write);
+    // The n most counted keys, most counted first
+    std::vector<Counter> top(size_t n) const;
+    void clear();
+    
+private:
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+    
+    size_t capacity;
+    std::vector<Counter> heap;
+    std::unordered_map<std::string, size_t> positions;
+};
+
+// Flushes a written file to stable storage. fsync applies to the file, not
+// the descriptor, so reopening it after the stream is closed is enough.
+// The time taken is recorded in latency when given.
+bool syncFile(const std::string& path, LatencyHistogram* latency = nullptr);
+
+// Makes a rename inside the directory holding path durable. Windows has no
+// directory handle to flush; its renames are journaled by NTFS.
+void syncDirectory(const std::string& path, LatencyHistogram* latency = nullptr);
+
+// Renames tmpPath over path. Windows refuses to rename onto an existing
+// file, so the target is removed and the rename retried there.
+bool replaceFile(const std::string& tmpPath, const std::string& path);
+
+// Blocked Bloom filter: each key maps to one 64-byte block (a cache line)
+// and sets one bit in each of its eight 64-bit words, so a probe is a
+// single memory access and eight mask tests.
+class BloomFilter {
+public:
+    BloomFilter() : external(nullptr), numBlocks(0) {}
+    
+    void init(size_t keyCount, uint32_t bitsPerKey);
+    void add(const char* key, size_t length);
+    bool mayContain(const char* key, size_t length) const;
+    bool empty() const { return numBlocks == 0; }
+    uint32_t blockCount() const { return numBlocks; }
+    size_t byteSize() const { return static_cast<size_t>(numBlocks) * WORDS_PER_BLOCK * sizeof(uint64_t); }
+    
+    void write(std::ostream& out) const;
+    bool read(std::istream& in);
+    // Same format from memory; returns the bytes used, or 0 if malformed
+    size_t read(const char* data, size_t size);
+    // Serves the filter from memory owned elsewhere (a file mapping)
+    void attach(const uint64_t* blocks, uint32_t count);
+    const uint64_t* blocks() const { return external ? external : words.data(); }
+    
+private:
+    static const size_t WORDS_PER_BLOCK = 8;
+    static void masks(uint64_t hash, uint64_t* out);
+    size_t blockOf(uint64_t hash) const;
+    
+    std::vector<uint64_t> words;
+    const uint64_t* external;
+    uint32_t numBlocks;
+};
+
+// A read-only mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() : base(nullptr), length(0) {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    bool open(const std::string& path);
+    void close();
+    const char* data() const { return base; }
+    size_t size() const { return length; }
+    
+private:
+    const char* base;
+    size_t length;
+};
+
+// One key/value pair as stored in a file, pointing into its mapping
+struct RecordView {
+    const char* key;
+    size_t keyLength;
+    const char* value;
+    size_t valueLength;
+    Entry::Type type;
+};
+
+// Records in compiled and sorted files: u32 key length, u32 value length,
+// u8 type, key bytes, value bytes
+const size_t RECORD_HEADER = 9;
+void writeRecord(std::ostream& out, const RecordView& record);
+// Parses the record at offset if it ends by `end`; returns the offset just
+// past it, or 0 if it is truncated
+uint64_t readRecord(const char* base, uint64_t end, uint64_t offset, RecordView& out);
+
+// A database file served directly from a mapping instead of being parsed
+// into an Index. Entries are addressed by position, 0..size()-1.
+class MappedStore {
+public:
+    MappedStore() : bloomProbes(0), bloomNegatives(0), bloomFalsePositives(0) {}
+    virtual ~MappedStore() {}
+    // Probes the store's Bloom filter first, so most misses are answered
+    // without touching the file
+    bool find(const char* key, size_t length, RecordView& out) const;
+    virtual bool at(size_t position, RecordView& out) const = 0;
+    virtual size_t size() const = 0;
+    
+    // Filter probes, the misses the filter answered, and the keys it let
+    // through that were not there
+    struct BloomCounts {
+        uint64_t probes = 0;
+        uint64_t negatives = 0;
+        uint64_t falsePositives = 0;
+    };
+    BloomCounts bloomCounts() const;
+    
+protected:
+    // The lookup itself, once the filter has let the key through
+    virtual bool search(const char* key, size_t length, RecordView& out) const = 0;
+    // The filter that would hold the key, or null when there is none
+    virtual const BloomFilter* filterFor(const char* key, size_t length) const = 0;
+    
+private:
+    mutable std::atomic<uint64_t> bloomProbes;
+    mutable std::atomic<uint64_t> bloomNegatives;
+    mutable std::atomic<uint64_t> bloomFalsePositives;
+};
+
+// Immutable file with a minimal perfect hash over its keys, PTHash style:
+// keys hash into buckets and each bucket stores the pilot that sends all of
+// its keys to distinct slots. A lookup is one hash, one pilot and one slot
+// read, then a single key comparison against the record. Slots past the key
+// count are remapped into the holes below it, keeping the slot table minimal.
+class PerfectHashFile : public MappedStore {
+public:
+    static bool build(const std::vector<RecordView>& records, const std::string& path, uint32_t bloomBitsPerKey);
+    
+    PerfectHashFile() : pilots(nullptr), remap(nullptr), slots(nullptr) {}
+    bool open(const std::string& path);
+    bool at(size_t position, RecordView& out) const override;
+    size_t size() const override { return static_cast<size_t>(header.keyCount); }
+    
+protected:
+    bool search(const char* key, size_t length, RecordView& out) const override;
+    const BloomFilter* filterFor(const char*, size_t) const override { return &bloom; }
+    
+private:
+    struct Header {
+        char magic[6];
+        uint16_t version;
+        uint64_t keyCount;
+        uint64_t bucketCount;
+        uint64_t tableSize;
+        uint64_t seed;
+        uint64_t pilotsOffset;
+        uint64_t remapOffset;
+        uint64_t slotsOffset;
+        uint64_t bloomOffset;
+        uint64_t bloomBlocks;
+    };
+    
+    static uint64_t bucketOf(uint64_t hash, uint64_t bucketCount);
+    static uint64_t position(uint64_t hash, uint32_t pilot, uint64_t tableSize);
+    
+    MappedFile file;
+    Header header;
+    const uint32_t* pilots;
+    const uint64_t* remap;
+    const uint64_t* slots;
+    BloomFilter bloom;
+};
+
+// Regular data files (one, or a partition set) served from mappings. Open
+// walks the default collection once to build an open-addressing table of
+// record references tagged with a hash fingerprint, so keys and values are
+// never copied and misses rarely touch the mapping. Each file's Bloom
+// filter footer is copied into memory and probed before the table. Named
+// collections are small and are loaded into memory as usual.
+class MappedDataStore : public MappedStore {
+public:
+    MappedDataStore() : tableMask(0) {}
+    bool open(const std::vector<std::string>& paths, CollectionMap& cols);
+    bool at(size_t position, RecordView& out) const override;
+    size_t size() const override { return records.size(); }
+    
+protected:
+    bool search(const char* key, size_t length, RecordView& out) const override;
+    const BloomFilter* filterFor(const char* key, size_t length) const override;
+    
+private:
+    // A record reference is the file index in the top byte and the offset
+    // of the record within that file below it
+    static const int FILE_SHIFT = 56;
+    bool scanFile(uint8_t fileIndex, CollectionMap& cols);
+    bool parse(uint64_t ref, RecordView& out) const;
+    size_t parseEntries(uint8_t fileIndex, size_t pos, Index* into, std::vector<uint64_t>* refs) const;
+    
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<uint32_t> versions;
+    std::vector<BloomFilter> filters;
+    std::vector<uint64_t> records;
+    // Slot = fingerprint << 32 | (record position + 1); 0 marks an empty slot
+    std::vector<uint64_t> table;
+    uint64_t tableMask;
+};
+
+// Immutable sorted table: records in ascending byte order of key, a sparse
+// index holding the offset of every INDEX_INTERVAL-th record, and a Bloom
+// filter. A lookup is a Bloom probe, a binary search over the sparse index
+// and a short forward scan.
+class SSTableFile : public MappedStore {
+public:
+    static const size_t INDEX_INTERVAL = 16;
+    
+    SSTableFile() : index(nullptr) {}
+    bool open(const std::string& path);
+    bool at(size_t position, RecordView& out) const override;
+    size_t size() const override { return static_cast<size_t>(header.count); }
+    
+    // Sequential access: start at firstRecord() and pass the returned
+    // offset back in; 0 means there are no more records
+    uint64_t firstRecord() const { return header.count > 0 ? sizeof(Header) : 0; }
+    uint64_t next(uint64_t offset, RecordView& out) const;
+    
+    struct Header {
+        char magic[6];
+        uint16_t version;
+        uint64_t count;
+        uint64_t indexOffset;
+        uint64_t indexCount;
+        uint64_t bloomOffset;
+        uint64_t bloomBlocks;
+    };
+    
+protected:
+    bool search(const char* key, size_t length, RecordView& out) const override;
+    const BloomFilter* filterFor(const char*, size_t) const override { return &bloom; }
+    
+private:
+    MappedFile file;
+    Header header;
+    const uint64_t* index;
+    BloomFilter bloom;
+};
+
+// Writes a sorted table file one record at a time, in ascending byte order
+// of key. It touches no database, so it can run on any thread.
+class SSTableBuilder {
+public:
+    SSTableBuilder() : offset(0), added(0) {}
+    ~SSTableBuilder() { abort(); }
+    SSTableBuilder(const SSTableBuilder&) = delete;
+    SSTableBuilder& operator=(const SSTableBuilder&) = delete;
+    
+    // count sizes the Bloom filter; it should match the records added
+    bool open(const std::string& path, uint64_t count, uint32_t bloomBitsPerKey);
+    // False when the key does not sort after the previous one
+    bool add(const RecordView& record);
+    // Writes the index and the filter and renames the file into place
+    bool finish();
+    // Removes the file being written
+    void abort();
+    
+private:
+    std::string path;
+    std::string tmpPath;
+    std::ofstream file;
+    BloomFilter filter;
+    std::vector<uint64_t> sparse;
+    uint64_t offset;
+    uint64_t added;
+    std::string previous;
+};
+
+// Options for Engine::open(); the same settings as the JavaScript
+// constructor options of the same names
+struct Options {
+    size_t memoryLimit = 0;
+    bool readOnly = false;
+    bool wal = false;
+    bool walSync = false;
+    uint64_t checkpointBytes = 64 * 1024 * 1024;
+    uint32_t retainCheckpoints = 0;
+    bool follow = false;
+    uint32_t bloomBitsPerKey = 10;
+    uint32_t partitions = 1;
+    std::vector<std::string> directories;
+    // Without a log, every write rewrites the dirty data files. When false,
+    // nothing is saved until checkpoint().
+    bool autoSync = true;
+    // Operations slower than this many milliseconds go to the slow log,
+    // which keeps the last slowLogSize of them; 0 turns it off
+    double slowLogThreshold = 0;
+    uint32_t slowLogSize = 128;
+    // One in hotKeySampling keyed gets and sets is counted for hotKeys();
+    // 0 turns it off
+    uint32_t hotKeySampling = 16;
+    // Leave the files unread: open() returns at once and the database is
+    // filled by the deferred load steps (startLoad() and the calls after it)
+    bool deferLoad = false;
+};
+
+class Engine {
+public:
+    Engine();
+    virtual ~Engine();
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+    
+    // Opens the database at filename, creating it on the first save. False
+    // with a message in error when the options are invalid.
+    bool open(const std::string& filename, const Options& options, std::string& error);
+    
+    // Reads a key of the default collection (dotted keys read the nested
+    // document). Numeric arrays are returned as their packed elements, with
+    // the element type in type when given.
+    bool get(const std::string& key, std::string& value, Entry::Type* type = nullptr);
+    // Stores a string value; false when the database does not accept writes
+    // or a dotted key cannot be set
+    bool put(const std::string& key, const std::string& value);
+    bool remove(const std::string& key);
+    bool contains(const std::string& key);
+    size_t size() const;
+    // Calls visit with every key of the default collection and its value, in
+    // no particular order, until it returns false. Numeric arrays are passed
+    // as their packed elements.
+    void scan(const std::function<bool(std::string_view key, std::string_view value)>& visit);
+    // Writes the data files now; with a log, the log then starts over
+    bool checkpoint();
+    // Rewrites every data file, changed or not
+    bool save();
+    // Reads the files again; a follower reloads them and then the log.
+    // False while a deferred load is running.
+    bool reload();
+    
+    // Why writes are refused: a deferred load still running, a follower,
+    // or files served from a mapping (readOnly or compiled)
+    enum WriteState { WRITABLE, LOADING, FOLLOWING, READ_ONLY };
+    WriteState writeState() const;
+    
+    static bool IsValidCollectionName(const std::string& name);
+    static bool IsValidFilename(const std::string& filename);
+    
+    // Named collections keep an index of their own in the same files. The
+    // calls below take a collection name, "" being the default collection.
+    // A collection that does not exist reads as empty; writes create it.
+    void createCollection(const std::string& name);
+    std::vector<std::string> collectionNames() const;
+    bool dropCollection(const std::string& name);
+    
+    // Reads a key without copying its value: out points into the index or
+    // a file mapping and stays valid until the database next changes. A
+    // dotted key reads the nested document into scratch and points there.
+    bool lookup(const std::string& collection, const std::string& key, RecordView& out, std::string& scratch);
+    // Stores a value; false when the database does not accept writes, or a
+    // dotted key cannot be set or would hold a numeric array
+    bool put(const std::string& collection, const std::string& key, Entry&& entry);
+    bool remove(const std::string& collection, const std::string& key);
+    bool contains(const std::string& collection, const std::string& key);
+    bool clear(const std::string& collection);
+    size_t size(const std::string& collection) const;
+    // Calls visit with every entry of a collection, in no particular order,
+    // until it returns false. With keysOnly, values held in the cold file
+    // are not read: value is null, and valueLength is still set.
+    void scan(const std::string& collection, const std::function<bool(const RecordView& record)>& visit,
+              bool keysOnly = false);
+    // Walks the default collection a few keys at a time, as Redis SCAN
+    // does: visit gets up to about count keys from cursor on, and the
+    // cursor to continue from is returned, 0 once every key was visited.
+    // Keys added or removed meanwhile may or may not be visited.
+    uint64_t scanFrom(uint64_t cursor, size_t count, const std::function<void(const char* key, size_t length)>& visit);
+    
+    // The numeric array at a key of the default collection, or null. Values
+    // served from a file are copied, since a mapping may be unaligned; the
+    // pointer is valid until the database next changes.
+    const Entry* numericArray(const std::string& key);
+    // Appends elements (a numeric array of either type) to the numeric
+    // array at a key, converting them to its element type the way storing
+    // into a typed array does, and sets length to the new length. False
+    // with error empty when the key holds no numeric array.
+    bool append(const std::string& key, const Entry& elements, size_t& length, std::string& error);
+    
+    // Runs writes as one batch: without a log, the files are saved once, by
+    // endBatch(), instead of after every write
+    void beginBatch();
+    bool endBatch();
+    
+    // Writes the default collection to an immutable file indexed by a
+    // minimal perfect hash; opening that file maps it instead of loading it
+    bool compile(const std::string& path, size_t& count);
+    // Links a file written by SSTableBuilder into the database as its newest
+    // sorted run: hard-linked (copied across filesystems) next to the
+    // database and never rewritten. Its keys override the current values.
+    bool ingest(const std::string& path, size_t& count, std::string& error);
+    // Projects the records under a nested path (e.g. "orders" holding
+    // orders.<id>.{total,status}) into a columnar file: one row per child
+    // object, ordered by id, one column per field, plus the id column
+    bool exportColumns(const std::string& nestedPath, const std::string& filename, size_t& rows, size_t& columns,
+                       std::string& error);
+    
+    // Export: snapshot() brings the data files up to date and opens them,
+    // sharing mapped files so their mappings stay valid, and writes made
+    // after it are not seen. exportSnapshot() writes the snapshot as NDJSON
+    // or as a data file; it never touches the database, so it can run on a
+    // worker thread, and reports progress every PROGRESS_INTERVAL entries.
+    enum ExportFormat { EXPORT_NDJSON, EXPORT_BINARY };
+    struct ExportProgress {
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+    };
+    struct ExportSnapshot {
+        std::vector<std::unique_ptr<std::ifstream>> files;
+        std::shared_ptr<MappedStore> store;
+        std::vector<std::shared_ptr<SSTableFile>> runs;
+        std::unordered_set<std::string> hidden;
+        // Entries expected, for progress reports
+        uint64_t total = 0;
+    };
+    static const uint64_t PROGRESS_INTERVAL = 65536;
+    bool snapshot(ExportSnapshot& out, std::string& error);
+    static bool exportSnapshot(ExportSnapshot& snapshot, const std::string& path, ExportFormat format,
+                               const std::function<void(const ExportProgress&)>& progress, ExportProgress& written,
+                               std::string& error);
+    
+    // Deferred load (Options::deferLoad), in steps. startLoad() picks the
+    // data files to stream; mapped files, and a layout that cannot be
+    // streamed, are loaded on the spot instead. readLoadFile() parses one
+    // file into batches on any thread without touching the database;
+    // mergeLoaded() adds batches to the indexes, and finishLoad() completes
+    // the load, on the database's thread. Reads see what has been merged;
+    // writes are refused until the load completes.
+    enum LoadStart { LOAD_STREAM, LOAD_DONE, LOAD_FAILED, LOAD_NOT_DEFERRED, LOAD_RUNNING };
+    struct LoadBatch {
+        bool inCollection = false;
+        std::string collection;
+        // Entries in the file section the batch came from, to size the index
+        uint32_t sectionCount = 0;
+        Index entries;
+    };
+    LoadStart startLoad(std::vector<std::string>& paths, std::string& error);
+    static bool readLoadFile(const std::string& path, size_t batchSize,
+                             const std::function<void(std::unique_ptr<LoadBatch>)>& push,
+                             std::atomic<uint64_t>& bytes, std::atomic<uint64_t>& keys);
+    void mergeLoaded(std::vector<std::unique_ptr<LoadBatch>>& batches);
+    // read says whether every file was read; false when the load failed
+    bool finishLoad(bool read, uint64_t bytes, uint64_t nanos);
+    
+    // Point-in-time restore (retainCheckpoints): rebuilds the state as of a
+    // sequence or a Unix time in ms from the newest checkpoint at or before
+    // it and the retained log, then checkpoints it. The records undone stay
+    // in the history, so a later restore can still reach any state between.
+    struct RestorePoint {
+        uint64_t sequence = 0;
+        uint64_t timestamp = 0;
+        uint64_t checkpoint = 0;
+        uint64_t records = 0;
+    };
+    bool restoreTo(uint64_t target, bool bySequence, RestorePoint& restored, std::string& error);
+    
+    // Followers: catchUp() applies the records appended since the last
+    // call and returns how many; promote() applies the rest of the log and
+    // takes it over once the leader has stopped. Both need a follower.
+    uint64_t catchUp();
+    bool promote();
+    // pendingBytes counts records written but not yet applied; lagMs is the
+    // age of the oldest of them
+    struct ReplicationStatus {
+        const char* role = "standalone";
+        uint64_t sequence = 0;
+        uint64_t pendingBytes = 0;
+        uint64_t lagMs = 0;
+        uint64_t appliedRecords = 0;
+        uint64_t reloads = 0;
+    };
+    ReplicationStatus replicationStatus();
+    
+    struct TierStats {
+        uint64_t memoryLimit = 0;
+        uint64_t hotBytes = 0;
+        uint64_t coldBytes = 0;
+        uint64_t coldEntries = 0;
+        uint64_t coldFileSize = 0;
+        uint64_t promotions = 0;
+        uint64_t demotions = 0;
+    };
+    TierStats tierStats() const;
+    // The oldest restore point is 0 when no checkpoint is retained
+    struct WalStats {
+        bool enabled = false;
+        uint64_t bytes = 0;
+        uint64_t records = 0;
+        uint64_t sequence = 0;
+        uint64_t checkpoints = 0;
+        uint64_t recoveredRecords = 0;
+        uint64_t truncatedBytes = 0;
+        uint32_t retainCheckpoints = 0;
+        uint64_t retainedCheckpoints = 0;
+        uint64_t retainedSegments = 0;
+        uint64_t oldestRestoreSequence = 0;
+        uint64_t oldestRestoreTimestamp = 0;
+    };
+    WalStats walStats() const;
+    
+    // Operations whose latency is recorded. Gets and sets of dotted keys
+    // are nested; save, load and compaction time whole data file writes,
+    // reads and cold file rewrites; fsync times every flush to disk,
+    // including those of log appends with walSync.
+    enum Operation { OP_GET, OP_SET, OP_NESTED_GET, OP_NESTED_SET, OP_SAVE, OP_LOAD, OP_COMPACTION, OP_FSYNC,
+                     OPERATION_COUNT };
+    static const char* operationName(Operation op);
+    LatencyHistogram::Snapshot latencyOf(Operation op) const { return latency[op].snapshot(); }
+    void resetLatency();
+    
+    // Where file I/O goes: log appends, replays and tailing; data files
+    // saved without a log, and read at load; data files written as
+    // checkpoints of the log; cold file demotions and reads; and cold file
+    // rewrites by compaction
+    enum IoSource { IO_LOG, IO_DATA, IO_CHECKPOINT, IO_COLD, IO_COMPACTION, IO_SOURCE_COUNT };
+    static const char* ioSourceName(IoSource source);
+    // I/O counters since the database was opened: bytes by where they went
+    // and by the timed operation that caused them (the set whose save
+    // rewrote the data files, the get that read the cold file), and the
+    // logical bytes each operation mutated, so written / logical is its
+    // write amplification
+    struct IoStats {
+        uint64_t logical = 0;
+        uint64_t written = 0;
+        uint64_t read = 0;
+        uint64_t writtenTo[IO_SOURCE_COUNT] = {};
+        uint64_t readFrom[IO_SOURCE_COUNT] = {};
+        uint64_t logicalBy[OPERATION_COUNT] = {};
+        uint64_t writtenBy[OPERATION_COUNT] = {};
+        uint64_t readBy[OPERATION_COUNT] = {};
+    };
+    IoStats ioStats() const;
+    // Bloom filter probes of the files served from disk (a readOnly or
+    // compiled file, and sorted runs) since they were opened
+    MappedStore::BloomCounts bloomCounts() const;
+    
+    // Heap bytes held by the in-memory indexes of every collection: hash
+    // table buckets and nodes, key strings, values, and the nested document
+    // that dotted keys live in. coldLive is the part of the cold file still
+    // referenced. Recounted by a pass over the indexes only after they
+    // have changed, so polling an idle database costs nothing.
+    struct MemoryUsage {
+        uint64_t index = 0;
+        uint64_t keys = 0;
+        uint64_t values = 0;
+        uint64_t nestedDocument = 0;
+        uint64_t coldLive = 0;
+    };
+    MemoryUsage memoryUsage();
+    
+    // Memory held for one key of the default collection, with allocator
+    // rounding and headers: the key string (0 when it is short enough to be
+    // stored inline), the value, and the hash node with its share of the
+    // bucket array. disk counts value bytes served from the cold file or a
+    // mapped file instead. A dotted key reports the bytes its subtree takes
+    // in the nested document as its value. False when the key is missing.
+    struct KeyMemory {
+        uint64_t key = 0;
+        uint64_t value = 0;
+        uint64_t node = 0;
+        uint64_t disk = 0;
+        uint64_t total() const { return key + value + node; }
+    };
+    bool keyMemory(const std::string& key, KeyMemory& out);
+    
+    // Memory of the default collection grouped by the first `depth`
+    // separator-delimited parts of each key, estimated from up to `samples`
+    // keys picked from random hash buckets and scaled to the whole index,
+    // and of the nested document grouped by its paths `depth` levels deep.
+    // Each list is sorted by bytes and cut to `limit` groups.
+    struct MemoryGroup {
+        std::string prefix;
+        uint64_t keys = 0;
+        uint64_t bytes = 0;
+    };
+    struct MemoryReport {
+        uint64_t totalKeys = 0;
+        uint64_t sampledKeys = 0;
+        std::vector<MemoryGroup> prefixes;
+        std::vector<MemoryGroup> nestedPaths;
+    };
+    MemoryReport memoryReport(uint32_t depth, char separator, size_t samples, size_t limit);
+    // The counters and gauges below, with the latency histograms as
+    // summaries, in the OpenMetrics text format
+    std::string metricsText();
+    
+    // An operation that took longer than slowLogThreshold, with the time
+    // it spent in each phase: hash table lookups and updates, parsing and
+    // serializing the nested document, and file I/O (log appends, saves and
+    // cold reads). Keys are cut to MAX_SLOW_KEY bytes.
+    enum Phase { PHASE_LOOKUP, PHASE_PARSE, PHASE_SERIALIZE, PHASE_IO, PHASE_COUNT };
+    static const size_t MAX_SLOW_KEY = 128;
+    struct SlowOperation {
+        uint64_t id;
+        uint64_t timestamp;
+        Operation operation;
+        std::string key;
+        uint64_t nanos;
+        uint64_t phases[PHASE_COUNT];
+    };
+    // The logged operations, newest first
+    std::vector<SlowOperation> slowLog() const;
+    void resetSlowLog();
+    
+    // The most accessed keys since the counts were last reset, from the
+    // sampled gets and sets. Counts are scaled up by the sampling rate, so
+    // they are estimates; error bounds how much `reads + writes` may be
+    // overcounted for a key that took over another's slot.
+    static const size_t HOT_KEY_CAPACITY = 1024;
+    struct HotKey {
+        std::string key;
+        double reads;
+        double writes;
+        double error;
+        double readRate;
+        double writeRate;
+    };
+    std::vector<HotKey> hotKeys(size_t n) const;
+    void resetHotKeys();
+    
+protected:
+    Index data;
+    // Named collections share the file and save path but keep separate indexes
+    CollectionMap collections;
+    std::string filename;
+    
+    // Partitioned mode: keys are hashed into one file per partition and
+    // `filename` holds a manifest listing them. Only dirty partitions are
+    // rewritten, and partitions are loaded and saved in parallel.
+    std::vector<std::string> partitionPaths;
+    std::vector<char> dirtyPartitions;
+    std::vector<std::string> obsoletePaths;
+    bool layoutChanged;
+    
+    // Tiered storage: once hot values exceed memoryLimit, the least
+    // frequently used are moved to `filename.cold` and promoted on access.
+    // hotBytes only grows between cooling passes, which recount it exactly.
+    static const size_t MIN_COLD_VALUE = 64;
+    size_t memoryLimit;
+    size_t hotBytes;
+    size_t nextCoolDown;
+    std::string coldPath;
+    std::fstream coldFile;
+    uint64_t coldFileSize;
+    std::mutex coldMutex;
+    uint64_t promotions;
+    uint64_t demotions;
+    
+    // Write-ahead log (wal option): each mutation is appended to
+    // `filename.wal` as one checksummed record instead of rewriting the data
+    // files, which are only rewritten by checkpoints once the log outgrows
+    // walCheckpointBytes. Opening replays the log over the data files and
+    // truncates a torn tail. Replaying records the last checkpoint already
+    // holds is harmless: every record carries a full value.
+    enum LogOp : uint8_t { LOG_PUT = 1, LOG_DELETE = 2, LOG_CLEAR = 3, LOG_DROP = 4 };
+    static const size_t LOG_HEADER = 5 + sizeof(uint32_t) + sizeof(uint64_t);
+    bool walEnabled;
+    bool walSync;
+    uint64_t walCheckpointBytes;
+    std::string walPath;
+    std::FILE* walFile;
+    std::string walBuffer;
+    uint64_t walBytes;
+    uint64_t walRecords;
+    uint64_t walSequence;
+    uint64_t checkpoints;
+    uint64_t recoveredRecords;
+    uint64_t truncatedBytes;
+    uint64_t walFirstSequence;
+    
+    // Point-in-time restore (retainCheckpoints option): every checkpoint
+    // keeps the state it installed as `filename.ckpt<sequence>` and moves the
+    // log it supersedes to `filename.wal<first sequence>`. The newest
+    // retainCheckpoints checkpoints and the segments after the oldest one are
+    // listed in `filename.history`. Checkpoint sequences are unique, so a
+    // sequence names exactly one state.
+    struct Checkpoint {
+        uint64_t sequence;
+        uint64_t timestamp;
+        std::string path;
+    };
+    struct LogSegment {
+        uint64_t firstSequence;
+        uint64_t lastSequence;
+        std::string path;
+    };
+    struct LogRecord {
+        uint64_t sequence;
+        uint64_t timestamp;
+        LogOp op;
+        std::string collection;
+        std::string key;
+        Entry entry;
+    };
+    uint32_t retainCheckpoints;
+    std::vector<Checkpoint> checkpointHistory;
+    std::vector<LogSegment> logSegments;
+    
+    // Bits per key of the Bloom filter footer written to each data file.
+    // Only readOnly opens load it (MappedDataStore): a key held in memory
+    // is found or missed by the hash lookup alone.
+    uint32_t bloomBitsPerKey;
+    
+    // readOnly: serve regular data files from shared mappings as well
+    bool readOnly;
+    
+    // Set when the file is served from a mapping (a compiled file); the
+    // in-memory indexes stay empty and every mutation is rejected
+    std::shared_ptr<MappedStore> store;
+    Entry storeScratch;
+    
+    // Sorted runs linked in by ingest(), oldest first. Default-collection
+    // lookups fall through the in-memory index to the runs, newest first.
+    // tombstones hide run keys deleted since, and runOnly counts visible run
+    // keys that the in-memory index does not shadow. Saved in `filename.runs`.
+    std::vector<std::shared_ptr<SSTableFile>> runs;
+    std::vector<std::string> runPaths;
+    std::unordered_set<std::string> tombstones;
+    uint64_t runOnly;
+    uint64_t nextRunId;
+    bool runsDirty;
+    
+    // deferLoad: open() leaves the files unread and the deferred load steps
+    // fill the indexes; loadingPaths is the partition layout being loaded
+    bool loading;
+    bool loadStarted;
+    std::vector<std::string> loadingPaths;
+    
+    // follow: tail the write-ahead log another process writes to the same
+    // files. catchUp() applies the records appended since the last call and
+    // moves on to the next log after a checkpoint; when records were missed,
+    // the data files are reloaded first. Writes throw until promote().
+    bool follower;
+    std::ifstream followFile;
+    uint64_t followFirstSequence;
+    uint64_t followOffset;
+    uint64_t followRecords;
+    uint64_t followReloads;
+    
+    // Saves are skipped while deferSave is set (a RESP server batch) or
+    // autoSync is off; savePending records that the files are behind.
+    bool autoSync;
+    bool deferSave;
+    bool savePending;
+    
+    LatencyHistogram latency[OPERATION_COUNT];
+    
+    // I/O accounting: logicalBytes counts the keys and values writes
+    // mutated, bytesWritten and bytesRead what went to and came from the
+    // data files, the log and the cold file, split by source and by the
+    // outermost timed operation, ioOperation (OPERATION_COUNT outside one).
+    // Partition writers and loaders update them from their own threads
+    // while the operation that started them waits.
+    std::atomic<uint64_t> logicalBytes;
+    std::atomic<uint64_t> bytesWritten;
+    std::atomic<uint64_t> bytesRead;
+    std::atomic<uint64_t> writtenTo[IO_SOURCE_COUNT];
+    std::atomic<uint64_t> readFrom[IO_SOURCE_COUNT];
+    std::atomic<uint64_t> logicalBy[OPERATION_COUNT];
+    std::atomic<uint64_t> writtenBy[OPERATION_COUNT];
+    std::atomic<uint64_t> readBy[OPERATION_COUNT];
+    Operation ioOperation;
+    void countLogical(uint64_t bytes);
+    void countWrite(IoSource source, uint64_t bytes);
+    void countRead(IoSource source, uint64_t bytes, Operation op);
+    void countRead(IoSource source, uint64_t bytes) { countRead(source, bytes, ioOperation); }
+    // Reads served from memory and reads that had to go to the cold file
+    uint64_t cacheHits;
+    uint64_t cacheMisses;
+    // Bumped whenever the indexes change, so memoryUsage() knows when its
+    // last count is stale
+    uint64_t changes;
+    uint64_t censusChanges;
+    MemoryUsage census;
+    
+    // Slow log: a ring of slowLogSize entries, the next one written at
+    // slowLogged % slowLogSize. While an operation is being timed, its
+    // phase times add up in tracePhases; phases are only timed while the
+    // log is on.
+    uint64_t slowLogThreshold;
+    size_t slowLogSize;
+    std::vector<SlowOperation> slowOperations;
+    uint64_t slowLogged;
+    bool tracing;
+    bool inPhase;
+    uint64_t tracePhases[PHASE_COUNT];
+    
+    // Hot keys: outermost keyed operations are sampled one in
+    // hotKeySampling into the sketch
+    uint32_t hotKeySampling;
+    HotKeySketch hotKeySketch;
+    std::chrono::steady_clock::time_point hotKeysSince;
+    void sampleHotKey(Operation op, const std::string& key);
+    
+    // Times a get, set, save, load or compaction: records its latency and
+    // logs it if it was slow. Timers opened inside another one (the save a
+    // set runs) only record their latency; the outer one owns the trace.
+    class OperationTimer {
+    public:
+        OperationTimer(Engine& engine, Operation op, const std::string* key = nullptr);
+        ~OperationTimer();
+        OperationTimer(const OperationTimer&) = delete;
+        OperationTimer& operator=(const OperationTimer&) = delete;
+        void retarget(Operation other) {
+            op = other;
+            if (outermost) engine.ioOperation = other;
+        }
+        
+    private:
+        Engine& engine;
+        Operation op;
+        const std::string* key;
+        bool outermost;
+        std::chrono::steady_clock::time_point start;
+    };
+    
+    // Adds the time until it goes out of scope to one phase of the traced
+    // operation. Phases do not nest: an inner timer adds nothing.
+    class PhaseTimer {
+    public:
+        PhaseTimer(Engine& engine, Phase phase);
+        ~PhaseTimer();
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+        
+    private:
+        Engine& engine;
+        Phase phase;
+        bool active;
+        std::chrono::steady_clock::time_point start;
+    };
+    
+    void logSlowOperation(Operation op, const std::string* key, uint64_t nanos);
+    
+    // Applies the options to a database that has not been loaded yet
+    bool configure(const std::string& filename, const Options& options, std::string& error);
+    // Reads the files, or for a follower, the files and then the log
+    void load();
+    bool writable() const;
+    
+    // Writes export snapshots; see exportSnapshot()
+    struct SnapshotWriter;
+    
+    // The index of a collection, or null when it does not exist
+    Index* findCollection(const std::string& collection);
+    const Index* findCollection(const std::string& collection) const;
+    
+    // Core operations shared by the default index and named collections
+    bool setString(Index& index, const std::string& key, std::string&& value);
+    bool eraseKey(Index& index, const std::string& key);
+    bool containsKey(Index& index, const std::string& key);
+    
+    bool SaveToBinary();
+    bool LoadFromBinary();
+    bool ReadLayout(std::string& magic, std::vector<std::string>& loadedPaths);
+    bool FinishLoad(const std::vector<std::string>& loadedPaths);
+    
+    // Write-ahead log helpers
+    bool persist(LogOp op, const Index& index, const std::string& key);
+    bool persistIn(LogOp op, const std::string& collection, const std::string& key, const Entry* entry);
+    bool saveOrDefer();
+    bool appendLog(LogOp op, const std::string& collection, const std::string& key, const Entry* entry);
+    bool ReplayLog();
+    void applyLogRecord(LogOp op, const std::string& collection, const std::string& key, Entry&& entry);
+    static bool readLogHeader(std::ifstream& file, uint64_t& firstSequence);
+    static bool readLogRecord(std::ifstream& file, std::string& payload, LogRecord& record, uint64_t& size);
+    bool startLog();
+    void closeLog();
+    
+    // Point-in-time restore helpers
+    bool archiveCheckpoint();
+    bool WriteCheckpoint(const std::string& path);
+    bool WriteHistory();
+    bool LoadHistory();
+    bool readLogRange(const std::string& path, uint64_t after, bool bySequence, uint64_t target,
+                      std::vector<LogRecord>& records, bool& done);
+    void applyLogRecords(std::vector<LogRecord>& records);
+    
+    // Follower helpers
+    bool reloadFollower();
+    uint64_t followLog();
+    uint64_t drainFollowLog();
+    bool WriteDataFile(const std::string& path, int partition, bool withRuns = false);
+    bool WriteDataStream(std::ofstream& file, int partition, bool withRuns);
+    bool ReadDataFile(const std::string& path, Index& index, CollectionMap& cols);
+    bool WriteManifest();
+    static bool ReadManifest(std::ifstream& file, std::vector<std::string>& paths);
+    static void WriteString(std::ofstream& file, const std::string& str);
+    static std::string ReadString(std::ifstream& file);
+    bool WriteEntries(std::ofstream& file, const Index& index, int partition, bool withRuns = false);
+    bool ReadEntries(std::ifstream& file, uint32_t version, Index& index);
+    int partitionOf(const std::string& key) const;
+    void markDirty(const std::string& key);
+    void markAllDirty();
+    
+    // Tiered storage helpers
+    Entry& touch(Entry& entry);
+    void accountHot(size_t bytes, const Entry* pinned);
+    void admitLoaded(Entry& entry);
+    void coolDown(const Entry* pinned);
+    bool demote(Entry& entry);
+    bool demoteLocked(Entry& entry);
+    std::string readCold(const Entry& entry);
+    size_t valueSize(const Entry& entry) const;
+    void resetColdFile();
+    void compactColdFile();
+    
+    // Mapped (read-only) store helpers
+    bool findStoredRoot(SimpleJSON::Value& root);
+    
+    // Sorted run helpers
+    bool findInRuns(const std::string& key, RecordView& out, bool includeHidden = false);
+    void shadowRunKey(Index& index, const std::string& key);
+    bool hideRunKey(Index& index, const std::string& key, bool counted);
+    bool loadRoot(Index& index, SimpleJSON::Value& root);
+    void forEachRunRecord(const std::function<void(const RecordView&)>& visit);
+    bool runRecordVisible(size_t run, const RecordView& record);
+    std::string runPath(uint64_t id) const;
+    bool WriteRunsManifest();
+    bool LoadRuns();
+    void dropRuns();
+    
+    // Nested property helpers
+    std::vector<std::string> splitPath(const std::string& path);
+    bool setNestedProperty(SimpleJSON::Value& root, const std::vector<std::string>& path, const std::string& value);
+    std::string getNestedProperty(const SimpleJSON::Value& root, const std::vector<std::string>& path);
+    bool deleteNestedProperty(SimpleJSON::Value& root, const std::vector<std::string>& path);
+    bool hasNestedProperty(const SimpleJSON::Value& root, const std::vector<std::string>& path);
+};
+
+} // namespace fastdb
+
+#endif
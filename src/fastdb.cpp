@@ -1,48 +1,33 @@
 #include <napi.h>
-#include <unordered_map>
-#include <string>
-#include <fstream>
-#include <sstream>
-#include <cstdint>
-#include <stdexcept>
-#include <vector>
-#include <algorithm>
-
-class SimpleJSON {
-public:
-    struct Value {
-        enum Type { STRING, OBJECT, ARRAY, NUMBER, BOOLEAN, NULL_VALUE };
-        Type type;
-        std::string string_value;
-        std::unordered_map<std::string, Value> object_value;
-        std::vector<Value> array_value;
-        double number_value;
-        bool boolean_value;
-        
-        Value() : type(NULL_VALUE) {}
-        Value(const std::string& s) : type(STRING), string_value(s) {}
-        Value(double n) : type(NUMBER), number_value(n) {}
-        Value(bool b) : type(BOOLEAN), boolean_value(b) {}
-    };
-    
-    static Value parse(const std::string& json_str);
-    static std::string stringify(const Value& value);
-    
-private:
-    static Value parseValue(const std::string& str, size_t& pos);
-    static Value parseObject(const std::string& str, size_t& pos);
-    static Value parseArray(const std::string& str, size_t& pos);
-    static std::string parseString(const std::string& str, size_t& pos);
-    static double parseNumber(const std::string& str, size_t& pos);
-    static void skipWhitespace(const std::string& str, size_t& pos);
-    static std::string escapeString(const std::string& str);
-};
+#include "engine.h"
+
+#include <cerrno>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+using namespace fastdb;
+
+class RespServer;
+
+// The JavaScript class: converts arguments and results and leaves the work
+// to the engine it wraps
 class FastDB : public Napi::ObjectWrap<FastDB> {
+    friend class Collection;
+    friend class RespServer;
+    
 private:
-    std::unordered_map<std::string, std::string> data;
-    std::string filename;
-
+    Engine engine;
+    // Embedded RESP server (startServer)
+    RespServer* server;
+    
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
     FastDB(const Napi::CallbackInfo& info);
@@ -55,155 +40,226 @@ public:
     Napi::Value Size(const Napi::CallbackInfo& info);
     Napi::Value Keys(const Napi::CallbackInfo& info);
     Napi::Value Values(const Napi::CallbackInfo& info);
+    Napi::Value KeysPacked(const Napi::CallbackInfo& info);
+    Napi::Value EntriesPacked(const Napi::CallbackInfo& info);
+    Napi::Value Append(const Napi::CallbackInfo& info);
+    Napi::Value Slice(const Napi::CallbackInfo& info);
+    Napi::Value Sum(const Napi::CallbackInfo& info);
+    Napi::Value Min(const Napi::CallbackInfo& info);
+    Napi::Value Max(const Napi::CallbackInfo& info);
     Napi::Value Save(const Napi::CallbackInfo& info);
     Napi::Value Load(const Napi::CallbackInfo& info);
+    Napi::Value GetCollection(const Napi::CallbackInfo& info);
+    Napi::Value ListCollections(const Napi::CallbackInfo& info);
+    Napi::Value DropCollection(const Napi::CallbackInfo& info);
+    Napi::Value TierStats(const Napi::CallbackInfo& info);
+    Napi::Value WalStats(const Napi::CallbackInfo& info);
+    Napi::Value Metrics(const Napi::CallbackInfo& info);
+    Napi::Value MetricsText(const Napi::CallbackInfo& info);
+    Napi::Value SlowLog(const Napi::CallbackInfo& info);
+    Napi::Value MemoryUsageOf(const Napi::CallbackInfo& info);
+    Napi::Value HotKeys(const Napi::CallbackInfo& info);
+    Napi::Value MemoryReportOf(const Napi::CallbackInfo& info);
+    Napi::Value RestoreTo(const Napi::CallbackInfo& info);
+    Napi::Value CatchUp(const Napi::CallbackInfo& info);
+    Napi::Value ReplicationStatus(const Napi::CallbackInfo& info);
+    Napi::Value Promote(const Napi::CallbackInfo& info);
+    Napi::Value StartServer(const Napi::CallbackInfo& info);
+    Napi::Value StopServer(const Napi::CallbackInfo& info);
+    Napi::Value ServerStats(const Napi::CallbackInfo& info);
+    Napi::Value Compile(const Napi::CallbackInfo& info);
+    Napi::Value ExportTo(const Napi::CallbackInfo& info);
+    Napi::Value LoadAsync(const Napi::CallbackInfo& info);
+    Napi::Value ExportColumns(const Napi::CallbackInfo& info);
+    Napi::Value Ingest(const Napi::CallbackInfo& info);
+    static Napi::Value BuildFile(const Napi::CallbackInfo& info);
+    
+private:
+    // Operations shared by the default collection ("") and named collections
+    Napi::Value SetIn(const std::string& collection, const Napi::CallbackInfo& info);
+    Napi::Value GetIn(const std::string& collection, const Napi::CallbackInfo& info);
+    Napi::Value DeleteIn(const std::string& collection, const Napi::CallbackInfo& info);
+    Napi::Value HasIn(const std::string& collection, const Napi::CallbackInfo& info);
+    Napi::Value ClearIn(const std::string& collection, const Napi::CallbackInfo& info);
+    Napi::Value SizeIn(const std::string& collection, const Napi::CallbackInfo& info);
+    Napi::Value KeysIn(const std::string& collection, const Napi::CallbackInfo& info);
+    Napi::Value ValuesIn(const std::string& collection, const Napi::CallbackInfo& info);
     
+    bool ParseOptions(Napi::Env env, const Napi::Value& value, Options& options);
+    
+    // Throws the reason writes are refused, if they are
+    bool rejectWrite(Napi::Env env);
+    
+    static std::string convertToString(const Napi::Value& value);
+    static Napi::Value toJS(Napi::Env env, const RecordView& record);
+    
+    // Numeric array helpers
+    static bool toNumericArray(const Napi::Value& value, Entry& out);
+    static bool toNumbers(const Napi::Value& value, Entry& out);
+    static Napi::Value toTypedArray(Napi::Env env, const Entry& entry, size_t start, size_t end);
+    const Entry* findNumericArray(const Napi::CallbackInfo& info);
+    
+    // The I/O counters as of the last metrics({ reset: true })
+    Engine::IoStats ioBaseline;
+};
+
+// A named collection handle returned by db.collection(name). It holds a
+// reference to its database so the database outlives every handle.
+class Collection : public Napi::ObjectWrap<Collection> {
 private:
-    bool SaveToBinary();
-    bool LoadFromBinary();
-    void WriteString(std::ofstream& file, const std::string& str);
-    std::string ReadString(std::ifstream& file);
-    bool IsValidFilename(const std::string& filename);
-    
-    // Nested property helpers
-    std::vector<std::string> splitPath(const std::string& path);
-    bool setNestedProperty(SimpleJSON::Value& root, const std::vector<std::string>& path, const std::string& value);
-    std::string getNestedProperty(const SimpleJSON::Value& root, const std::vector<std::string>& path);
-    bool deleteNestedProperty(SimpleJSON::Value& root, const std::vector<std::string>& path);
-    bool hasNestedProperty(const SimpleJSON::Value& root, const std::vector<std::string>& path);
-    std::string convertToString(const Napi::Value& value);
+    FastDB* db;
+    std::string name;
+    Napi::ObjectReference dbRef;
+    
+public:
+    static Napi::Function Init(Napi::Env env);
+    Collection(const Napi::CallbackInfo& info);
+    
+    Napi::Value Set(const Napi::CallbackInfo& info);
+    Napi::Value Get(const Napi::CallbackInfo& info);
+    Napi::Value Delete(const Napi::CallbackInfo& info);
+    Napi::Value Has(const Napi::CallbackInfo& info);
+    Napi::Value Clear(const Napi::CallbackInfo& info);
+    Napi::Value Size(const Napi::CallbackInfo& info);
+    Napi::Value Keys(const Napi::CallbackInfo& info);
+    Napi::Value Values(const Napi::CallbackInfo& info);
+    Napi::Value Name(const Napi::CallbackInfo& info);
+};
+
+struct AddonData {
+    Napi::FunctionReference fastdb;
+    Napi::FunctionReference collection;
 };
 
-FastDB::FastDB(const Napi::CallbackInfo& info) : Napi::ObjectWrap<FastDB>(info) {
+FastDB::FastDB(const Napi::CallbackInfo& info) : Napi::ObjectWrap<FastDB>(info), server(nullptr) {
     Napi::Env env = info.Env();
     
+    std::string filename = "fastdb.bin";
     if (info.Length() > 0 && info[0].IsString()) {
-        std::string filename = info[0].As<Napi::String>().Utf8Value();
-        if (!IsValidFilename(filename)) {
+        filename = info[0].As<Napi::String>().Utf8Value();
+        if (!Engine::IsValidFilename(filename)) {
             Napi::TypeError::New(env, "Invalid filename").ThrowAsJavaScriptException();
             return;
         }
-        this->filename = filename;
-    } else {
-        this->filename = "fastdb.bin";
     }
     
-    LoadFromBinary();
-}
-
-bool FastDB::IsValidFilename(const std::string& filename) {
-    if (filename.empty() || filename.length() > 255) return false;
-    
-    std::string invalid_chars = "<>:\"|?*";
-    for (char c : invalid_chars) {
-        if (filename.find(c) != std::string::npos) return false;
+    Options options;
+    if (info.Length() > 1 && info[1].IsObject() && !ParseOptions(env, info[1], options)) {
+        return;
+    }
+    std::string error;
+    if (!engine.open(filename, options, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
     }
-    return true;
 }
 
-void FastDB::WriteString(std::ofstream& file, const std::string& str) {
-    if (!file.is_open()) return;
+// Converts the JS options and throws on values of the wrong type or out of
+// range; the combinations are checked by Engine::open()
+bool FastDB::ParseOptions(Napi::Env env, const Napi::Value& value, Options& parsed) {
+    Napi::Object options = value.As<Napi::Object>();
     
-    uint32_t length = static_cast<uint32_t>(str.length());
-    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
-    if (length > 0) {
-        file.write(str.c_str(), length);
+    Napi::Value limit = options.Get("memoryLimit");
+    if (!limit.IsUndefined()) {
+        if (!limit.IsNumber() || limit.As<Napi::Number>().DoubleValue() < 0) {
+            Napi::RangeError::New(env, "memoryLimit must be a number of bytes").ThrowAsJavaScriptException();
+            return false;
+        }
+        parsed.memoryLimit = static_cast<size_t>(limit.As<Napi::Number>().DoubleValue());
     }
-}
-
-std::string FastDB::ReadString(std::ifstream& file) {
-    if (!file.is_open()) return "";
     
-    uint32_t length;
-    file.read(reinterpret_cast<char*>(&length), sizeof(length));
-    if (file.fail() || file.eof() || length > 10000000) return "";
+    Napi::Value readOnlyOption = options.Get("readOnly");
+    parsed.readOnly = readOnlyOption.IsBoolean() && readOnlyOption.As<Napi::Boolean>().Value();
+    
+    Napi::Value deferLoad = options.Get("deferLoad");
+    parsed.deferLoad = deferLoad.IsBoolean() && deferLoad.As<Napi::Boolean>().Value();
     
-    if (length == 0) return "";
+    Napi::Value wal = options.Get("wal");
+    parsed.wal = wal.IsBoolean() && wal.As<Napi::Boolean>().Value();
+    Napi::Value walSyncOption = options.Get("walSync");
+    parsed.walSync = walSyncOption.IsBoolean() && walSyncOption.As<Napi::Boolean>().Value();
+    Napi::Value checkpointBytes = options.Get("checkpointBytes");
+    if (!checkpointBytes.IsUndefined()) {
+        if (!checkpointBytes.IsNumber() || checkpointBytes.As<Napi::Number>().DoubleValue() < 1) {
+            Napi::RangeError::New(env, "checkpointBytes must be a positive number of bytes").ThrowAsJavaScriptException();
+            return false;
+        }
+        parsed.checkpointBytes = static_cast<uint64_t>(checkpointBytes.As<Napi::Number>().DoubleValue());
+    }
+    Napi::Value retain = options.Get("retainCheckpoints");
+    if (!retain.IsUndefined()) {
+        double value = retain.IsNumber() ? retain.As<Napi::Number>().DoubleValue() : -1;
+        if (value < 0 || value > 1000) {
+            Napi::RangeError::New(env, "retainCheckpoints must be 0-1000").ThrowAsJavaScriptException();
+            return false;
+        }
+        parsed.retainCheckpoints = static_cast<uint32_t>(value);
+    }
     
-    std::string str(length, '\0');
-    file.read(&str[0], length);
-    if (file.fail() || file.eof()) return "";
+    Napi::Value follow = options.Get("follow");
+    parsed.follow = follow.IsBoolean() && follow.As<Napi::Boolean>().Value();
     
-    return str;
-}
-
-bool FastDB::SaveToBinary() {
-    try {
-        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
-        if (!file.is_open()) return false;
-        
-        file.rdbuf()->pubsetbuf(nullptr, 32768);
-        
-        const char magic[] = "FSTDB";
-        file.write(magic, 5);
-        
-        uint32_t version = 1;
-        file.write(reinterpret_cast<const char*>(&version), sizeof(version));
-        
-        uint32_t count = static_cast<uint32_t>(data.size());
-        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
-        
-        for (const auto& pair : data) {
-            WriteString(file, pair.first);
-            WriteString(file, pair.second);
-            if (file.fail()) return false;
+    Napi::Value bits = options.Get("bloomBitsPerKey");
+    if (!bits.IsUndefined()) {
+        double value = bits.IsNumber() ? bits.As<Napi::Number>().DoubleValue() : -1;
+        if (value < 0 || value > 64) {
+            Napi::RangeError::New(env, "bloomBitsPerKey must be 0-64").ThrowAsJavaScriptException();
+            return false;
         }
-        
-        file.flush();
-        file.close();
-        return file.good();
-    } catch (...) {
-        return false;
+        parsed.bloomBitsPerKey = static_cast<uint32_t>(value);
     }
-}
-
-bool FastDB::LoadFromBinary() {
-    try {
-        std::ifstream file(filename, std::ios::binary);
-        if (!file.is_open()) return true;
-        
-        file.rdbuf()->pubsetbuf(nullptr, 32768);
-        
-        char magic[6] = {0};
-        file.read(magic, 5);
-        if (file.fail() || std::string(magic) != "FSTDB") {
-            file.close();
-            return true;
+    
+    Napi::Value threshold = options.Get("slowLogThreshold");
+    if (!threshold.IsUndefined()) {
+        double value = threshold.IsNumber() ? threshold.As<Napi::Number>().DoubleValue() : -1;
+        if (!(value >= 0)) {
+            Napi::RangeError::New(env, "slowLogThreshold must be a number of milliseconds").ThrowAsJavaScriptException();
+            return false;
         }
-        
-        uint32_t version;
-        file.read(reinterpret_cast<char*>(&version), sizeof(version));
-        if (file.fail() || version != 1) {
-            file.close();
+        parsed.slowLogThreshold = value;
+    }
+    Napi::Value slowLogSize = options.Get("slowLogSize");
+    if (!slowLogSize.IsUndefined()) {
+        double value = slowLogSize.IsNumber() ? slowLogSize.As<Napi::Number>().DoubleValue() : -1;
+        if (value < 1 || value > 100000) {
+            Napi::RangeError::New(env, "slowLogSize must be 1-100000").ThrowAsJavaScriptException();
             return false;
         }
-        
-        uint32_t count;
-        file.read(reinterpret_cast<char*>(&count), sizeof(count));
-        if (file.fail() || count > 10000000) {
-            file.close();
+        parsed.slowLogSize = static_cast<uint32_t>(value);
+    }
+    Napi::Value sampling = options.Get("hotKeySampling");
+    if (!sampling.IsUndefined()) {
+        double value = sampling.IsNumber() ? sampling.As<Napi::Number>().DoubleValue() : -1;
+        if (value < 0 || value > 65536) {
+            Napi::RangeError::New(env, "hotKeySampling must be 0-65536").ThrowAsJavaScriptException();
             return false;
         }
-        
-        data.clear();
-        data.reserve(count);
-        
-        for (uint32_t i = 0; i < count; i++) {
-            std::string key = ReadString(file);
-            std::string value = ReadString(file);
-            
-            if (file.fail() || file.eof()) break;
-            if (!key.empty()) {
-                data.emplace(std::move(key), std::move(value));
+        parsed.hotKeySampling = static_cast<uint32_t>(value);
+    }
+    
+    Napi::Value partitions = options.Get("partitions");
+    if (partitions.IsUndefined()) return true;
+    
+    uint32_t count = partitions.IsNumber() ? partitions.As<Napi::Number>().Uint32Value() : 0;
+    if (count < 1 || count > 256) {
+        Napi::RangeError::New(env, "partitions must be 1-256").ThrowAsJavaScriptException();
+        return false;
+    }
+    parsed.partitions = count;
+    if (count == 1) return true;
+    
+    Napi::Value dirs = options.Get("directories");
+    if (dirs.IsArray()) {
+        Napi::Array array = dirs.As<Napi::Array>();
+        for (uint32_t i = 0; i < array.Length(); i++) {
+            Napi::Value dir = array.Get(i);
+            if (!dir.IsString()) {
+                Napi::TypeError::New(env, "directories must be an array of strings").ThrowAsJavaScriptException();
+                return false;
             }
+            parsed.directories.push_back(dir.As<Napi::String>().Utf8Value());
         }
-        
-        file.close();
-        return true;
-    } catch (...) {
-        data.clear();
-        return false;
     }
+    return true;
 }
 
 Napi::Object FastDB::Init(Napi::Env env, Napi::Object exports) {
@@ -216,21 +272,59 @@ Napi::Object FastDB::Init(Napi::Env env, Napi::Object exports) {
         InstanceMethod("size", &FastDB::Size),
         InstanceMethod("keys", &FastDB::Keys),
         InstanceMethod("values", &FastDB::Values),
+        InstanceMethod("keysPacked", &FastDB::KeysPacked),
+        InstanceMethod("entriesPacked", &FastDB::EntriesPacked),
+        InstanceMethod("append", &FastDB::Append),
+        InstanceMethod("slice", &FastDB::Slice),
+        InstanceMethod("sum", &FastDB::Sum),
+        InstanceMethod("min", &FastDB::Min),
+        InstanceMethod("max", &FastDB::Max),
         InstanceMethod("save", &FastDB::Save),
-        InstanceMethod("load", &FastDB::Load)
+        InstanceMethod("load", &FastDB::Load),
+        InstanceMethod("collection", &FastDB::GetCollection),
+        InstanceMethod("collections", &FastDB::ListCollections),
+        InstanceMethod("dropCollection", &FastDB::DropCollection),
+        InstanceMethod("tierStats", &FastDB::TierStats),
+        InstanceMethod("walStats", &FastDB::WalStats),
+        InstanceMethod("metrics", &FastDB::Metrics),
+        InstanceMethod("metricsText", &FastDB::MetricsText),
+        InstanceMethod("slowLog", &FastDB::SlowLog),
+        InstanceMethod("memoryUsage", &FastDB::MemoryUsageOf),
+        InstanceMethod("hotKeys", &FastDB::HotKeys),
+        InstanceMethod("memoryReport", &FastDB::MemoryReportOf),
+        InstanceMethod("restoreTo", &FastDB::RestoreTo),
+        InstanceMethod("catchUp", &FastDB::CatchUp),
+        InstanceMethod("replicationStatus", &FastDB::ReplicationStatus),
+        InstanceMethod("promote", &FastDB::Promote),
+        InstanceMethod("startServer", &FastDB::StartServer),
+        InstanceMethod("stopServer", &FastDB::StopServer),
+        InstanceMethod("serverStats", &FastDB::ServerStats),
+        InstanceMethod("compile", &FastDB::Compile),
+        InstanceMethod("exportTo", &FastDB::ExportTo),
+        InstanceMethod("loadAsync", &FastDB::LoadAsync),
+        InstanceMethod("exportColumns", &FastDB::ExportColumns),
+        InstanceMethod("ingest", &FastDB::Ingest),
+        StaticMethod("buildFile", &FastDB::BuildFile)
     });
 
-    Napi::FunctionReference* constructor = new Napi::FunctionReference();
-    *constructor = Napi::Persistent(func);
-    env.SetInstanceData(constructor);
+    AddonData* addon = new AddonData();
+    addon->fastdb = Napi::Persistent(func);
+    addon->collection = Napi::Persistent(Collection::Init(env));
+    env.SetInstanceData(addon);
 
     exports.Set("FastDB", func);
     return exports;
 }
 
 Napi::Value FastDB::Set(const Napi::CallbackInfo& info) {
+    return SetIn(std::string(), info);
+}
+
+Napi::Value FastDB::SetIn(const std::string& collection, const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
+    if (rejectWrite(env)) return env.Null();
+    
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: key and value").ThrowAsJavaScriptException();
         return env.Null();
@@ -247,42 +341,34 @@ Napi::Value FastDB::Set(const Napi::CallbackInfo& info) {
         return env.Null();
     }
     
-    std::string value = convertToString(info[1]);
-    
-    if (value.length() > 10000000) {
-        Napi::TypeError::New(env, "Value too large (max 10MB)").ThrowAsJavaScriptException();
-        return env.Null();
+    Entry entry;
+    if (info[1].IsTypedArray()) {
+        if (!toNumericArray(info[1], entry)) {
+            Napi::TypeError::New(env, "Only Float64Array and Int32Array values are supported").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        if (key.find('.') != std::string::npos) {
+            Napi::TypeError::New(env, "Numeric arrays cannot be stored under nested keys").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    } else {
+        entry.value = convertToString(info[1]);
     }
     
-    // Handle nested properties with dot notation
-    if (key.find('.') != std::string::npos) {
-        std::vector<std::string> path = splitPath(key);
-        if (!path.empty()) {
-            // Get current root data
-            SimpleJSON::Value root;
-            auto it = data.find("__root__");
-            if (it != data.end()) {
-                root = SimpleJSON::parse(it->second);
-            } else {
-                root.type = SimpleJSON::Value::OBJECT;
-            }
-            
-            // Set nested property
-            if (setNestedProperty(root, path, value)) {
-                data["__root__"] = SimpleJSON::stringify(root);
-                SaveToBinary();
-                return info.This();
-            }
-        }
+    if (entry.value.length() > 10000000) {
+        Napi::TypeError::New(env, "Value too large (max 10MB)").ThrowAsJavaScriptException();
         return env.Null();
     }
     
-    this->data[key] = value;
-    SaveToBinary();
+    if (!engine.put(collection, key, std::move(entry))) return env.Null();
     return info.This();
 }
 
 Napi::Value FastDB::Get(const Napi::CallbackInfo& info) {
+    return GetIn(std::string(), info);
+}
+
+Napi::Value FastDB::GetIn(const std::string& collection, const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
     if (info.Length() < 1) {
@@ -296,34 +382,25 @@ Napi::Value FastDB::Get(const Napi::CallbackInfo& info) {
     }
     
     std::string key = info[0].As<Napi::String>().Utf8Value();
-    
-    // Handle nested properties with dot notation  
-    if (key.find('.') != std::string::npos) {
-        std::vector<std::string> path = splitPath(key);
-        if (!path.empty()) {
-            auto it = data.find("__root__");
-            if (it != data.end()) {
-                SimpleJSON::Value root = SimpleJSON::parse(it->second);
-                std::string result = getNestedProperty(root, path);
-                if (!result.empty()) {
-                    return Napi::String::New(env, result);
-                }
-            }
-        }
-        return env.Null();
-    }
-    
-    auto it = this->data.find(key);
-    if (it != this->data.end()) {
-        return Napi::String::New(env, it->second);
+    RecordView record;
+    std::string scratch;
+    if (engine.lookup(collection, key, record, scratch)) {
+        return toJS(env, record);
     }
     
-    return env.Null();
+    // Optional second argument is returned for missing keys
+    return info.Length() > 1 ? info[1] : env.Null();
 }
 
 Napi::Value FastDB::Delete(const Napi::CallbackInfo& info) {
+    return DeleteIn(std::string(), info);
+}
+
+Napi::Value FastDB::DeleteIn(const std::string& collection, const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
+    if (rejectWrite(env)) return Napi::Boolean::New(env, false);
+    
     if (info.Length() < 1) {
         Napi::TypeError::New(env, "Key argument required").ThrowAsJavaScriptException();
         return Napi::Boolean::New(env, false);
@@ -335,35 +412,14 @@ Napi::Value FastDB::Delete(const Napi::CallbackInfo& info) {
     }
     
     std::string key = info[0].As<Napi::String>().Utf8Value();
-    
-    // Handle nested properties with dot notation
-    if (key.find('.') != std::string::npos) {
-        std::vector<std::string> path = splitPath(key);
-        if (!path.empty()) {
-            auto it = data.find("__root__");
-            if (it != data.end()) {
-                SimpleJSON::Value root = SimpleJSON::parse(it->second);
-                if (deleteNestedProperty(root, path)) {
-                    data["__root__"] = SimpleJSON::stringify(root);
-                    SaveToBinary();
-                    return Napi::Boolean::New(env, true);
-                }
-            }
-        }
-        return Napi::Boolean::New(env, false);
-    }
-    
-    auto it = this->data.find(key);
-    if (it != this->data.end()) {
-        this->data.erase(it);
-        SaveToBinary();
-        return Napi::Boolean::New(env, true);
-    }
-    
-    return Napi::Boolean::New(env, false);
+    return Napi::Boolean::New(env, engine.remove(collection, key));
 }
 
 Napi::Value FastDB::Has(const Napi::CallbackInfo& info) {
+    return HasIn(std::string(), info);
+}
+
+Napi::Value FastDB::HasIn(const std::string& collection, const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
     if (info.Length() < 1) {
@@ -377,377 +433,1968 @@ Napi::Value FastDB::Has(const Napi::CallbackInfo& info) {
     }
     
     std::string key = info[0].As<Napi::String>().Utf8Value();
-    
-    // Handle nested properties with dot notation
-    if (key.find('.') != std::string::npos) {
-        std::vector<std::string> path = splitPath(key);
-        if (!path.empty()) {
-            auto it = data.find("__root__");
-            if (it != data.end()) {
-                SimpleJSON::Value root = SimpleJSON::parse(it->second);
-                return Napi::Boolean::New(env, hasNestedProperty(root, path));
-            }
-        }
-        return Napi::Boolean::New(env, false);
-    }
-    
-    return Napi::Boolean::New(env, this->data.find(key) != this->data.end());
+    return Napi::Boolean::New(env, engine.contains(collection, key));
 }
 
 Napi::Value FastDB::Clear(const Napi::CallbackInfo& info) {
+    return ClearIn(std::string(), info);
+}
+
+Napi::Value FastDB::ClearIn(const std::string& collection, const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    this->data.clear();
-    SaveToBinary();
+    if (rejectWrite(env)) return env.Null();
+    
+    engine.clear(collection);
     return info.This();
 }
 
 Napi::Value FastDB::Size(const Napi::CallbackInfo& info) {
+    return SizeIn(std::string(), info);
+}
+
+Napi::Value FastDB::SizeIn(const std::string& collection, const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    return Napi::Number::New(env, this->data.size());
+    return Napi::Number::New(env, static_cast<double>(engine.size(collection)));
 }
 
 Napi::Value FastDB::Keys(const Napi::CallbackInfo& info) {
+    return KeysIn(std::string(), info);
+}
+
+Napi::Value FastDB::KeysIn(const std::string& collection, const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    Napi::Array keys = Napi::Array::New(env, this->data.size());
-    size_t index = 0;
-    for (const auto& pair : this->data) {
-        keys[index++] = Napi::String::New(env, pair.first);
-    }
+    Napi::Array keys = Napi::Array::New(env, engine.size(collection));
+    uint32_t i = 0;
+    engine.scan(collection, [&](const RecordView& record) {
+        keys[i++] = Napi::String::New(env, record.key, record.keyLength);
+        return true;
+    }, true);
     return keys;
 }
 
 Napi::Value FastDB::Values(const Napi::CallbackInfo& info) {
+    return ValuesIn(std::string(), info);
+}
+
+Napi::Value FastDB::ValuesIn(const std::string& collection, const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    Napi::Array values = Napi::Array::New(env, this->data.size());
-    size_t index = 0;
-    for (const auto& pair : this->data) {
-        values[index++] = Napi::String::New(env, pair.second);
-    }
+    Napi::Array values = Napi::Array::New(env, engine.size(collection));
+    uint32_t i = 0;
+    engine.scan(collection, [&](const RecordView& record) {
+        values[i++] = toJS(env, record);
+        return true;
+    });
     return values;
 }
 
-Napi::Value FastDB::Save(const Napi::CallbackInfo& info) {
+// Packed exports: every string is copied back to back into one ArrayBuffer and
+// string i spans [offsets[i], offsets[i + 1]), so no JS strings are created.
+// The first pass only measures, so it leaves cold values on disk.
+Napi::Value FastDB::KeysPacked(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    bool success = SaveToBinary();
-    return Napi::Boolean::New(env, success);
+    size_t count = 0;
+    size_t total = 0;
+    engine.scan(std::string(), [&](const RecordView& record) {
+        total += record.keyLength;
+        count++;
+        return true;
+    }, true);
+    if (total > UINT32_MAX) {
+        Napi::RangeError::New(env, "Packed keys exceed 4GB").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, total);
+    Napi::Uint32Array offsets = Napi::Uint32Array::New(env, count + 1);
+    char* out = static_cast<char*>(buffer.Data());
+    uint32_t* offs = offsets.Data();
+    
+    uint32_t pos = 0;
+    size_t index = 0;
+    engine.scan(std::string(), [&](const RecordView& record) {
+        offs[index++] = pos;
+        memcpy(out + pos, record.key, record.keyLength);
+        pos += static_cast<uint32_t>(record.keyLength);
+        return index < count;
+    }, true);
+    offs[index] = pos;
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("data", buffer);
+    result.Set("offsets", offsets);
+    return result;
 }
 
-Napi::Value FastDB::Load(const Napi::CallbackInfo& info) {
+// Keys and values are interleaved: entry i's key is string 2i and its value
+// is string 2i + 1 of the packed buffer.
+Napi::Value FastDB::EntriesPacked(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
     
-    bool success = LoadFromBinary();
-    return Napi::Boolean::New(env, success);
-}
-
-
-SimpleJSON::Value SimpleJSON::parse(const std::string& json_str) {
-    size_t pos = 0;
-    skipWhitespace(json_str, pos);
-    if (pos >= json_str.length()) return Value();
-    return parseValue(json_str, pos);
-}
-
-std::string SimpleJSON::stringify(const Value& value) {
-    switch (value.type) {
-        case Value::STRING:
-            return "\"" + escapeString(value.string_value) + "\"";
-        case Value::NUMBER:
-            return std::to_string(value.number_value);
-        case Value::BOOLEAN:
-            return value.boolean_value ? "true" : "false";
-        case Value::NULL_VALUE:
-            return "null";
-        case Value::OBJECT: {
-            std::string result = "{";
-            bool first = true;
-            for (const auto& pair : value.object_value) {
-                if (!first) result += ",";
-                result += "\"" + escapeString(pair.first) + "\":" + stringify(pair.second);
-                first = false;
-            }
-            result += "}";
-            return result;
-        }
-        case Value::ARRAY: {
-            std::string result = "[";
-            bool first = true;
-            for (const auto& item : value.array_value) {
-                if (!first) result += ",";
-                result += stringify(item);
-                first = false;
-            }
-            result += "]";
-            return result;
-        }
+    size_t count = 0;
+    size_t total = 0;
+    engine.scan(std::string(), [&](const RecordView& record) {
+        total += record.keyLength + record.valueLength;
+        count++;
+        return true;
+    }, true);
+    if (total > UINT32_MAX) {
+        Napi::RangeError::New(env, "Packed entries exceed 4GB").ThrowAsJavaScriptException();
+        return env.Null();
     }
-    return "null";
+    
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, total);
+    Napi::Uint32Array offsets = Napi::Uint32Array::New(env, count * 2 + 1);
+    char* out = static_cast<char*>(buffer.Data());
+    uint32_t* offs = offsets.Data();
+    
+    uint32_t pos = 0;
+    size_t index = 0;
+    engine.scan(std::string(), [&](const RecordView& record) {
+        offs[index++] = pos;
+        memcpy(out + pos, record.key, record.keyLength);
+        pos += static_cast<uint32_t>(record.keyLength);
+        offs[index++] = pos;
+        memcpy(out + pos, record.value, record.valueLength);
+        pos += static_cast<uint32_t>(record.valueLength);
+        return index < count * 2;
+    });
+    offs[index] = pos;
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("data", buffer);
+    result.Set("offsets", offsets);
+    return result;
 }
 
-SimpleJSON::Value SimpleJSON::parseValue(const std::string& str, size_t& pos) {
-    skipWhitespace(str, pos);
-    if (pos >= str.length()) return Value();
+// Appends numbers to an existing numeric array in place. Returns the new
+// length, or null when the key does not hold a numeric array.
+Napi::Value FastDB::Append(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    char c = str[pos];
-    if (c == '{') return parseObject(str, pos);
-    if (c == '[') return parseArray(str, pos);
-    if (c == '"') return Value(parseString(str, pos));
-    if (c == 't' || c == 'f') {
-        if (str.substr(pos, 4) == "true") {
-            pos += 4;
-            return Value(true);
-        }
-        if (str.substr(pos, 5) == "false") {
-            pos += 5;
-            return Value(false);
-        }
+    if (rejectWrite(env)) return env.Null();
+    
+    if (info.Length() < 2 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected 2 arguments: key and values").ThrowAsJavaScriptException();
+        return env.Null();
     }
-    if (c == 'n' && str.substr(pos, 4) == "null") {
-        pos += 4;
-        return Value();
+    
+    std::string key = info[0].As<Napi::String>().Utf8Value();
+    Entry elements;
+    if (!toNumericArray(info[1], elements) && !toNumbers(info[1], elements)) {
+        Napi::TypeError::New(env, "Values must be a number, an array of numbers or a typed array").ThrowAsJavaScriptException();
+        return env.Null();
     }
-    if (c == '-' || (c >= '0' && c <= '9')) {
-        return Value(parseNumber(str, pos));
+    
+    size_t length = 0;
+    std::string error;
+    if (!engine.append(key, elements, length, error)) {
+        if (!error.empty()) Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
     }
-    return Value();
+    return Napi::Number::New(env, static_cast<double>(length));
 }
 
-SimpleJSON::Value SimpleJSON::parseObject(const std::string& str, size_t& pos) {
-    Value obj;
-    obj.type = Value::OBJECT;
-    pos++; // skip '{'
+// Copies [start, end) of a numeric array out, with Array.prototype.slice
+// semantics for negative and missing bounds.
+Napi::Value FastDB::Slice(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    skipWhitespace(str, pos);
-    if (pos < str.length() && str[pos] == '}') {
-        pos++;
-        return obj;
-    }
+    const Entry* entry = findNumericArray(info);
+    if (!entry) return env.Null();
     
-    while (pos < str.length()) {
-        skipWhitespace(str, pos);
-        if (pos >= str.length() || str[pos] != '"') break;
-        
-        std::string key = parseString(str, pos);
-        skipWhitespace(str, pos);
-        if (pos >= str.length() || str[pos] != ':') break;
-        pos++; // skip ':'
-        
-        Value value = parseValue(str, pos);
-        obj.object_value[key] = value;
-        
-        skipWhitespace(str, pos);
-        if (pos >= str.length()) break;
-        if (str[pos] == '}') {
-            pos++;
-            break;
-        }
-        if (str[pos] == ',') {
-            pos++;
-            continue;
-        }
-        break;
-    }
-    return obj;
+    int64_t length = static_cast<int64_t>(NumericArray::length(*entry));
+    auto bound = [length](const Napi::Value& value, int64_t fallback) {
+        if (!value.IsNumber()) return fallback;
+        int64_t index = value.As<Napi::Number>().Int64Value();
+        if (index < 0) index += length;
+        return std::max<int64_t>(0, std::min(index, length));
+    };
+    int64_t start = bound(info[1], 0);
+    int64_t end = bound(info[2], length);
+    if (end < start) end = start;
+    
+    return toTypedArray(env, *entry, static_cast<size_t>(start), static_cast<size_t>(end));
 }
 
-SimpleJSON::Value SimpleJSON::parseArray(const std::string& str, size_t& pos) {
-    Value arr;
-    arr.type = Value::ARRAY;
-    pos++; // skip '['
-    
-    skipWhitespace(str, pos);
-    if (pos < str.length() && str[pos] == ']') {
-        pos++;
-        return arr;
-    }
+Napi::Value FastDB::Sum(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    while (pos < str.length()) {
-        Value value = parseValue(str, pos);
-        arr.array_value.push_back(value);
-        
-        skipWhitespace(str, pos);
-        if (pos >= str.length()) break;
-        if (str[pos] == ']') {
-            pos++;
-            break;
-        }
-        if (str[pos] == ',') {
-            pos++;
-            continue;
-        }
-        break;
-    }
-    return arr;
-}
-
-std::string SimpleJSON::parseString(const std::string& str, size_t& pos) {
-    if (pos >= str.length() || str[pos] != '"') return "";
-    pos++; // skip opening quote
-    
-    std::string result;
-    while (pos < str.length() && str[pos] != '"') {
-        if (str[pos] == '\\' && pos + 1 < str.length()) {
-            pos++;
-            char escaped = str[pos];
-            switch (escaped) {
-                case '"': result += '"'; break;
-                case '\\': result += '\\'; break;
-                case '/': result += '/'; break;
-                case 'b': result += '\b'; break;
-                case 'f': result += '\f'; break;
-                case 'n': result += '\n'; break;
-                case 'r': result += '\r'; break;
-                case 't': result += '\t'; break;
-                default: result += escaped; break;
-            }
-        } else {
-            result += str[pos];
-        }
-        pos++;
-    }
-    if (pos < str.length()) pos++; // skip closing quote
-    return result;
+    const Entry* entry = findNumericArray(info);
+    if (!entry) return env.Null();
+    return Napi::Number::New(env, NumericArray::sum(*entry));
 }
 
-double SimpleJSON::parseNumber(const std::string& str, size_t& pos) {
-    size_t start = pos;
-    if (str[pos] == '-') pos++;
-    while (pos < str.length() && ((str[pos] >= '0' && str[pos] <= '9') || str[pos] == '.')) {
-        pos++;
-    }
-    return std::stod(str.substr(start, pos - start));
+Napi::Value FastDB::Min(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    const Entry* entry = findNumericArray(info);
+    if (!entry || NumericArray::length(*entry) == 0) return env.Null();
+    return Napi::Number::New(env, NumericArray::min(*entry));
 }
 
-void SimpleJSON::skipWhitespace(const std::string& str, size_t& pos) {
-    while (pos < str.length() && (str[pos] == ' ' || str[pos] == '\t' || str[pos] == '\n' || str[pos] == '\r')) {
-        pos++;
-    }
+Napi::Value FastDB::Max(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    const Entry* entry = findNumericArray(info);
+    if (!entry || NumericArray::length(*entry) == 0) return env.Null();
+    return Napi::Number::New(env, NumericArray::max(*entry));
 }
 
-std::string SimpleJSON::escapeString(const std::string& str) {
-    std::string result;
-    for (char c : str) {
-        switch (c) {
-            case '"': result += "\\\""; break;
-            case '\\': result += "\\\\"; break;
-            case '\b': result += "\\b"; break;
-            case '\f': result += "\\f"; break;
-            case '\n': result += "\\n"; break;
-            case '\r': result += "\\r"; break;
-            case '\t': result += "\\t"; break;
-            default: result += c; break;
-        }
-    }
-    return result;
+Napi::Value FastDB::Save(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (rejectWrite(env)) return Napi::Boolean::New(env, false);
+    
+    return Napi::Boolean::New(env, engine.save());
 }
 
-// FastDB nested property helpers
-std::vector<std::string> FastDB::splitPath(const std::string& path) {
-    std::vector<std::string> parts;
-    std::stringstream ss(path);
-    std::string part;
+Napi::Value FastDB::Load(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    while (std::getline(ss, part, '.')) {
-        if (!part.empty()) {
-            parts.push_back(part);
-        }
+    if (engine.writeState() == Engine::LOADING) {
+        Napi::Error::New(env, "Database is still loading").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
     }
-    return parts;
+    
+    return Napi::Boolean::New(env, engine.reload());
 }
 
-bool FastDB::setNestedProperty(SimpleJSON::Value& root, const std::vector<std::string>& path, const std::string& value) {
-    if (path.empty()) return false;
+Napi::Value FastDB::GetCollection(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    if (root.type != SimpleJSON::Value::OBJECT) {
-        root.type = SimpleJSON::Value::OBJECT;
-        root.object_value.clear();
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Collection name must be a string").ThrowAsJavaScriptException();
+        return env.Null();
     }
     
-    SimpleJSON::Value* current = &root;
-    for (size_t i = 0; i < path.size() - 1; i++) {
-        if (current->object_value.find(path[i]) == current->object_value.end() ||
-            current->object_value[path[i]].type != SimpleJSON::Value::OBJECT) {
-            current->object_value[path[i]].type = SimpleJSON::Value::OBJECT;
-            current->object_value[path[i]].object_value.clear();
-        }
-        current = &current->object_value[path[i]];
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+    if (!Engine::IsValidCollectionName(name)) {
+        Napi::TypeError::New(env, "Collection name must be 1-255 characters").ThrowAsJavaScriptException();
+        return env.Null();
     }
     
-    current->object_value[path.back()] = SimpleJSON::Value(value);
-    return true;
+    AddonData* addon = env.GetInstanceData<AddonData>();
+    return addon->collection.New({ info.This(), info[0] });
 }
 
-std::string FastDB::getNestedProperty(const SimpleJSON::Value& root, const std::vector<std::string>& path) {
-    if (path.empty() || root.type != SimpleJSON::Value::OBJECT) return "";
-    
-    const SimpleJSON::Value* current = &root;
-    for (const std::string& part : path) {
-        if (current->type != SimpleJSON::Value::OBJECT ||
-            current->object_value.find(part) == current->object_value.end()) {
-            return "";
-        }
-        current = &current->object_value.at(part);
-    }
+Napi::Value FastDB::ListCollections(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    if (current->type == SimpleJSON::Value::STRING) {
-        return current->string_value;
+    std::vector<std::string> collections = engine.collectionNames();
+    Napi::Array names = Napi::Array::New(env, collections.size());
+    for (size_t i = 0; i < collections.size(); i++) {
+        names[i] = Napi::String::New(env, collections[i]);
     }
-    return SimpleJSON::stringify(*current);
+    return names;
 }
 
-bool FastDB::deleteNestedProperty(SimpleJSON::Value& root, const std::vector<std::string>& path) {
-    if (path.empty() || root.type != SimpleJSON::Value::OBJECT) return false;
+Napi::Value FastDB::DropCollection(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    SimpleJSON::Value* current = &root;
-    for (size_t i = 0; i < path.size() - 1; i++) {
-        if (current->type != SimpleJSON::Value::OBJECT ||
-            current->object_value.find(path[i]) == current->object_value.end()) {
-            return false;
-        }
-        current = &current->object_value[path[i]];
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Collection name must be a string").ThrowAsJavaScriptException();
+        return Napi::Boolean::New(env, false);
     }
     
-    if (current->type == SimpleJSON::Value::OBJECT &&
-        current->object_value.find(path.back()) != current->object_value.end()) {
-        current->object_value.erase(path.back());
-        return true;
-    }
-    return false;
+    if (rejectWrite(env)) return Napi::Boolean::New(env, false);
+    
+    std::string name = info[0].As<Napi::String>().Utf8Value();
+    return Napi::Boolean::New(env, engine.dropCollection(name));
 }
 
-bool FastDB::hasNestedProperty(const SimpleJSON::Value& root, const std::vector<std::string>& path) {
-    if (path.empty() || root.type != SimpleJSON::Value::OBJECT) return false;
+Napi::Value FastDB::TierStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
     
-    const SimpleJSON::Value* current = &root;
-    for (const std::string& part : path) {
-        if (current->type != SimpleJSON::Value::OBJECT ||
-            current->object_value.find(part) == current->object_value.end()) {
-            return false;
-        }
-        current = &current->object_value.at(part);
-    }
-    return true;
+    Engine::TierStats tier = engine.tierStats();
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("memoryLimit", Napi::Number::New(env, static_cast<double>(tier.memoryLimit)));
+    stats.Set("hotBytes", Napi::Number::New(env, static_cast<double>(tier.hotBytes)));
+    stats.Set("coldBytes", Napi::Number::New(env, static_cast<double>(tier.coldBytes)));
+    stats.Set("coldEntries", Napi::Number::New(env, static_cast<double>(tier.coldEntries)));
+    stats.Set("coldFileSize", Napi::Number::New(env, static_cast<double>(tier.coldFileSize)));
+    stats.Set("promotions", Napi::Number::New(env, static_cast<double>(tier.promotions)));
+    stats.Set("demotions", Napi::Number::New(env, static_cast<double>(tier.demotions)));
+    return stats;
 }
 
-std::string FastDB::convertToString(const Napi::Value& value) {
-    if (value.IsString()) {
-        return value.As<Napi::String>().Utf8Value();
-    } else if (value.IsNumber()) {
-        return std::to_string(value.As<Napi::Number>().DoubleValue());
-    } else if (value.IsBoolean()) {
-        return value.As<Napi::Boolean>().Value() ? "true" : "false";
-    } else if (value.IsNull() || value.IsUndefined()) {
-        return "null";
+// Streams a snapshot of the database (Engine::snapshot(), taken on the main
+// thread) to a file on a worker thread
+class ExportWorker : public Napi::AsyncProgressWorker<Engine::ExportProgress> {
+public:
+    ExportWorker(Napi::Env env, const std::string& path, Engine::ExportFormat format)
+        : Napi::AsyncProgressWorker<Engine::ExportProgress>(env, "FastDBExport"),
+          deferred(Napi::Promise::Deferred::New(env)), path(path), format(format) {}
+          
+    Napi::Promise Promise() const { return deferred.Promise(); }
+    
+    Engine::ExportSnapshot snapshot;
+    Napi::FunctionReference onProgress;
+    
+protected:
+    void Execute(const ExecutionProgress& progress) override {
+        std::string error;
+        auto report = [&progress](const Engine::ExportProgress& current) { progress.Send(&current, 1); };
+        if (!Engine::exportSnapshot(snapshot, path, format, report, written, error)) SetError(error);
+    }
+    
+    void OnProgress(const Engine::ExportProgress* data, size_t count) override {
+        if (count == 0 || onProgress.IsEmpty()) return;
+        Napi::Env env = Env();
+        Napi::Object event = Napi::Object::New(env);
+        event.Set("entries", Napi::Number::New(env, static_cast<double>(data[count - 1].entries)));
+        event.Set("total", Napi::Number::New(env, static_cast<double>(snapshot.total)));
+        event.Set("bytes", Napi::Number::New(env, static_cast<double>(data[count - 1].bytes)));
+        onProgress.Call({ event });
+    }
+    
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("entries", Napi::Number::New(env, static_cast<double>(written.entries)));
+        result.Set("bytes", Napi::Number::New(env, static_cast<double>(written.bytes)));
+        deferred.Resolve(result);
+    }
+    
+    void OnError(const Napi::Error& error) override {
+        deferred.Reject(error.Value());
+    }
+    
+private:
+    Napi::Promise::Deferred deferred;
+    std::string path;
+    Engine::ExportFormat format;
+    Engine::ExportProgress written;
+};
+
+struct LoadProgress {
+    uint64_t bytes;
+    uint64_t keys;
+};
+
+// Reads data files on a worker thread and hands entries to the main thread
+// in batches, where the engine merges them into the live indexes between
+// other callbacks. The worker waits while MAX_QUEUED batches are pending
+// so each callback stays short. The worker never touches the database.
+class LoadWorker : public Napi::AsyncProgressWorker<LoadProgress> {
+public:
+    LoadWorker(Napi::Env env, Engine* engine, const Napi::Object& self, const std::vector<std::string>& paths)
+        : Napi::AsyncProgressWorker<LoadProgress>(env, "FastDBLoad"),
+          deferred(Napi::Promise::Deferred::New(env)), engine(engine), self(Napi::Persistent(self)),
+          paths(paths), totalBytes(0), bytes(0), keys(0), started(std::chrono::steady_clock::now()) {
+        std::error_code error;
+        for (const auto& path : paths) {
+            uint64_t size = std::filesystem::file_size(path, error);
+            if (!error) totalBytes += size;
+            error.clear();
+        }
+    }
+    
+    Napi::Promise Promise() const { return deferred.Promise(); }
+    Napi::FunctionReference onProgress;
+    
+protected:
+    static const size_t BATCH_SIZE = 16384;
+    static const size_t MAX_QUEUED = 4;
+    
+    void Execute(const ExecutionProgress& progress) override {
+        // Queues a batch for the main thread
+        auto push = [&](std::unique_ptr<Engine::LoadBatch> batch) {
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                drained.wait(lock, [this]() { return queue.size() < MAX_QUEUED; });
+                queue.push_back(std::move(batch));
+            }
+            LoadProgress current = { bytes, keys };
+            progress.Send(&current, 1);
+        };
+        for (const auto& path : paths) {
+            if (!Engine::readLoadFile(path, BATCH_SIZE, push, bytes, keys)) {
+                SetError("Failed to load " + path);
+                return;
+            }
+        }
+    }
+    
+    void OnProgress(const LoadProgress* data, size_t count) override {
+        merge();
+        if (count == 0 || onProgress.IsEmpty()) return;
+        Napi::Env env = Env();
+        Napi::Object event = Napi::Object::New(env);
+        event.Set("bytes", Napi::Number::New(env, static_cast<double>(data[count - 1].bytes)));
+        event.Set("totalBytes", Napi::Number::New(env, static_cast<double>(totalBytes)));
+        event.Set("keys", Napi::Number::New(env, static_cast<double>(data[count - 1].keys)));
+        onProgress.Call({ event });
+    }
+    
+    void OnOK() override {
+        merge();
+        uint64_t nanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - started).count());
+        if (!engine->finishLoad(true, bytes.load(), nanos)) {
+            deferred.Reject(Napi::Error::New(Env(), "Failed to load sorted runs").Value());
+            return;
+        }
+        deferred.Resolve(self.Value());
+    }
+    
+    void OnError(const Napi::Error& error) override {
+        merge();
+        engine->finishLoad(false, 0, 0);
+        deferred.Reject(error.Value());
+    }
+    
+private:
+    void merge() {
+        std::vector<std::unique_ptr<Engine::LoadBatch>> ready;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            ready.swap(queue);
+        }
+        drained.notify_one();
+        engine->mergeLoaded(ready);
+    }
+    
+    Napi::Promise::Deferred deferred;
+    Engine* engine;
+    Napi::ObjectReference self;
+    std::vector<std::string> paths;
+    uint64_t totalBytes;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> keys;
+    std::chrono::steady_clock::time_point started;
+    std::mutex queueMutex;
+    std::condition_variable drained;
+    std::vector<std::unique_ptr<Engine::LoadBatch>> queue;
+};
+
+// Loads a database opened with deferLoad on a worker thread. Resolves with
+// the database once every file is in memory; compiled and read-only files
+// are mapped straight away.
+Napi::Value FastDB::LoadAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::Value progressCallback = info.Length() > 0 ? info[0] : env.Undefined();
+    
+    std::vector<std::string> paths;
+    std::string error;
+    Engine::LoadStart start = engine.startLoad(paths, error);
+    if (start != Engine::LOAD_STREAM) {
+        Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+        if (start == Engine::LOAD_RUNNING) {
+            deferred.Reject(Napi::Error::New(env, "Load already in progress").Value());
+        } else if (start == Engine::LOAD_FAILED) {
+            deferred.Reject(Napi::Error::New(env, error).Value());
+        } else {
+            deferred.Resolve(info.This());
+        }
+        return deferred.Promise();
+    }
+    
+    LoadWorker* worker = new LoadWorker(env, &engine, info.This().As<Napi::Object>(), paths);
+    if (progressCallback.IsFunction()) worker->onProgress = Napi::Persistent(progressCallback.As<Napi::Function>());
+    Napi::Promise promise = worker->Promise();
+    worker->Queue();
+    return promise;
+}
+
+// Exports a snapshot to `path` on a worker thread and resolves with
+// {entries, bytes}. Writes made after the call are not included.
+Napi::Value FastDB::ExportTo(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Export filename must be a string").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    Engine::ExportFormat format = Engine::EXPORT_NDJSON;
+    Napi::Value progressCallback = env.Undefined();
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Object options = info[1].As<Napi::Object>();
+        Napi::Value formatName = options.Get("format");
+        if (formatName.IsString()) {
+            std::string name = formatName.As<Napi::String>().Utf8Value();
+            if (name == "binary") {
+                format = Engine::EXPORT_BINARY;
+            } else if (name != "ndjson") {
+                Napi::RangeError::New(env, "Export format must be 'ndjson' or 'binary'").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+        }
+        progressCallback = options.Get("onProgress");
+    }
+    
+    Engine::ExportSnapshot snapshot;
+    std::string error;
+    if (!engine.snapshot(snapshot, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    ExportWorker* worker = new ExportWorker(env, path, format);
+    worker->snapshot = std::move(snapshot);
+    Napi::Promise promise = worker->Promise();
+    if (progressCallback.IsFunction()) worker->onProgress = Napi::Persistent(progressCallback.As<Napi::Function>());
+    worker->Queue();
+    return promise;
+}
+
+// Writes the default collection to an immutable minimal-perfect-hash file.
+// Opening that file later maps it instead of loading it.
+Napi::Value FastDB::Compile(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Output path must be a string").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    if (!Engine::IsValidFilename(path)) {
+        Napi::TypeError::New(env, "Invalid output path").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    size_t count = 0;
+    if (!engine.compile(path, count)) {
+        Napi::Error::New(env, "Failed to compile database").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    return Napi::Number::New(env, static_cast<double>(count));
+}
+
+// exportColumns(path, filename): the records under a nested path as a
+// columnar file; resolves the row and column counts
+Napi::Value FastDB::ExportColumns(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsString() || !info[1].IsString()) {
+        Napi::TypeError::New(env, "Expected a nested path and an output filename").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    std::string filename = info[1].As<Napi::String>().Utf8Value();
+    if (path.find_first_not_of('.') == std::string::npos) {
+        Napi::TypeError::New(env, "Nested path must not be empty").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    size_t rows = 0;
+    size_t columns = 0;
+    std::string error;
+    if (!engine.exportColumns(path, filename, rows, columns, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("rows", Napi::Number::New(env, static_cast<double>(rows)));
+    result.Set("columns", Napi::Number::New(env, static_cast<double>(columns)));
+    return result;
+}
+
+// Writes [key, value] pairs, sorted by key, to a sorted table file without
+// touching any database. Safe to call from a worker thread or a CLI.
+Napi::Value FastDB::BuildFile(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 2 || !info[0].IsArray() || !info[1].IsString()) {
+        Napi::TypeError::New(env, "Expected an array of [key, value] pairs and a path").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    Napi::Array entries = info[0].As<Napi::Array>();
+    std::string path = info[1].As<Napi::String>().Utf8Value();
+    uint32_t bitsPerKey = 10;
+    if (info.Length() > 2 && info[2].IsObject()) {
+        Napi::Value bits = info[2].As<Napi::Object>().Get("bloomBitsPerKey");
+        if (bits.IsNumber()) bitsPerKey = std::min<uint32_t>(bits.As<Napi::Number>().Uint32Value(), 64);
+    }
+    
+    // The builder removes its partial file when it goes out of scope
+    uint32_t count = entries.Length();
+    SSTableBuilder builder;
+    if (!builder.open(path, count, bitsPerKey)) {
+        Napi::Error::New(env, "Cannot write " + path).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        Napi::Value pair = entries.Get(i);
+        if (!pair.IsArray() || pair.As<Napi::Array>().Length() < 2 || !pair.As<Napi::Array>().Get(0u).IsString()) {
+            Napi::TypeError::New(env, "Each entry must be a [key, value] pair").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        std::string key = pair.As<Napi::Array>().Get(0u).As<Napi::String>().Utf8Value();
+        Napi::Value value = pair.As<Napi::Array>().Get(1u);
+        if (key.empty() || key.length() > 1000 || key.find('.') != std::string::npos) {
+            Napi::TypeError::New(env, "Keys must be 1-1000 characters without dots").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        
+        Entry entry;
+        if (value.IsTypedArray()) {
+            if (!toNumericArray(value, entry)) {
+                Napi::TypeError::New(env, "Only Float64Array and Int32Array values are supported").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+        } else {
+            entry.value = convertToString(value);
+        }
+        if (entry.value.length() > 10000000) {
+            Napi::TypeError::New(env, "Value too large (max 10MB)").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        
+        if (!builder.add({ key.data(), key.size(), entry.value.data(), entry.value.size(), entry.type })) {
+            Napi::RangeError::New(env, "Entries must be sorted by key (UTF-8 byte order) without duplicates")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+    
+    if (!builder.finish()) {
+        Napi::Error::New(env, "Cannot write " + path).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    return Napi::Number::New(env, count);
+}
+
+// Links a sorted table file into the database as its newest run
+Napi::Value FastDB::Ingest(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Path must be a string").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (rejectWrite(env)) return env.Null();
+    
+    size_t count = 0;
+    std::string error;
+    if (!engine.ingest(info[0].As<Napi::String>().Utf8Value(), count, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    return Napi::Number::New(env, static_cast<double>(count));
+}
+
+Napi::Function Collection::Init(Napi::Env env) {
+    return DefineClass(env, "Collection", {
+        InstanceMethod("set", &Collection::Set),
+        InstanceMethod("get", &Collection::Get),
+        InstanceMethod("delete", &Collection::Delete),
+        InstanceMethod("has", &Collection::Has),
+        InstanceMethod("clear", &Collection::Clear),
+        InstanceMethod("size", &Collection::Size),
+        InstanceMethod("keys", &Collection::Keys),
+        InstanceMethod("values", &Collection::Values),
+        InstanceMethod("name", &Collection::Name)
+    });
+}
+
+// The collection is looked up by name on every call, so a handle stays
+// valid across dropCollection(). Only writes recreate a dropped collection;
+// reads see it as empty.
+Collection::Collection(const Napi::CallbackInfo& info) : Napi::ObjectWrap<Collection>(info), db(nullptr) {
+    Napi::Env env = info.Env();
+    AddonData* addon = env.GetInstanceData<AddonData>();
+    
+    if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsString() ||
+        !info[0].As<Napi::Object>().InstanceOf(addon->fastdb.Value())) {
+        Napi::TypeError::New(env, "Use db.collection(name) to open a collection").ThrowAsJavaScriptException();
+        return;
+    }
+    
+    db = FastDB::Unwrap(info[0].As<Napi::Object>());
+    name = info[1].As<Napi::String>().Utf8Value();
+    dbRef = Napi::Persistent(info[0].As<Napi::Object>());
+    db->engine.createCollection(name);
+}
+
+Napi::Value Collection::Set(const Napi::CallbackInfo& info) {
+    return db->SetIn(name, info);
+}
+
+Napi::Value Collection::Get(const Napi::CallbackInfo& info) {
+    return db->GetIn(name, info);
+}
+
+Napi::Value Collection::Delete(const Napi::CallbackInfo& info) {
+    return db->DeleteIn(name, info);
+}
+
+Napi::Value Collection::Has(const Napi::CallbackInfo& info) {
+    return db->HasIn(name, info);
+}
+
+Napi::Value Collection::Clear(const Napi::CallbackInfo& info) {
+    return db->ClearIn(name, info);
+}
+
+Napi::Value Collection::Size(const Napi::CallbackInfo& info) {
+    return db->SizeIn(name, info);
+}
+
+Napi::Value Collection::Keys(const Napi::CallbackInfo& info) {
+    return db->KeysIn(name, info);
+}
+
+Napi::Value Collection::Values(const Napi::CallbackInfo& info) {
+    return db->ValuesIn(name, info);
+}
+
+Napi::Value Collection::Name(const Napi::CallbackInfo& info) {
+    return Napi::String::New(info.Env(), name);
+}
+
+std::string FastDB::convertToString(const Napi::Value& value) {
+    if (value.IsString()) {
+        return value.As<Napi::String>().Utf8Value();
+    } else if (value.IsNumber()) {
+        return std::to_string(value.As<Napi::Number>().DoubleValue());
+    } else if (value.IsBoolean()) {
+        return value.As<Napi::Boolean>().Value() ? "true" : "false";
+    } else if (value.IsNull() || value.IsUndefined()) {
+        return "null";
     }
     return "";
 }
 
+bool FastDB::rejectWrite(Napi::Env env) {
+    switch (engine.writeState()) {
+        case Engine::LOADING:
+            // A save now would replace the files with the part loaded so far
+            Napi::Error::New(env, "Database is still loading").ThrowAsJavaScriptException();
+            return true;
+        case Engine::FOLLOWING:
+            Napi::Error::New(env, "Database is a follower").ThrowAsJavaScriptException();
+            return true;
+        case Engine::READ_ONLY:
+            Napi::Error::New(env, "Database is read-only").ThrowAsJavaScriptException();
+            return true;
+        default:
+            return false;
+    }
+}
+
+Napi::Value FastDB::WalStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    Engine::WalStats wal = engine.walStats();
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("enabled", Napi::Boolean::New(env, wal.enabled));
+    stats.Set("bytes", Napi::Number::New(env, static_cast<double>(wal.bytes)));
+    stats.Set("records", Napi::Number::New(env, static_cast<double>(wal.records)));
+    stats.Set("sequence", Napi::Number::New(env, static_cast<double>(wal.sequence)));
+    stats.Set("checkpoints", Napi::Number::New(env, static_cast<double>(wal.checkpoints)));
+    stats.Set("recoveredRecords", Napi::Number::New(env, static_cast<double>(wal.recoveredRecords)));
+    stats.Set("truncatedBytes", Napi::Number::New(env, static_cast<double>(wal.truncatedBytes)));
+    stats.Set("retainedCheckpoints", Napi::Number::New(env, static_cast<double>(wal.retainedCheckpoints)));
+    stats.Set("retainedSegments", Napi::Number::New(env, static_cast<double>(wal.retainedSegments)));
+    stats.Set("oldestRestoreSequence", Napi::Number::New(env, static_cast<double>(wal.oldestRestoreSequence)));
+    stats.Set("oldestRestoreTimestamp", Napi::Number::New(env, static_cast<double>(wal.oldestRestoreTimestamp)));
+    return stats;
+}
+
+// metrics({ reset }): latency percentiles in nanoseconds for each recorded
+// operation since the database was opened or the last reset
+Napi::Value FastDB::Metrics(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    bool reset = false;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Value value = info[0].As<Napi::Object>().Get("reset");
+        reset = value.IsBoolean() && value.As<Napi::Boolean>().Value();
+    }
+    
+    Napi::Object metrics = Napi::Object::New(env);
+    for (int i = 0; i < Engine::OPERATION_COUNT; i++) {
+        Engine::Operation op = static_cast<Engine::Operation>(i);
+        LatencyHistogram::Snapshot snapshot = engine.latencyOf(op);
+        Napi::Object histogram = Napi::Object::New(env);
+        histogram.Set("count", Napi::Number::New(env, static_cast<double>(snapshot.count)));
+        histogram.Set("mean", Napi::Number::New(env, snapshot.mean()));
+        histogram.Set("p50", Napi::Number::New(env, static_cast<double>(snapshot.percentile(0.5))));
+        histogram.Set("p90", Napi::Number::New(env, static_cast<double>(snapshot.percentile(0.9))));
+        histogram.Set("p99", Napi::Number::New(env, static_cast<double>(snapshot.percentile(0.99))));
+        histogram.Set("p999", Napi::Number::New(env, static_cast<double>(snapshot.percentile(0.999))));
+        histogram.Set("max", Napi::Number::New(env, static_cast<double>(snapshot.max)));
+        metrics.Set(Engine::operationName(op), histogram);
+    }
+    
+    // I/O since the last reset; fsyncs come from the fsync histogram,
+    // which is reset with it
+    Engine::IoStats current = engine.ioStats();
+    auto since = [](uint64_t now, uint64_t then) { return static_cast<double>(now - then); };
+    auto amplification = [](double written, double logical) { return logical > 0 ? written / logical : 0; };
+    LatencyHistogram::Snapshot fsync = engine.latencyOf(Engine::OP_FSYNC);
+    Napi::Object io = Napi::Object::New(env);
+    double logical = since(current.logical, ioBaseline.logical);
+    double written = since(current.written, ioBaseline.written);
+    io.Set("logicalBytes", Napi::Number::New(env, logical));
+    io.Set("writtenBytes", Napi::Number::New(env, written));
+    io.Set("readBytes", Napi::Number::New(env, since(current.read, ioBaseline.read)));
+    io.Set("writeAmplification", Napi::Number::New(env, amplification(written, logical)));
+    io.Set("fsyncs", Napi::Number::New(env, static_cast<double>(fsync.count)));
+    io.Set("fsyncTime", Napi::Number::New(env, static_cast<double>(fsync.sum) / 1e6));
+    Napi::Object sources = Napi::Object::New(env);
+    for (int i = 0; i < Engine::IO_SOURCE_COUNT; i++) {
+        Napi::Object source = Napi::Object::New(env);
+        source.Set("written", Napi::Number::New(env, since(current.writtenTo[i], ioBaseline.writtenTo[i])));
+        source.Set("read", Napi::Number::New(env, since(current.readFrom[i], ioBaseline.readFrom[i])));
+        sources.Set(Engine::ioSourceName(static_cast<Engine::IoSource>(i)), source);
+    }
+    io.Set("sources", sources);
+    Napi::Object operations = Napi::Object::New(env);
+    for (int i = 0; i < Engine::OP_FSYNC; i++) {
+        Napi::Object operation = Napi::Object::New(env);
+        double opLogical = since(current.logicalBy[i], ioBaseline.logicalBy[i]);
+        double opWritten = since(current.writtenBy[i], ioBaseline.writtenBy[i]);
+        operation.Set("logical", Napi::Number::New(env, opLogical));
+        operation.Set("written", Napi::Number::New(env, opWritten));
+        operation.Set("read", Napi::Number::New(env, since(current.readBy[i], ioBaseline.readBy[i])));
+        operation.Set("writeAmplification", Napi::Number::New(env, amplification(opWritten, opLogical)));
+        operations.Set(Engine::operationName(static_cast<Engine::Operation>(i)), operation);
+    }
+    io.Set("operations", operations);
+    metrics.Set("io", io);
+    
+    // Counted since the files were opened, not reset
+    MappedStore::BloomCounts counts = engine.bloomCounts();
+    Napi::Object bloom = Napi::Object::New(env);
+    bloom.Set("probes", Napi::Number::New(env, static_cast<double>(counts.probes)));
+    bloom.Set("negatives", Napi::Number::New(env, static_cast<double>(counts.negatives)));
+    bloom.Set("falsePositives", Napi::Number::New(env, static_cast<double>(counts.falsePositives)));
+    metrics.Set("bloom", bloom);
+    
+    if (reset) {
+        engine.resetLatency();
+        ioBaseline = current;
+    }
+    return metrics;
+}
+
+Napi::Value FastDB::MetricsText(const Napi::CallbackInfo& info) {
+    return Napi::String::New(info.Env(), engine.metricsText());
+}
+
+// slowLog({ reset }): the logged operations, newest first, with durations
+// in milliseconds
+Napi::Value FastDB::SlowLog(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    bool reset = false;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Value value = info[0].As<Napi::Object>().Get("reset");
+        reset = value.IsBoolean() && value.As<Napi::Boolean>().Value();
+    }
+    
+    std::vector<Engine::SlowOperation> entries = engine.slowLog();
+    Napi::Array result = Napi::Array::New(env, entries.size());
+    auto millis = [&](uint64_t nanos) { return Napi::Number::New(env, static_cast<double>(nanos) / 1e6); };
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Engine::SlowOperation& entry = entries[i];
+        Napi::Object item = Napi::Object::New(env);
+        item.Set("id", Napi::Number::New(env, static_cast<double>(entry.id)));
+        item.Set("timestamp", Napi::Number::New(env, static_cast<double>(entry.timestamp)));
+        item.Set("operation", Napi::String::New(env, Engine::operationName(entry.operation)));
+        item.Set("key", Napi::String::New(env, entry.key));
+        item.Set("duration", millis(entry.nanos));
+        Napi::Object phases = Napi::Object::New(env);
+        phases.Set("lookup", millis(entry.phases[Engine::PHASE_LOOKUP]));
+        phases.Set("parse", millis(entry.phases[Engine::PHASE_PARSE]));
+        phases.Set("serialize", millis(entry.phases[Engine::PHASE_SERIALIZE]));
+        phases.Set("io", millis(entry.phases[Engine::PHASE_IO]));
+        item.Set("phases", phases);
+        result[i] = item;
+    }
+    if (reset) engine.resetSlowLog();
+    return result;
+}
+
+// hotKeys(n = 10, { reset }): the most accessed keys, with per-second rates
+Napi::Value FastDB::HotKeys(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    double count = 10;
+    if (info.Length() > 0 && !info[0].IsUndefined()) count = info[0].IsNumber() ? info[0].As<Napi::Number>().DoubleValue() : -1;
+    if (!(count >= 1 && count <= Engine::HOT_KEY_CAPACITY)) {
+        Napi::RangeError::New(env, "n must be 1-" + std::to_string(Engine::HOT_KEY_CAPACITY)).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    bool reset = false;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        Napi::Value value = info[1].As<Napi::Object>().Get("reset");
+        reset = value.IsBoolean() && value.As<Napi::Boolean>().Value();
+    }
+    
+    std::vector<Engine::HotKey> keys = engine.hotKeys(static_cast<size_t>(count));
+    Napi::Array result = Napi::Array::New(env, keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        Napi::Object item = Napi::Object::New(env);
+        item.Set("key", Napi::String::New(env, keys[i].key));
+        item.Set("reads", Napi::Number::New(env, keys[i].reads));
+        item.Set("writes", Napi::Number::New(env, keys[i].writes));
+        item.Set("error", Napi::Number::New(env, keys[i].error));
+        item.Set("readRate", Napi::Number::New(env, keys[i].readRate));
+        item.Set("writeRate", Napi::Number::New(env, keys[i].writeRate));
+        result[i] = item;
+    }
+    if (reset) engine.resetHotKeys();
+    return result;
+}
+
+// memoryUsage(key): the bytes one key holds in memory, or null if missing
+Napi::Value FastDB::MemoryUsageOf(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Key must be a string").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Engine::KeyMemory usage;
+    if (!engine.keyMemory(info[0].As<Napi::String>().Utf8Value(), usage)) return env.Null();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("key", Napi::Number::New(env, static_cast<double>(usage.key)));
+    result.Set("value", Napi::Number::New(env, static_cast<double>(usage.value)));
+    result.Set("node", Napi::Number::New(env, static_cast<double>(usage.node)));
+    result.Set("disk", Napi::Number::New(env, static_cast<double>(usage.disk)));
+    result.Set("total", Napi::Number::New(env, static_cast<double>(usage.total())));
+    return result;
+}
+
+// memoryReport({ groupBy, separator, samples, limit })
+Napi::Value FastDB::MemoryReportOf(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    double groupBy = 1;
+    std::string separator = ":";
+    double samples = 10000;
+    double limit = 50;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Object options = info[0].As<Napi::Object>();
+        Napi::Value value = options.Get("groupBy");
+        if (!value.IsUndefined()) groupBy = value.IsNumber() ? value.As<Napi::Number>().DoubleValue() : -1;
+        value = options.Get("separator");
+        if (!value.IsUndefined()) separator = value.IsString() ? value.As<Napi::String>().Utf8Value() : "";
+        value = options.Get("samples");
+        if (!value.IsUndefined()) samples = value.IsNumber() ? value.As<Napi::Number>().DoubleValue() : -1;
+        value = options.Get("limit");
+        if (!value.IsUndefined()) limit = value.IsNumber() ? value.As<Napi::Number>().DoubleValue() : -1;
+    }
+    if (!(groupBy >= 1 && groupBy <= 16) || groupBy != static_cast<uint32_t>(groupBy)) {
+        Napi::RangeError::New(env, "groupBy must be 1-16").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (separator.size() != 1) {
+        Napi::RangeError::New(env, "separator must be a single character").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (!(samples >= 1 && samples <= 10000000) || !(limit >= 1 && limit <= 100000)) {
+        Napi::RangeError::New(env, "samples must be 1-10000000 and limit 1-100000").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Engine::MemoryReport report = engine.memoryReport(static_cast<uint32_t>(groupBy), separator[0],
+                                                      static_cast<size_t>(samples), static_cast<size_t>(limit));
+    auto groups = [&](const std::vector<Engine::MemoryGroup>& list, const char* name) {
+        Napi::Array array = Napi::Array::New(env, list.size());
+        for (size_t i = 0; i < list.size(); i++) {
+            Napi::Object item = Napi::Object::New(env);
+            item.Set(name, Napi::String::New(env, list[i].prefix));
+            item.Set("keys", Napi::Number::New(env, static_cast<double>(list[i].keys)));
+            item.Set("bytes", Napi::Number::New(env, static_cast<double>(list[i].bytes)));
+            array[i] = item;
+        }
+        return array;
+    };
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("totalKeys", Napi::Number::New(env, static_cast<double>(report.totalKeys)));
+    result.Set("sampledKeys", Napi::Number::New(env, static_cast<double>(report.sampledKeys)));
+    result.Set("prefixes", groups(report.prefixes, "prefix"));
+    result.Set("nestedPaths", groups(report.nestedPaths, "path"));
+    return result;
+}
+
+// restoreTo({ sequence } | { timestamp }): rebuilds the state as of the
+// target (see Engine::restoreTo()). Targets outside the retained history
+// are checked here so they throw RangeError.
+Napi::Value FastDB::RestoreTo(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (rejectWrite(env)) return env.Null();
+    Engine::WalStats wal = engine.walStats();
+    if (!wal.enabled || wal.retainCheckpoints == 0) {
+        Napi::Error::New(env, "restoreTo() needs the wal and retainCheckpoints options").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Value sequence = env.Undefined();
+    Napi::Value timestamp = env.Undefined();
+    if (info.Length() > 0 && info[0].IsObject()) {
+        sequence = info[0].As<Napi::Object>().Get("sequence");
+        timestamp = info[0].As<Napi::Object>().Get("timestamp");
+    }
+    bool bySequence = sequence.IsNumber();
+    if (!bySequence && !timestamp.IsNumber()) {
+        Napi::TypeError::New(env, "Restore target must have a sequence or timestamp").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    double value = (bySequence ? sequence : timestamp).As<Napi::Number>().DoubleValue();
+    if (!(value >= 0)) {
+        Napi::RangeError::New(env, "Restore target must not be negative").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    uint64_t target = static_cast<uint64_t>(value);
+    if (bySequence && target > wal.sequence) {
+        Napi::RangeError::New(env, "Sequence " + std::to_string(target) + " has not been written yet")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    if (wal.retainedCheckpoints == 0 ||
+        target < (bySequence ? wal.oldestRestoreSequence : wal.oldestRestoreTimestamp)) {
+        Napi::RangeError::New(env, "Restore target predates the oldest retained checkpoint").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Engine::RestorePoint restored;
+    std::string error;
+    if (!engine.restoreTo(target, bySequence, restored, error)) {
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("sequence", Napi::Number::New(env, static_cast<double>(restored.sequence)));
+    result.Set("timestamp", Napi::Number::New(env, static_cast<double>(restored.timestamp)));
+    result.Set("checkpoint", Napi::Number::New(env, static_cast<double>(restored.checkpoint)));
+    result.Set("records", Napi::Number::New(env, static_cast<double>(restored.records)));
+    return result;
+}
+
+// Embedded RESP server (startServer): an epoll loop on its own thread owns
+// the sockets and parses pipelined commands. The indexes stay single
+// threaded, so each connection's parsed commands are handed to the
+// JavaScript thread as one batch, run there, and the replies handed back.
+// A connection has at most one batch in flight, which keeps replies in order.
+class RespServer {
+public:
+    // Commands are accepted from the socket in batches of up to this many
+    static const size_t MAX_BATCH = 1024;
+    static const size_t MAX_BULK = 16 * 1024 * 1024;
+    // Stop reading from a client whose replies are not being read
+    static const size_t MAX_OUTPUT = 4 * 1024 * 1024;
+    // Unparsed input buffered per client; a longer command is refused
+    static const size_t MAX_INPUT = 64 * 1024 * 1024;
+    
+    explicit RespServer(FastDB* db)
+        : db(db), port(0), openConnections(0), totalConnections(0), commands(0), batches(0), listenFd(-1),
+          epollFd(-1), wakeFd(-1), tsfn(nullptr), nextId(FIRST_CONNECTION), scheduled(false), stopping(false) {}
+    
+    bool start(Napi::Env env, Napi::Object owner, const std::string& host, int requestedPort, std::string& error);
+    void stop();
+    
+    FastDB* db;
+    int port;
+    std::atomic<uint64_t> openConnections;
+    std::atomic<uint64_t> totalConnections;
+    uint64_t commands;
+    uint64_t batches;
+    
+private:
+    static const uint64_t LISTENER = 0;
+    static const uint64_t WAKER = 1;
+    static const uint64_t FIRST_CONNECTION = 2;
+    
+    struct Connection {
+        int fd;
+        std::string input;
+        std::string output;
+        bool busy;
+        bool closing;
+        // The epoll events currently watched
+        uint32_t events;
+    };
+    struct Batch {
+        uint64_t connection;
+        std::vector<std::vector<std::string>> commands;
+        std::string reply;
+    };
+    
+    int listenFd;
+    int epollFd;
+    int wakeFd;
+    napi_threadsafe_function tsfn;
+    Napi::ObjectReference ownerRef;
+    std::thread thread;
+    std::unordered_map<uint64_t, Connection> connections;
+    uint64_t nextId;
+    
+    std::mutex mutex;
+    std::vector<Batch> pending;
+    std::vector<Batch> done;
+    bool scheduled;
+    std::atomic<bool> stopping;
+    
+    void run();
+    void accept();
+    void receive(uint64_t id);
+    void dispatch(uint64_t id, Connection& connection);
+    void flush(uint64_t id, Connection& connection);
+    void watch(uint64_t id, Connection& connection);
+    void close(uint64_t id);
+    void deliver();
+    void runBatches();
+    static void CallJs(napi_env env, napi_value, void* context, void*);
+    static void Finalize(napi_env, void* data, void*);
+    static void Cleanup(void* data);
+    
+    // Command execution, on the JavaScript thread
+    void execute(const std::vector<std::string>& argv, std::string& out);
+    bool lookup(const std::string& key, std::string& value, bool& numeric);
+    void scan(const std::vector<std::string>& argv, std::string& out);
+    const char* writeBlocked() const;
+};
+
+// Parses one command at pos: 1 when complete (pos moves past it), 0 when
+// more input is needed, -1 on a protocol error. Besides RESP arrays of bulk
+// strings, plain space-separated lines are accepted as inline commands.
+static int parseRespCommand(const std::string& in, size_t& pos, std::vector<std::string>& argv, std::string& error) {
+    argv.clear();
+    size_t p = pos;
+    auto readLine = [&](size_t from, size_t& end) {
+        end = in.find("\r\n", from);
+        return end != std::string::npos;
+    };
+    auto readNumber = [&](size_t from, size_t end, long long& value) {
+        if (from >= end) return false;
+        char* stop = nullptr;
+        value = std::strtoll(in.c_str() + from, &stop, 10);
+        return stop == in.c_str() + end;
+    };
+    
+    if (p >= in.size()) return 0;
+    if (in[p] != '*') {
+        size_t end = in.find('\n', p);
+        if (end == std::string::npos) {
+            if (in.size() - p > 64 * 1024) {
+                error = "inline command too long";
+                return -1;
+            }
+            return 0;
+        }
+        std::istringstream words(in.substr(p, end - p));
+        std::string word;
+        while (words >> word) argv.push_back(word);
+        pos = end + 1;
+        return 1;
+    }
+    
+    size_t end = 0;
+    long long count = 0;
+    if (!readLine(p, end)) return 0;
+    if (!readNumber(p + 1, end, count) || count < 1 || count > 1024 * 1024) {
+        error = "invalid multibulk length";
+        return -1;
+    }
+    p = end + 2;
+    argv.reserve(static_cast<size_t>(count));
+    for (long long i = 0; i < count; i++) {
+        if (p >= in.size()) return 0;
+        if (in[p] != '$') {
+            error = "expected '$'";
+            return -1;
+        }
+        long long length = 0;
+        if (!readLine(p, end)) return 0;
+        if (!readNumber(p + 1, end, length) || length < 0 || length > static_cast<long long>(RespServer::MAX_BULK)) {
+            error = "invalid bulk length";
+            return -1;
+        }
+        p = end + 2;
+        if (in.size() < p + static_cast<size_t>(length) + 2) return 0;
+        argv.emplace_back(in, p, static_cast<size_t>(length));
+        p += static_cast<size_t>(length) + 2;
+    }
+    pos = p;
+    return 1;
+}
+
+// Redis glob patterns: * ? [abc] [^a-z] and \ escapes
+static bool globMatch(const char* pattern, const char* patternEnd, const char* text, const char* textEnd) {
+    const char* starPattern = nullptr;
+    const char* starText = nullptr;
+    while (text < textEnd) {
+        if (pattern < patternEnd && *pattern == '*') {
+            starPattern = ++pattern;
+            starText = text;
+            continue;
+        }
+        bool matched = false;
+        const char* next = pattern + 1;
+        if (pattern < patternEnd) {
+            if (*pattern == '?') {
+                matched = true;
+            } else if (*pattern == '[') {
+                const char* p = pattern + 1;
+                bool negate = p < patternEnd && *p == '^';
+                if (negate) p++;
+                bool found = false;
+                while (p < patternEnd && *p != ']') {
+                    if (*p == '\\' && p + 1 < patternEnd) p++;
+                    if (p + 2 < patternEnd && p[1] == '-' && p[2] != ']') {
+                        found = found || (*text >= p[0] && *text <= p[2]);
+                        p += 3;
+                    } else {
+                        found = found || *text == *p;
+                        p++;
+                    }
+                }
+                matched = found != negate;
+                next = p < patternEnd ? p + 1 : p;
+            } else {
+                const char* literal = pattern;
+                if (*literal == '\\' && literal + 1 < patternEnd) literal++;
+                matched = *literal == *text;
+                next = literal + 1;
+            }
+        }
+        if (matched) {
+            pattern = next;
+            text++;
+        } else if (starPattern) {
+            pattern = starPattern;
+            text = ++starText;
+        } else {
+            return false;
+        }
+    }
+    while (pattern < patternEnd && *pattern == '*') pattern++;
+    return pattern == patternEnd;
+}
+
+static void respBulk(std::string& out, const char* data, size_t length) {
+    out += '$';
+    out += std::to_string(length);
+    out += "\r\n";
+    out.append(data, length);
+    out += "\r\n";
+}
+
+static void respInteger(std::string& out, long long value) {
+    out += ':';
+    out += std::to_string(value);
+    out += "\r\n";
+}
+
+#ifdef __linux__
+bool RespServer::start(Napi::Env env, Napi::Object owner, const std::string& host, int requestedPort, std::string& error) {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(requestedPort));
+    if (inet_pton(AF_INET, host == "localhost" ? "127.0.0.1" : host.c_str(), &address.sin_addr) != 1) {
+        error = "Invalid IPv4 address: " + host;
+        return false;
+    }
+    
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int reuse = 1;
+    if (listenFd < 0 || setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+        error = "Cannot listen on " + host + ":" + std::to_string(requestedPort) + ": " + std::strerror(errno);
+        return false;
+    }
+    socklen_t length = sizeof(address);
+    getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &length);
+    port = ntohs(address.sin_port);
+    
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) {
+        error = std::string("Cannot start the server: ") + std::strerror(errno);
+        return false;
+    }
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = LISTENER;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.u64 = WAKER;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+    
+    napi_value name;
+    napi_create_string_utf8(env, "FastDBServer", NAPI_AUTO_LENGTH, &name);
+    if (napi_create_threadsafe_function(env, nullptr, nullptr, name, 0, 1, nullptr, Finalize, this, CallJs, &tsfn) != napi_ok) {
+        error = "Cannot start the server";
+        return false;
+    }
+    napi_add_env_cleanup_hook(env, Cleanup, this);
+    // A running server keeps its database alive
+    ownerRef = Napi::Persistent(owner);
+    thread = std::thread(&RespServer::run, this);
+    return true;
+}
+
+// Joins the I/O thread and closes every socket. The object itself is freed
+// once the thread-safe function is finalized, after any queued call.
+void RespServer::stop() {
+    if (thread.joinable()) {
+        stopping = true;
+        uint64_t one = 1;
+        if (write(wakeFd, &one, sizeof(one)) < 0) {}
+        thread.join();
+    }
+    stopping = true;
+    for (auto& pair : connections) ::close(pair.second.fd);
+    connections.clear();
+    openConnections = 0;
+    for (int* fd : { &listenFd, &epollFd, &wakeFd }) {
+        if (*fd >= 0) ::close(*fd);
+        *fd = -1;
+    }
+    if (!ownerRef.IsEmpty()) {
+        napi_remove_env_cleanup_hook(ownerRef.Env(), Cleanup, this);
+        ownerRef.Reset();
+    }
+    if (tsfn) {
+        napi_release_threadsafe_function(tsfn, napi_tsfn_abort);
+        tsfn = nullptr;
+    } else {
+        delete this;
+    }
+}
+
+void RespServer::Cleanup(void* data) {
+    RespServer* server = static_cast<RespServer*>(data);
+    server->db->server = nullptr;
+    server->stop();
+}
+
+void RespServer::Finalize(napi_env, void* data, void*) {
+    delete static_cast<RespServer*>(data);
+}
+
+void RespServer::run() {
+    epoll_event events[64];
+    while (!stopping) {
+        int count = epoll_wait(epollFd, events, 64, -1);
+        if (count < 0 && errno != EINTR) break;
+        for (int i = 0; i < count && !stopping; i++) {
+            uint64_t id = events[i].data.u64;
+            if (id == LISTENER) {
+                accept();
+            } else if (id == WAKER) {
+                uint64_t value;
+                if (read(wakeFd, &value, sizeof(value)) < 0) {}
+                deliver();
+            } else {
+                auto it = connections.find(id);
+                if (it == connections.end()) continue;
+                if ((events[i].events & (EPOLLHUP | EPOLLERR)) && !(it->second.events & EPOLLIN)) {
+                    // Hangups are reported even while reading is off
+                    close(id);
+                } else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    receive(id);
+                } else if (events[i].events & EPOLLOUT) {
+                    flush(id, it->second);
+                }
+            }
+        }
+        
+        bool notify = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!pending.empty() && !scheduled) {
+                scheduled = true;
+                notify = true;
+            }
+        }
+        if (notify) napi_call_threadsafe_function(tsfn, nullptr, napi_tsfn_nonblocking);
+    }
+}
+
+void RespServer::accept() {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        uint64_t id = nextId++;
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            ::close(fd);
+            continue;
+        }
+        connections[id] = Connection{ fd, std::string(), std::string(), false, false, EPOLLIN };
+        openConnections++;
+        totalConnections++;
+    }
+}
+
+void RespServer::receive(uint64_t id) {
+    Connection& connection = connections[id];
+    char buffer[64 * 1024];
+    for (;;) {
+        ssize_t received = read(connection.fd, buffer, sizeof(buffer));
+        if (received > 0) {
+            connection.input.append(buffer, static_cast<size_t>(received));
+            if (static_cast<size_t>(received) < sizeof(buffer) || connection.input.size() >= MAX_INPUT) break;
+        } else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (received < 0 && errno == EINTR) {
+            continue;
+        } else {
+            close(id);
+            return;
+        }
+    }
+    dispatch(id, connection);
+    watch(id, connection);
+}
+
+// Queues the complete commands buffered for a connection as one batch
+void RespServer::dispatch(uint64_t id, Connection& connection) {
+    if (connection.busy || connection.closing || connection.output.size() > MAX_OUTPUT) return;
+    
+    Batch batch;
+    batch.connection = id;
+    size_t pos = 0;
+    std::vector<std::string> argv;
+    std::string error;
+    int result = 0;
+    while (batch.commands.size() < MAX_BATCH && (result = parseRespCommand(connection.input, pos, argv, error)) == 1) {
+        if (argv.empty()) continue;
+        // Anything pipelined after QUIT is ignored
+        bool quit = strcasecmp(argv[0].c_str(), "QUIT") == 0;
+        batch.commands.push_back(std::move(argv));
+        if (quit) {
+            connection.closing = true;
+            pos = connection.input.size();
+            break;
+        }
+    }
+    connection.input.erase(0, pos);
+    if (result == 0 && batch.commands.empty() && connection.input.size() >= MAX_INPUT) {
+        error = "command too long";
+        result = -1;
+    }
+    
+    if (result < 0) {
+        // Replies to the commands before the error are still sent
+        batch.commands.push_back({ std::string("\x01") + "Protocol error: " + error });
+        connection.input.clear();
+        connection.closing = true;
+    }
+    if (batch.commands.empty()) return;
+    connection.busy = true;
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(std::move(batch));
+}
+
+void RespServer::flush(uint64_t id, Connection& connection) {
+    size_t written = 0;
+    while (written < connection.output.size()) {
+        ssize_t count = write(connection.fd, connection.output.data() + written, connection.output.size() - written);
+        if (count > 0) {
+            written += static_cast<size_t>(count);
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            close(id);
+            return;
+        }
+    }
+    connection.output.erase(0, written);
+    
+    if (connection.output.empty() && connection.closing && !connection.busy) {
+        close(id);
+        return;
+    }
+    dispatch(id, connection);
+    watch(id, connection);
+}
+
+// Input is only read while it can be dispatched: not while a batch is in
+// flight, the replies are over MAX_OUTPUT, the client has quit or MAX_INPUT
+// is buffered. Each of those ends in flush(), which turns reading back on.
+void RespServer::watch(uint64_t id, Connection& connection) {
+    uint32_t events = 0;
+    if (!connection.busy && !connection.closing && connection.output.size() <= MAX_OUTPUT &&
+        connection.input.size() < MAX_INPUT) {
+        events |= EPOLLIN;
+    }
+    if (!connection.output.empty()) events |= EPOLLOUT;
+    if (events == connection.events) return;
+    
+    epoll_event event;
+    event.events = events;
+    event.data.u64 = id;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+}
+
+void RespServer::close(uint64_t id) {
+    auto it = connections.find(id);
+    if (it == connections.end()) return;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    ::close(it->second.fd);
+    connections.erase(it);
+    openConnections--;
+}
+
+// Hands finished batches back to their connections
+void RespServer::deliver() {
+    std::vector<Batch> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.swap(done);
+    }
+    for (auto& batch : finished) {
+        auto it = connections.find(batch.connection);
+        if (it == connections.end()) continue;
+        Connection& connection = it->second;
+        connection.busy = false;
+        if (connection.output.empty()) {
+            connection.output = std::move(batch.reply);
+        } else {
+            connection.output += batch.reply;
+        }
+        flush(batch.connection, connection);
+    }
+}
+
+void RespServer::CallJs(napi_env env, napi_value, void* context, void*) {
+    if (!env) return;
+    static_cast<RespServer*>(context)->runBatches();
+}
+
+// Runs queued batches on the JavaScript thread. Without a log, the batch's
+// writes are saved once before any of its replies go out.
+void RespServer::runBatches() {
+    std::vector<Batch> batchesToRun;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batchesToRun.swap(pending);
+        scheduled = false;
+    }
+    if (stopping) return;
+    
+    db->engine.beginBatch();
+    for (auto& batch : batchesToRun) {
+        for (const auto& argv : batch.commands) execute(argv, batch.reply);
+        commands += batch.commands.size();
+    }
+    db->engine.endBatch();
+    batches += batchesToRun.size();
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& batch : batchesToRun) done.push_back(std::move(batch));
+    }
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) {}
+}
+#else
+bool RespServer::start(Napi::Env, Napi::Object, const std::string&, int, std::string& error) {
+    error = "The RESP server needs Linux (epoll)";
+    return false;
+}
+
+void RespServer::stop() {
+    delete this;
+}
+#endif
+
+const char* RespServer::writeBlocked() const {
+    switch (db->engine.writeState()) {
+        case Engine::LOADING:
+            return "-LOADING Database is still loading\r\n";
+        case Engine::FOLLOWING:
+            return "-READONLY Database is a follower\r\n";
+        case Engine::READ_ONLY:
+            return "-READONLY Database is read-only\r\n";
+        default:
+            return nullptr;
+    }
+}
+
+// Reads a key the way get() does; numeric arrays are reported, not returned
+bool RespServer::lookup(const std::string& key, std::string& value, bool& numeric) {
+    RecordView record;
+    std::string scratch;
+    if (!db->engine.lookup(std::string(), key, record, scratch)) return false;
+    numeric = record.type != Entry::STRING;
+    if (!numeric) value.assign(record.value, record.valueLength);
+    return true;
+}
+
+void RespServer::execute(const std::vector<std::string>& argv, std::string& out) {
+    std::string name = argv[0];
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::toupper(c); });
+    size_t argc = argv.size();
+    auto wrongArity = [&]() {
+        out += "-ERR wrong number of arguments for '" + argv[0] + "' command\r\n";
+    };
+    static const char WRONGTYPE[] = "-WRONGTYPE Operation against a key holding a numeric array\r\n";
+    std::string value;
+    bool numeric = false;
+    
+    if (name[0] == '\x01') {
+        out += "-ERR " + name.substr(1) + "\r\n";
+    } else if (name == "GET") {
+        if (argc != 2) return wrongArity();
+        if (!lookup(argv[1], value, numeric)) {
+            out += "$-1\r\n";
+        } else if (numeric) {
+            out += WRONGTYPE;
+        } else {
+            respBulk(out, value.data(), value.size());
+        }
+    } else if (name == "MGET") {
+        if (argc < 2) return wrongArity();
+        out += "*" + std::to_string(argc - 1) + "\r\n";
+        for (size_t i = 1; i < argc; i++) {
+            if (lookup(argv[i], value, numeric) && !numeric) {
+                respBulk(out, value.data(), value.size());
+            } else {
+                out += "$-1\r\n";
+            }
+        }
+    } else if (name == "EXISTS") {
+        if (argc < 2) return wrongArity();
+        long long count = 0;
+        for (size_t i = 1; i < argc; i++) {
+            if (db->engine.contains(std::string(), argv[i])) count++;
+        }
+        respInteger(out, count);
+    } else if (name == "SET") {
+        if (argc != 3) return wrongArity();
+        if (const char* blocked = writeBlocked()) {
+            out += blocked;
+        } else if (argv[1].empty() || argv[1].size() > 1000) {
+            out += "-ERR key must be 1-1000 characters\r\n";
+        } else if (argv[2].size() > 10000000) {
+            out += "-ERR value too large (max 10MB)\r\n";
+        } else if (db->engine.put(std::string(), argv[1], Entry(argv[2]))) {
+            out += "+OK\r\n";
+        } else {
+            out += "-ERR cannot set nested key\r\n";
+        }
+    } else if (name == "DEL") {
+        if (argc < 2) return wrongArity();
+        if (const char* blocked = writeBlocked()) {
+            out += blocked;
+            return;
+        }
+        long long count = 0;
+        for (size_t i = 1; i < argc; i++) {
+            if (db->engine.remove(std::string(), argv[i])) count++;
+        }
+        respInteger(out, count);
+    } else if (name == "INCRBY") {
+        if (argc != 3) return wrongArity();
+        if (const char* blocked = writeBlocked()) {
+            out += blocked;
+            return;
+        }
+        char* end = nullptr;
+        errno = 0;
+        long long increment = std::strtoll(argv[2].c_str(), &end, 10);
+        if (argv[2].empty() || *end != '\0' || errno == ERANGE) {
+            out += "-ERR value is not an integer or out of range\r\n";
+            return;
+        }
+        // Numbers set from JavaScript are stored as "5.000000". Values stay
+        // within +-2^53, where doubles are exact, so get() reads them back
+        // as the same number; checking against that bound first also keeps
+        // the addition from overflowing.
+        const long long MAX_EXACT = 9007199254740992LL;
+        double current = 0;
+        if (lookup(argv[1], value, numeric)) {
+            if (numeric) {
+                out += WRONGTYPE;
+                return;
+            }
+            current = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || current != std::floor(current) ||
+                std::fabs(current) > static_cast<double>(MAX_EXACT)) {
+                out += "-ERR value is not an integer or out of range\r\n";
+                return;
+            }
+        }
+        long long base = static_cast<long long>(current);
+        if (increment > MAX_EXACT - base || increment < -MAX_EXACT - base) {
+            out += "-ERR increment or decrement would overflow\r\n";
+            return;
+        }
+        long long result = base + increment;
+        if (argv[1].size() > 1000 || !db->engine.put(std::string(), argv[1], Entry(std::to_string(result)))) {
+            out += "-ERR cannot set key\r\n";
+            return;
+        }
+        respInteger(out, result);
+    } else if (name == "SCAN") {
+        if (argc < 2) return wrongArity();
+        scan(argv, out);
+    } else if (name == "PING") {
+        if (argc > 2) return wrongArity();
+        if (argc == 2) {
+            respBulk(out, argv[1].data(), argv[1].size());
+        } else {
+            out += "+PONG\r\n";
+        }
+    } else if (name == "QUIT") {
+        out += "+OK\r\n";
+    } else if (name == "COMMAND") {
+        // Clients probe this on connect; an empty reply makes them fall back
+        out += "*0\r\n";
+    } else {
+        out += "-ERR unknown command '" + argv[0] + "'\r\n";
+    }
+}
+
+// SCAN cursor [MATCH pattern] [COUNT count], walked by Engine::scanFrom()
+void RespServer::scan(const std::vector<std::string>& argv, std::string& out) {
+    char* end = nullptr;
+    uint64_t cursor = std::strtoull(argv[1].c_str(), &end, 10);
+    if (argv[1].empty() || *end != '\0') {
+        out += "-ERR invalid cursor\r\n";
+        return;
+    }
+    std::string pattern;
+    bool hasPattern = false;
+    size_t count = 10;
+    for (size_t i = 2; i < argv.size(); i += 2) {
+        std::string option = argv[i];
+        std::transform(option.begin(), option.end(), option.begin(), [](unsigned char c) { return std::toupper(c); });
+        if (i + 1 >= argv.size() || (option != "MATCH" && option != "COUNT")) {
+            out += "-ERR syntax error\r\n";
+            return;
+        }
+        if (option == "MATCH") {
+            pattern = argv[i + 1];
+            hasPattern = pattern != "*";
+        } else {
+            long long value = std::strtoll(argv[i + 1].c_str(), &end, 10);
+            if (*end != '\0' || value < 1) {
+                out += "-ERR syntax error\r\n";
+                return;
+            }
+            count = static_cast<size_t>(value);
+        }
+    }
+    
+    std::vector<std::string> keys;
+    auto visit = [&](const char* key, size_t length) {
+        if (!hasPattern || globMatch(pattern.data(), pattern.data() + pattern.size(), key, key + length)) {
+            keys.emplace_back(key, length);
+        }
+    };
+    uint64_t next = db->engine.scanFrom(cursor, count, visit);
+    
+    out += "*2\r\n";
+    std::string nextCursor = std::to_string(next);
+    respBulk(out, nextCursor.data(), nextCursor.size());
+    out += "*" + std::to_string(keys.size()) + "\r\n";
+    for (const auto& key : keys) respBulk(out, key.data(), key.size());
+}
+
+// startServer({ port, host }): listens for RESP clients; returns the port
+Napi::Value FastDB::StartServer(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (server) {
+        Napi::Error::New(env, "Server is already running on port " + std::to_string(server->port))
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    int port = 6379;
+    std::string host = "127.0.0.1";
+    if (info.Length() > 0 && info[0].IsObject()) {
+        Napi::Object options = info[0].As<Napi::Object>();
+        Napi::Value portOption = options.Get("port");
+        if (!portOption.IsUndefined()) {
+            double value = portOption.IsNumber() ? portOption.As<Napi::Number>().DoubleValue() : -1;
+            if (value < 0 || value > 65535 || value != std::floor(value)) {
+                Napi::RangeError::New(env, "port must be 0-65535").ThrowAsJavaScriptException();
+                return env.Null();
+            }
+            port = static_cast<int>(value);
+        }
+        Napi::Value hostOption = options.Get("host");
+        if (hostOption.IsString()) host = hostOption.As<Napi::String>().Utf8Value();
+    }
+    
+    RespServer* started = new RespServer(this);
+    std::string error;
+    if (!started->start(env, info.This().As<Napi::Object>(), host, port, error)) {
+        started->stop();
+        Napi::Error::New(env, error).ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    server = started;
+    return Napi::Number::New(env, server->port);
+}
+
+Napi::Value FastDB::StopServer(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!server) return Napi::Boolean::New(env, false);
+    RespServer* stopped = server;
+    server = nullptr;
+    stopped->stop();
+    return Napi::Boolean::New(env, true);
+}
+
+Napi::Value FastDB::ServerStats(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("running", Napi::Boolean::New(env, server != nullptr));
+    stats.Set("port", Napi::Number::New(env, server ? server->port : 0));
+    stats.Set("connections", Napi::Number::New(env, server ? static_cast<double>(server->openConnections.load()) : 0));
+    stats.Set("totalConnections", Napi::Number::New(env, server ? static_cast<double>(server->totalConnections.load()) : 0));
+    stats.Set("commands", Napi::Number::New(env, server ? static_cast<double>(server->commands) : 0));
+    stats.Set("batches", Napi::Number::New(env, server ? static_cast<double>(server->batches) : 0));
+    return stats;
+}
+
+Napi::Value FastDB::CatchUp(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (engine.writeState() != Engine::FOLLOWING) {
+        Napi::Error::New(env, "Database is not a follower").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    return Napi::Number::New(env, static_cast<double>(engine.catchUp()));
+}
+
+Napi::Value FastDB::ReplicationStatus(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    Engine::ReplicationStatus replication = engine.replicationStatus();
+    Napi::Object status = Napi::Object::New(env);
+    status.Set("role", Napi::String::New(env, replication.role));
+    status.Set("sequence", Napi::Number::New(env, static_cast<double>(replication.sequence)));
+    status.Set("pendingBytes", Napi::Number::New(env, static_cast<double>(replication.pendingBytes)));
+    status.Set("lagMs", Napi::Number::New(env, static_cast<double>(replication.lagMs)));
+    status.Set("appliedRecords", Napi::Number::New(env, static_cast<double>(replication.appliedRecords)));
+    status.Set("reloads", Napi::Number::New(env, static_cast<double>(replication.reloads)));
+    return status;
+}
+
+// Failover: see Engine::promote()
+Napi::Value FastDB::Promote(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    
+    if (engine.writeState() != Engine::FOLLOWING) {
+        Napi::Error::New(env, "Database is not a follower").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    return Napi::Boolean::New(env, engine.promote());
+}
+
+// FastDB numeric array helpers
+bool FastDB::toNumericArray(const Napi::Value& value, Entry& out) {
+    if (!value.IsTypedArray()) return false;
+    
+    Napi::TypedArray array = value.As<Napi::TypedArray>();
+    if (array.TypedArrayType() == napi_float64_array) {
+        Napi::Float64Array values = value.As<Napi::Float64Array>();
+        out = Entry(std::string(reinterpret_cast<const char*>(values.Data()), values.ElementLength() * sizeof(double)),
+                    Entry::FLOAT64_ARRAY);
+        return true;
+    }
+    if (array.TypedArrayType() == napi_int32_array) {
+        Napi::Int32Array values = value.As<Napi::Int32Array>();
+        out = Entry(std::string(reinterpret_cast<const char*>(values.Data()), values.ElementLength() * sizeof(int32_t)),
+                    Entry::INT32_ARRAY);
+        return true;
+    }
+    return false;
+}
+
+// A number, an array of numbers or any other typed array, as float64
+// elements; Engine::append() converts them to the array's element type
+bool FastDB::toNumbers(const Napi::Value& value, Entry& out) {
+    out = Entry(std::string(), Entry::FLOAT64_ARRAY);
+    auto appendOne = [&out](const Napi::Value& element) {
+        if (!element.IsNumber()) return false;
+        double number = element.As<Napi::Number>().DoubleValue();
+        out.value.append(reinterpret_cast<const char*>(&number), sizeof(number));
+        return true;
+    };
+    
+    if (value.IsNumber()) return appendOne(value);
+    
+    if (value.IsTypedArray()) {
+        Napi::TypedArray array = value.As<Napi::TypedArray>();
+        for (size_t i = 0; i < array.ElementLength(); i++) {
+            if (!appendOne(array.Get(static_cast<uint32_t>(i)))) return false;
+        }
+        return true;
+    }
+    
+    if (value.IsArray()) {
+        Napi::Array array = value.As<Napi::Array>();
+        uint32_t length = array.Length();
+        out.value.reserve(length * sizeof(double));
+        for (uint32_t i = 0; i < length; i++) {
+            if (!appendOne(array.Get(i))) return false;
+        }
+        return true;
+    }
+    
+    return false;
+}
+
+Napi::Value FastDB::toTypedArray(Napi::Env env, const Entry& entry, size_t start, size_t end) {
+    size_t elementSize = NumericArray::elementSize(entry.type);
+    const char* source = entry.value.data() + start * elementSize;
+    
+    if (entry.type == Entry::FLOAT64_ARRAY) {
+        Napi::Float64Array result = Napi::Float64Array::New(env, end - start);
+        memcpy(result.Data(), source, (end - start) * elementSize);
+        return result;
+    }
+    Napi::Int32Array result = Napi::Int32Array::New(env, end - start);
+    memcpy(result.Data(), source, (end - start) * elementSize);
+    return result;
+}
+
+const Entry* FastDB::findNumericArray(const Napi::CallbackInfo& info) {
+    if (info.Length() < 1 || !info[0].IsString()) {
+        Napi::TypeError::New(info.Env(), "Key must be a string").ThrowAsJavaScriptException();
+        return nullptr;
+    }
+    return engine.numericArray(info[0].As<Napi::String>().Utf8Value());
+}
+
+Napi::Value FastDB::toJS(Napi::Env env, const RecordView& record) {
+    if (record.type == Entry::STRING) {
+        return Napi::String::New(env, record.value, record.valueLength);
+    }
+    size_t length = record.valueLength / NumericArray::elementSize(record.type);
+    if (record.type == Entry::FLOAT64_ARRAY) {
+        Napi::Float64Array result = Napi::Float64Array::New(env, length);
+        memcpy(result.Data(), record.value, length * sizeof(double));
+        return result;
+    }
+    Napi::Int32Array result = Napi::Int32Array::New(env, length);
+    memcpy(result.Data(), record.value, length * sizeof(int32_t));
+    return result;
+}
+
+
 Napi::Object InitAll(Napi::Env env, Napi::Object exports) {
     return FastDB::Init(env, exports);
 }
 
-NODE_API_MODULE(fastdb, InitAll) 
\ No newline at end of file
+NODE_API_MODULE(fastdb, InitAll)
\ No newline at end of file
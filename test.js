@@ -42,6 +42,34 @@ assert.strictEqual(removed, 1);
 assert.strictEqual(yeniFavoriler.length, 2);
 console.log('   ✓ Array push/pull çalışıyor');
 
+console.log('✅ Sayısal Dizi Testi');
+db.set('olcumler', new Float64Array([1.5, 2.5, -4]));
+assert.strictEqual(db.push('olcumler', 10), 4);
+assert.strictEqual(db.append('olcumler', [0.5, 3]), 6);
+const olcumler = db.get('olcumler');
+assert.ok(olcumler instanceof Float64Array);
+assert.deepStrictEqual(Array.from(olcumler), [1.5, 2.5, -4, 10, 0.5, 3]);
+assert.deepStrictEqual(Array.from(db.slice('olcumler', -2)), [0.5, 3]);
+assert.strictEqual(db.sum('olcumler'), 13.5);
+assert.strictEqual(db.min('olcumler'), -4);
+assert.strictEqual(db.max('olcumler'), 10);
+db.set('sayaclar', new Int32Array([7, -3, 12, 5, 9]));
+assert.ok(db.get('sayaclar') instanceof Int32Array);
+assert.strictEqual(db.sum('sayaclar'), 30);
+assert.strictEqual(db.min('sayaclar'), -3);
+assert.strictEqual(db.max('sayaclar'), 12);
+assert.strictEqual(db.append('test', 1), null);
+db.load();
+assert.deepStrictEqual(Array.from(db.get('sayaclar')), [7, -3, 12, 5, 9]);
+db.set('sarmal', new Int32Array([1]));
+db.append('sarmal', [3e10, -3e10, 2 ** 31, -(2 ** 31) - 1, 2.9, -2.9]);
+db.push('sarmal', NaN);
+db.append('sarmal', [Infinity, -Infinity]);
+assert.deepStrictEqual(Array.from(db.get('sarmal')),
+    Array.from(new Int32Array([1, 3e10, -3e10, 2 ** 31, -(2 ** 31) - 1, 2.9, -2.9, NaN, Infinity, -Infinity])));
+assert.deepStrictEqual(Array.from(db.get('sarmal')).slice(5), [2, -2, 0, 0, 0]);
+console.log('   ✓ Float64Array/Int32Array değerleri çalışıyor');
+
 console.log('✅ Matematik İşlemleri Testi');
 db.set('puan', '100');
 db.add('puan', 50);
@@ -90,6 +118,485 @@ assert.strictEqual(typeof stats.totalSize, 'number');
 assert.strictEqual(stats.filename, testFile);
 console.log('   ✓ Stats çalışıyor');
 
+console.log('✅ Paketli Dışa Aktarma Testi');
+const decoder = new TextDecoder();
+const packedKeys = db.keysPacked();
+assert.strictEqual(packedKeys.offsets.length, db.keys().length + 1);
+const unpackedKeys = [];
+for (let i = 0; i + 1 < packedKeys.offsets.length; i++) {
+    unpackedKeys.push(decoder.decode(new Uint8Array(packedKeys.data, packedKeys.offsets[i], packedKeys.offsets[i + 1] - packedKeys.offsets[i])));
+}
+assert.deepStrictEqual(unpackedKeys.sort(), db.keys().sort());
+const packedEntries = db.entriesPacked();
+const entryBytes = new Uint8Array(packedEntries.data);
+const slice = (i) => decoder.decode(entryBytes.subarray(packedEntries.offsets[i], packedEntries.offsets[i + 1]));
+for (let i = 0; 2 * i + 2 < packedEntries.offsets.length; i++) {
+    assert.strictEqual(slice(2 * i + 1), db.get(slice(2 * i)));
+}
+console.log('   ✓ keysPacked/entriesPacked çalışıyor');
+
+console.log('✅ Koleksiyon Testi');
+const kullanicilar = db.collection('kullanicilar');
+kullanicilar.set('ahmet', 'admin').set('ahmet.profil.tema', 'koyu');
+assert.strictEqual(kullanicilar.get('ahmet'), 'admin');
+assert.strictEqual(kullanicilar.get('ahmet.profil.tema'), 'koyu');
+assert.strictEqual(kullanicilar.get('mehmet', 'misafir'), 'misafir');
+assert.strictEqual(db.has('ahmet'), false);
+assert.strictEqual(kullanicilar.size(), 2);
+assert.deepStrictEqual(db.collections(), ['kullanicilar']);
+db.load();
+assert.strictEqual(db.collection('kullanicilar').get('ahmet'), 'admin');
+assert.strictEqual(db.dropCollection('kullanicilar'), true);
+assert.strictEqual(kullanicilar.has('ahmet'), false);
+assert.deepStrictEqual(db.collections(), []);
+console.log('   ✓ Koleksiyonlar çalışıyor');
+
+console.log('✅ Bölümlenmiş Veritabanı Testi');
+const partFile = 'test-partitioned.bin';
+const partDirs = ['test-part-a', 'test-part-b'];
+const partDb = new Database(partFile, { partitions: 4, directories: partDirs });
+for (let i = 0; i < 100; i++) {
+    partDb.set(`anahtar_${i}`, `değer_${i}`);
+}
+partDb.set('grup.alt', 'iç içe');
+partDb.collection('loglar').set('ilk', 'kayıt');
+assert.strictEqual(fs.readdirSync('test-part-a').length + fs.readdirSync('test-part-b').length, 4);
+const partReopened = new Database(partFile, { partitions: 4, directories: partDirs });
+assert.strictEqual(partReopened.get('anahtar_42'), 'değer_42');
+assert.strictEqual(partReopened.get('grup.alt'), 'iç içe');
+assert.strictEqual(partReopened.collection('loglar').get('ilk'), 'kayıt');
+assert.strictEqual(partReopened.size(), 101);
+const merged = new Database(partFile);
+merged.sync();
+assert.strictEqual(fs.readdirSync('test-part-a').length + fs.readdirSync('test-part-b').length, 0);
+assert.strictEqual(new Database(partFile).get('anahtar_7'), 'değer_7');
+fs.unlinkSync(partFile);
+partDirs.forEach(dir => fs.rmSync(dir, { recursive: true, force: true }));
+console.log('   ✓ Bölümlenmiş kayıt/yükleme çalışıyor');
+
+console.log('✅ Katmanlı Depolama Testi');
+const tierFile = 'test-tiered.bin';
+const tierDb = new Database(tierFile, { memoryLimit: 20000 });
+const uzunDeger = i => `değer_${i}_`.padEnd(200, 'x');
+for (let i = 0; i < 500; i++) {
+    tierDb.set(`katman_${i}`, uzunDeger(i));
+}
+for (let i = 0; i < 20; i++) {
+    tierDb.get('katman_0');
+}
+let tierStats = tierDb.tierStats();
+assert.ok(tierStats.hotBytes <= 20000);
+assert.ok(tierStats.coldEntries > 0);
+assert.strictEqual(tierDb.get('katman_0'), uzunDeger(0));
+assert.strictEqual(tierDb.get('katman_1'), uzunDeger(1));
+assert.ok(tierDb.tierStats().promotions > 0);
+tierDb.sync();
+const tierReopened = new Database(tierFile, { memoryLimit: 20000 });
+assert.ok(tierReopened.tierStats().coldEntries > 0);
+assert.strictEqual(tierReopened.size(), 500);
+assert.strictEqual(tierReopened.get('katman_499'), uzunDeger(499));
+assert.strictEqual(tierReopened.all().length, 500);
+fs.unlinkSync(tierFile);
+console.log('   ✓ Katmanlı depolama çalışıyor');
+
+console.log('✅ Bloom Filtresi Testi');
+const bloomFile = 'test-bloom.bin';
+// False-positive rate of a standard Bloom filter with eight bits set per key
+const expectedRate = bits => Math.pow(1 - Math.exp(-8 / bits), 8);
+const bloomRates = {};
+for (const [bits, partitions] of [[10, 1], [4, 4], [0, 1]]) {
+    const writer = new Database(bloomFile, { bloomBitsPerKey: bits, partitions, autoSync: false });
+    for (let i = 0; i < 10000; i++) {
+        writer.set(`bloom_${i}`, 'x');
+    }
+    writer.sync();
+    const reader = new Database(bloomFile, { readOnly: true });
+    for (let i = 0; i < 10000; i++) {
+        assert.strictEqual(reader.has(`bloom_${i}`), true);
+        assert.strictEqual(reader.has(`eksik_${i}`), false);
+    }
+    const bloom = reader.metrics().bloom;
+    if (bits === 0) {
+        assert.strictEqual(bloom.probes, 0);
+    } else {
+        assert.strictEqual(bloom.probes, 20000);
+        assert.strictEqual(bloom.negatives + bloom.falsePositives, 10000);
+        bloomRates[bits] = bloom.falsePositives / 10000;
+        // Blocking keys into one cache line costs a little accuracy
+        assert.ok(bloomRates[bits] < expectedRate(bits) * 1.5 + 0.002, `${bits} bits: ${bloomRates[bits]}`);
+    }
+    fs.readdirSync('.').filter(file => file.startsWith(bloomFile)).forEach(file => fs.unlinkSync(file));
+}
+assert.ok(bloomRates[10] < 0.02 && bloomRates[4] > bloomRates[10]);
+console.log('   ✓ Bloom filtresi olmayan anahtarları dosyaya dokunmadan yanıtlıyor');
+
+console.log('✅ Derlenmiş Dosya Testi');
+const compiledFile = 'test-compiled.mph';
+const sourceDb = new Database('test-compile-source.bin');
+for (let i = 0; i < 1000; i++) {
+    sourceDb.set(`derlenmiş_${i}`, `değer_${i}`);
+}
+sourceDb.set('ölçümler', new Int32Array([4, 8, 15]));
+sourceDb.set('ayar.tema', 'koyu');
+assert.strictEqual(sourceDb.compile(compiledFile), 1002);
+const compiled = new Database(compiledFile);
+assert.strictEqual(compiled.size(), 1002);
+for (let i = 0; i < 1000; i++) {
+    assert.strictEqual(compiled.get(`derlenmiş_${i}`), `değer_${i}`);
+}
+assert.strictEqual(compiled.get('yok', 'varsayılan'), 'varsayılan');
+assert.strictEqual(compiled.has('yok'), false);
+assert.strictEqual(compiled.get('ayar.tema'), 'koyu');
+assert.strictEqual(compiled.sum('ölçümler'), 27);
+assert.strictEqual(compiled.keys().length, 1002);
+assert.throws(() => compiled.set('yeni', 'değer'), /read-only/);
+fs.unlinkSync(compiledFile);
+fs.unlinkSync('test-compile-source.bin');
+console.log('   ✓ Mükemmel hash ile derlenmiş dosya çalışıyor');
+
+console.log('✅ Salt Okunur Mod Testi');
+const roFile = 'test-readonly.bin';
+const writer = new Database(roFile);
+for (let i = 0; i < 500; i++) {
+    writer.set(`oku_${i}`, `değer_${i}`);
+}
+writer.set('profil.ad', 'Ayşe');
+writer.collection('etiketler').set('renk', 'mavi');
+const reader = new Database(roFile, { readOnly: true });
+assert.strictEqual(reader.size(), 501);
+assert.strictEqual(reader.get('oku_250'), 'değer_250');
+assert.strictEqual(reader.has('yok'), false);
+assert.strictEqual(reader.get('profil.ad'), 'Ayşe');
+assert.strictEqual(reader.collection('etiketler').get('renk'), 'mavi');
+assert.throws(() => reader.set('oku_1', 'x'), /read-only/);
+assert.throws(() => reader.delete('oku_1'), /read-only/);
+assert.throws(() => reader.collection('etiketler').set('renk', 'kırmızı'), /read-only/);
+writer.set('sonradan', 'eklendi');
+assert.strictEqual(reader.get('sonradan'), null);
+reader.load();
+assert.strictEqual(reader.get('sonradan'), 'eklendi');
+fs.unlinkSync(roFile);
+console.log('   ✓ Salt okunur mod çalışıyor');
+
+console.log('✅ Sıralı Dosya Aktarma Testi');
+const sstFile = 'test-ingest.sst';
+const ingestFile = 'test-ingest.bin';
+const sorted = [];
+for (let i = 0; i < 1000; i++) {
+    sorted.push([`toplu_${String(i).padStart(4, '0')}`, `değer_${i}`]);
+}
+sorted.push(['toplu_dizi', new Float64Array([1, 2, 3])]);
+assert.strictEqual(Database.buildFile(sorted, sstFile), 1001);
+assert.throws(() => Database.buildFile([['b', 1], ['a', 2]], sstFile + '.x'), RangeError);
+const ingestDb = new Database(ingestFile);
+ingestDb.set('toplu_0005', 'eski');
+ingestDb.set('ayrı', 'kalır');
+assert.strictEqual(ingestDb.ingest(sstFile), 1001);
+assert.strictEqual(ingestDb.size(), 1002);
+assert.strictEqual(ingestDb.get('toplu_0005'), 'değer_5');
+assert.strictEqual(ingestDb.get('toplu_0999'), 'değer_999');
+assert.strictEqual(ingestDb.sum('toplu_dizi'), 6);
+assert.strictEqual(ingestDb.has('toplu_1000'), false);
+ingestDb.set('toplu_0001', 'yeni');
+assert.strictEqual(ingestDb.delete('toplu_0002'), true);
+assert.strictEqual(ingestDb.size(), 1001);
+const reopened = new Database(ingestFile);
+assert.strictEqual(reopened.get('toplu_0001'), 'yeni');
+assert.strictEqual(reopened.has('toplu_0002'), false);
+assert.strictEqual(reopened.get('toplu_0500'), 'değer_500');
+assert.strictEqual(reopened.keys().length, 1001);
+reopened.clear();
+assert.strictEqual(reopened.size(), 0);
+for (const file of [sstFile, ingestFile]) fs.unlinkSync(file);
+console.log('   ✓ buildFile ve ingest çalışıyor');
+
+console.log('✅ Sütunlu Dışa Aktarma Testi');
+const columnDb = new Database('test-columns.bin');
+for (let i = 0; i < 50; i++) {
+    columnDb.set(`siparisler.${1000 + i}.tutar`, i * 1.5);
+    columnDb.set(`siparisler.${1000 + i}.durum`, i % 3 === 0 ? 'ödendi' : 'bekliyor');
+    if (i % 2 === 0) columnDb.set(`siparisler.${1000 + i}.kargo`, 'true');
+}
+assert.deepStrictEqual(columnDb.exportColumns('siparisler', 'test-columns.fcol'), { rows: 50, columns: 4 });
+const table = Database.readColumns('test-columns.fcol');
+assert.strictEqual(table.rows, 50);
+assert.strictEqual(table.columns.id.get(3), '1003');
+assert.strictEqual(table.columns.tutar.type, 'float64');
+assert.strictEqual(table.columns.tutar.values[4], 6);
+assert.strictEqual(table.columns.durum.type, 'dictionary');
+assert.deepStrictEqual(table.columns.durum.dictionary, ['ödendi', 'bekliyor']);
+assert.strictEqual(table.columns.durum.values[1], 1);
+assert.strictEqual(table.columns.kargo.type, 'bool');
+assert.strictEqual(table.columns.kargo.nulls, 25);
+assert.strictEqual(table.columns.kargo.validity[0] & 0b11, 0b01);
+for (const file of ['test-columns.bin', 'test-columns.fcol']) fs.unlinkSync(file);
+console.log('   ✓ Sütunlu dışa aktarma çalışıyor');
+
+console.log('✅ Günlük Kurtarma Testi');
+const walFile = 'test-wal.bin';
+const walDb = new Database(walFile, { wal: true });
+for (let i = 0; i < 1000; i++) {
+    walDb.set(`günlük_${i}`, `değer_${i}`);
+}
+walDb.delete('günlük_5');
+walDb.collection('etiketler').set('renk', 'mavi');
+walDb.set('ayar.tema', 'koyu');
+assert.strictEqual(walDb.walStats().records, 1003);
+assert.strictEqual(fs.existsSync(walFile), false);
+fs.appendFileSync(walFile + '.wal', Buffer.from([40, 0, 0, 0, 7, 7, 7]));
+const recovered = new Database(walFile, { wal: true });
+assert.strictEqual(recovered.size(), 1000);
+assert.strictEqual(recovered.has('günlük_5'), false);
+assert.strictEqual(recovered.get('ayar.tema'), 'koyu');
+assert.strictEqual(recovered.collection('etiketler').get('renk'), 'mavi');
+assert.strictEqual(recovered.walStats().recoveredRecords, 1003);
+assert.strictEqual(recovered.walStats().truncatedBytes, 7);
+recovered.set('sonra', 'yazıldı');
+recovered.save();
+assert.strictEqual(recovered.walStats().records, 0);
+assert.strictEqual(new Database(walFile, { wal: true }).get('sonra'), 'yazıldı');
+recovered.set('son', 'kayıt');
+assert.strictEqual(new Database(walFile).get('son'), 'kayıt');
+assert.strictEqual(fs.existsSync(walFile + '.wal'), false);
+fs.unlinkSync(walFile);
+const bulkWalFile = 'test-wal-bulk.bin';
+const bulkWal = new Database(bulkWalFile, { wal: true });
+const bulkTags = bulkWal.collection('etiketler');
+for (let i = 0; i < 40000; i++) {
+    bulkWal.set(`toplu_${i}`, `${i}`);
+    bulkTags.set(`eski_${i % 100}`, `${i}`);
+}
+bulkTags.clear();
+for (let i = 0; i < 40000; i += 2) bulkWal.set(`toplu_${i}`, `${-i}`);
+for (let i = 0; i < 40000; i += 1000) bulkWal.delete(`toplu_${i + 1}`);
+bulkTags.set('yeni', 'var');
+const bulkRecovered = new Database(bulkWalFile, { wal: true });
+assert.strictEqual(bulkRecovered.walStats().recoveredRecords, 100042);
+assert.strictEqual(bulkRecovered.size(), 39960);
+assert.strictEqual(bulkRecovered.get('toplu_4'), '-4');
+assert.strictEqual(bulkRecovered.get('toplu_7'), '7');
+assert.strictEqual(bulkRecovered.has('toplu_1001'), false);
+assert.deepStrictEqual(bulkRecovered.collection('etiketler').keys(), ['yeni']);
+for (const file of [bulkWalFile, bulkWalFile + '.wal']) if (fs.existsSync(file)) fs.unlinkSync(file);
+console.log('   ✓ Günlük, kırık kuyruk kesme ve kontrol noktası çalışıyor');
+
+console.log('✅ Zamana Dönük Geri Yükleme Testi');
+const pitrFile = 'test-pitr.bin';
+const pitrDb = new Database(pitrFile, { wal: true, retainCheckpoints: 5 });
+for (let i = 0; i < 100; i++) {
+    pitrDb.set(`sipariş_${i}`, 'yeni');
+}
+const firstPoint = pitrDb.walStats().sequence;
+pitrDb.save();
+const waitTick = () => { const now = Date.now(); while (Date.now() === now); };
+waitTick();
+const savedAt = Date.now();
+waitTick();
+for (let i = 0; i < 100; i++) {
+    pitrDb.set(`sipariş_${i}`, 'bozuk');
+}
+pitrDb.collection('arşiv').set('not', 'silinecek');
+pitrDb.clear();
+assert.strictEqual(pitrDb.walStats().retainedSegments, 1);
+const restoredPoint = pitrDb.restoreTo({ sequence: firstPoint });
+assert.strictEqual(restoredPoint.sequence, firstPoint);
+assert.strictEqual(pitrDb.size(), 100);
+assert.strictEqual(pitrDb.get('sipariş_7'), 'yeni');
+assert.strictEqual(pitrDb.collection('arşiv').get('not'), null);
+const midPoint = pitrDb.restoreTo({ sequence: firstPoint + 50 });
+assert.strictEqual(midPoint.records, 50);
+assert.strictEqual(pitrDb.get('sipariş_49'), 'bozuk');
+assert.strictEqual(pitrDb.get('sipariş_50'), 'yeni');
+assert.strictEqual(new Database(pitrFile, { wal: true, retainCheckpoints: 5 }).get('sipariş_50'), 'yeni');
+pitrDb.restoreTo({ timestamp: new Date(savedAt) });
+assert.strictEqual(pitrDb.get('sipariş_0'), 'yeni');
+assert.strictEqual(pitrDb.size(), 100);
+assert.throws(() => pitrDb.restoreTo({ sequence: 1e9 }), RangeError);
+assert.throws(() => new Database('test-pitr-x.bin', { retainCheckpoints: 1 }), /requires the wal option/);
+pitrDb.restoreTo({ sequence: firstPoint });
+assert.ok(pitrDb.walStats().retainedCheckpoints <= 5);
+fs.readdirSync('.').filter(file => file.startsWith(pitrFile)).forEach(file => fs.unlinkSync(file));
+console.log('   ✓ Kontrol noktası, günlük saklama ve geri yükleme çalışıyor');
+
+console.log('✅ Takipçi Çoğaltma Testi');
+const leaderFile = 'test-leader.bin';
+const leader = new Database(leaderFile, { wal: true, checkpointBytes: 4096 });
+leader.set('başlangıç', 'evet');
+const follower = new Database(leaderFile, { follow: true, followInterval: 60000 });
+assert.strictEqual(follower.get('başlangıç'), 'evet');
+assert.throws(() => follower.set('yaz', 'hayır'), /follower/);
+for (let i = 0; i < 40; i++) {
+    leader.set(`stok_${i}`, `adet_${i}`);
+}
+leader.collection('depo').set('raf', 'A1');
+assert.ok(follower.replicationStatus().pendingBytes > 0);
+assert.strictEqual(follower.catchUp(), 41);
+assert.strictEqual(follower.get('stok_39'), 'adet_39');
+assert.strictEqual(follower.collection('depo').get('raf'), 'A1');
+assert.strictEqual(follower.replicationStatus().reloads, 1);
+for (let i = 0; i < 200; i++) {
+    leader.set(`stok_${i}`, `yeni_${i}`);
+}
+leader.delete('stok_0');
+follower.catchUp();
+const replication = follower.replicationStatus();
+assert.strictEqual(replication.sequence, leader.walStats().sequence);
+assert.strictEqual(replication.pendingBytes, 0);
+assert.strictEqual(follower.get('stok_199'), 'yeni_199');
+assert.strictEqual(follower.has('stok_0'), false);
+assert.strictEqual(follower.promote(), true);
+follower.set('terfi', 'tamam');
+assert.strictEqual(new Database(leaderFile).get('terfi'), 'tamam');
+fs.unlinkSync(leaderFile);
+console.log('   ✓ Günlük takibi, gecikme ölçümü ve terfi çalışıyor');
+
+console.log('✅ Gecikme Metrikleri Testi');
+const metricsFile = 'test-metrics.bin';
+const metricsDb = new Database(metricsFile, { wal: true, walSync: true });
+metricsDb.metrics({ reset: true });
+for (let i = 0; i < 100; i++) {
+    metricsDb.set(`ölçüm_${i}`, `değer_${i}`);
+    metricsDb.get(`ölçüm_${i}`);
+}
+metricsDb.set('ayar.tema', 'koyu');
+metricsDb.get('ayar.tema');
+metricsDb.sync();
+const metrics = metricsDb.metrics({ reset: true });
+assert.strictEqual(metrics.get.count, 100);
+assert.strictEqual(metrics.set.count, 100);
+assert.strictEqual(metrics.nestedGet.count, 1);
+assert.strictEqual(metrics.nestedSet.count, 1);
+assert.ok(metrics.fsync.count >= 101);
+assert.ok(metrics.save.count >= 1);
+assert.ok(metrics.get.p50 > 0 && metrics.get.p50 <= metrics.get.p99);
+assert.ok(metrics.get.p99 <= metrics.get.p999 && metrics.get.p999 <= metrics.get.max);
+assert.strictEqual(metricsDb.metrics().get.count, 0);
+console.log('   ✓ İşlem başına gecikme histogramları çalışıyor');
+
+metricsDb.get('ölçüm_1');
+const metricsText = metricsDb.metricsText();
+assert.ok(metricsText.endsWith('# EOF\n'));
+assert.ok(metricsText.includes('# TYPE fastdb_operation_latency_seconds summary'));
+assert.ok(metricsText.includes('fastdb_operation_latency_seconds_count{operation="get"} 1\n'));
+assert.ok(metricsText.includes('fastdb_keys 101\n'));
+const sampleOf = name => Number(metricsText.match(new RegExp(`^${name} (\\S+)$`, 'm'))[1]);
+assert.ok(sampleOf('fastdb_written_bytes_total') > sampleOf('fastdb_logical_write_bytes_total'));
+assert.ok(sampleOf('fastdb_write_amplification_ratio') > 1);
+assert.ok(sampleOf('fastdb_memory_bytes{component="index"}') > 0);
+assert.ok(sampleOf('fastdb_memory_bytes{component="nested_document"}') > 0);
+assert.strictEqual(sampleOf('fastdb_cache_hit_ratio'), 1);
+assert.ok(sampleOf('fastdb_source_written_bytes_total{source="log"}') > 0);
+assert.ok(sampleOf('fastdb_operation_written_bytes_total{operation="set"}') > 0);
+console.log('   ✓ OpenMetrics metin çıktısı çalışıyor');
+
+metricsDb.metrics({ reset: true });
+metricsDb.set('g/ç', '12345');
+let io = metricsDb.metrics().io;
+assert.strictEqual(io.logicalBytes, Buffer.byteLength('g/ç') + 5);
+assert.strictEqual(io.sources.log.written, io.writtenBytes);
+assert.strictEqual(io.operations.set.written, io.writtenBytes);
+assert.ok(io.operations.set.writeAmplification > 1);
+assert.ok(io.fsyncs >= 1 && io.fsyncTime > 0);
+metricsDb.save();
+io = metricsDb.metrics({ reset: true }).io;
+assert.ok(io.sources.checkpoint.written > 0 && io.operations.save.written === io.sources.checkpoint.written);
+assert.strictEqual(metricsDb.metrics().io.writtenBytes, 0);
+const rewriteDb = new Database(metricsFile + '.rewrite');
+rewriteDb.set('tek', 'bayt');
+io = rewriteDb.metrics().io;
+assert.ok(io.sources.data.written > 0 && io.sources.log.written === 0);
+assert.strictEqual(io.operations.set.written, io.sources.data.written);
+io = new Database(metricsFile + '.rewrite').metrics().io;
+assert.ok(io.sources.data.read > 0 && io.operations.load.read === io.sources.data.read);
+fs.readdirSync('.').filter(file => file.startsWith(metricsFile)).forEach(file => fs.unlinkSync(file));
+console.log('   ✓ Kaynak ve işlem başına G/Ç sayaçları çalışıyor');
+
+const slowFile = 'test-slowlog.bin';
+const slowDb = new Database(slowFile, { wal: true, slowLogThreshold: 0.000001, slowLogSize: 4 });
+for (let i = 0; i < 10; i++) {
+    slowDb.set(`yavaş_${i}`, 'x');
+}
+slowDb.set('belge.başlık', 'y'.repeat(200));
+slowDb.get('belge.başlık');
+let slowLog = slowDb.slowLog();
+assert.strictEqual(slowLog.length, 4);
+assert.strictEqual(slowLog[0].operation, 'nestedGet');
+assert.strictEqual(slowLog[1].operation, 'nestedSet');
+assert.strictEqual(slowLog[1].key, 'belge.başlık');
+assert.strictEqual(slowLog[0].id, slowLog[1].id + 1);
+assert.ok(slowLog[1].phases.parse >= 0 && slowLog[1].phases.serialize > 0 && slowLog[1].phases.io > 0);
+assert.ok(slowLog[0].phases.parse > 0 && slowLog[0].duration >= slowLog[0].phases.parse);
+assert.ok(Math.abs(slowLog[0].timestamp - Date.now()) < 60000);
+assert.strictEqual(slowDb.slowLog({ reset: true }).length, 4);
+assert.strictEqual(slowDb.slowLog().length, 0);
+assert.strictEqual(new Database(slowFile, { wal: true }).slowLog().length, 0);
+assert.throws(() => new Database(slowFile, { slowLogSize: 0 }), RangeError);
+fs.readdirSync('.').filter(file => file.startsWith(slowFile)).forEach(file => fs.unlinkSync(file));
+console.log('   ✓ Yavaş işlem günlüğü çalışıyor');
+
+const memoryFile = 'test-memory.bin';
+const memoryDb = new Database(memoryFile);
+for (let i = 0; i < 300; i++) {
+    memoryDb.set(`kullanıcı:${i}:profil`, 'p'.repeat(100));
+}
+for (let i = 0; i < 100; i++) {
+    memoryDb.set(`oturum:${i}`, 'o'.repeat(20));
+}
+memoryDb.set('ayarlar.tema.renk', 'koyu');
+memoryDb.set('ayarlar.dil', 'tr');
+const keyUsage = memoryDb.memoryUsage('kullanıcı:1:profil');
+assert.ok(keyUsage.value > 100 && keyUsage.node > 0);
+assert.strictEqual(keyUsage.total, keyUsage.key + keyUsage.value + keyUsage.node);
+assert.strictEqual(memoryDb.memoryUsage('yok'), null);
+assert.ok(memoryDb.memoryUsage('ayarlar.tema').value > 0);
+let memoryReport = memoryDb.memoryReport({ groupBy: 1 });
+assert.strictEqual(memoryReport.totalKeys, 400);
+assert.strictEqual(memoryReport.sampledKeys, 400);
+assert.deepStrictEqual(memoryReport.prefixes.map(group => group.prefix), ['kullanıcı', 'oturum']);
+assert.strictEqual(memoryReport.prefixes[0].keys, 300);
+assert.strictEqual(memoryReport.nestedPaths[0].path, 'ayarlar');
+assert.strictEqual(memoryReport.nestedPaths[0].keys, 2);
+memoryReport = memoryDb.memoryReport({ groupBy: 2, samples: 50, limit: 5 });
+assert.ok(memoryReport.sampledKeys >= 50 && memoryReport.prefixes.length <= 5);
+assert.ok(memoryReport.nestedPaths.some(group => group.path === 'ayarlar.tema'));
+assert.throws(() => memoryDb.memoryReport({ groupBy: 0 }), RangeError);
+fs.unlinkSync(memoryFile);
+console.log('   ✓ Anahtar başına bellek kullanımı ve önek raporu çalışıyor');
+
+const hotFile = 'test-hotkeys.bin';
+const hotDb = new Database(hotFile, { hotKeySampling: 1 });
+for (let i = 0; i < 200; i++) {
+    hotDb.get('sıcak');
+    if (i % 2 === 0) hotDb.set('ılık', String(i));
+    hotDb.set(`soğuk_${i}`, 'x');
+}
+hotDb.set('profil.ad', 'Ayşe');
+hotDb.get('profil.ad');
+hotDb.get('profil.ad');
+let hotKeys = hotDb.hotKeys(3);
+assert.strictEqual(hotKeys.length, 3);
+assert.strictEqual(hotKeys[0].key, 'sıcak');
+assert.strictEqual(hotKeys[0].reads, 200);
+assert.strictEqual(hotKeys[0].writes, 0);
+assert.ok(hotKeys[0].readRate > 0 && hotKeys[0].writeRate === 0);
+assert.strictEqual(hotKeys[1].key, 'ılık');
+assert.strictEqual(hotKeys[1].writes, 100);
+assert.strictEqual(hotKeys[2].key, 'profil.ad');
+assert.deepStrictEqual([hotKeys[2].reads, hotKeys[2].writes], [2, 1]);
+assert.strictEqual(hotDb.hotKeys(10, { reset: true }).length, 10);
+assert.strictEqual(hotDb.hotKeys().length, 0);
+assert.strictEqual(new Database(hotFile, { hotKeySampling: 0 }).hotKeys().length, 0);
+assert.throws(() => hotDb.hotKeys(0), RangeError);
+// Sketch dolduktan sonra az okunan anahtarlar sıcak anahtarı çıkarmamalı
+for (let i = 0; i < 10; i++) hotDb.get('sıcak');
+for (let i = 0; i < 1100; i++) hotDb.get(`tek_${i}`);
+hotKeys = hotDb.hotKeys(2);
+assert.strictEqual(hotKeys[0].key, 'sıcak');
+assert.strictEqual(hotKeys[0].reads, 10);
+assert.ok(hotKeys[1].reads <= 2);
+fs.unlinkSync(hotFile);
+console.log('   ✓ Sıcak anahtar tespiti çalışıyor');
+
 console.log('✅ Silme İşlemleri Testi'); 
 db.set('silinecek', 'değer');
 assert.strictEqual(db.has('silinecek'), true);
@@ -123,5 +630,122 @@ if (fs.existsSync('test-backup.json')) {
     fs.unlinkSync('test-backup.json');
 }
 
-console.log('\n🎉 Tüm testler başarıyla geçti!');
-console.log('FastDB hazır ve çalışıyor! 🚀'); 
\ No newline at end of file
+(async () => {
+    console.log('✅ Akış Halinde Dışa Aktarma Testi');
+    const exportDbFile = 'test-export.bin';
+    const exportDb = new Database(exportDbFile);
+    for (let i = 0; i < 100; i++) {
+        exportDb.set(`aktar_${i}`, `satır\n"${i}"`);
+    }
+    exportDb.set('dizi', new Int32Array([4, 5, 6]));
+    exportDb.collection('etiketler').set('renk', 'mavi');
+    const progress = [];
+    const result = await exportDb.exportTo('test-export.ndjson', { onProgress: p => progress.push(p) });
+    assert.strictEqual(result.entries, 102);
+    exportDb.set('sonradan', 'yok');
+    const lines = fs.readFileSync('test-export.ndjson', 'utf8').trim().split('\n').map(line => JSON.parse(line));
+    assert.strictEqual(lines.length, 102);
+    assert.deepStrictEqual(lines.find(line => line.key === 'aktar_7').value, 'satır\n"7"');
+    assert.deepStrictEqual(lines.find(line => line.key === 'dizi').value, [4, 5, 6]);
+    assert.strictEqual(lines.find(line => line.collection === 'etiketler').value, 'mavi');
+    assert.strictEqual(progress[progress.length - 1].entries, 102);
+    await exportDb.exportTo('test-export.copy', { format: 'binary' });
+    const copy = new Database('test-export.copy');
+    assert.strictEqual(copy.size(), 102);
+    assert.strictEqual(copy.get('aktar_42'), 'satır\n"42"');
+    assert.deepStrictEqual(Array.from(copy.get('dizi')), [4, 5, 6]);
+    assert.strictEqual(copy.collection('etiketler').get('renk'), 'mavi');
+    await assert.rejects(exportDb.exportTo('test-export.x', { format: 'csv' }), RangeError);
+    for (const file of [exportDbFile, 'test-export.ndjson', 'test-export.copy']) fs.unlinkSync(file);
+    console.log('   ✓ exportTo çalışıyor');
+
+    console.log('✅ Asenkron Açılış Testi');
+    const asyncFile = 'test-async.bin';
+    const seed = new Database(asyncFile, { partitions: 2 });
+    for (let i = 0; i < 20000; i++) {
+        seed.set(`yük_${i}`, `değer_${i}`);
+    }
+    seed.collection('etiketler').set('renk', 'mavi');
+    const events = [];
+    const opened = await Database.open(asyncFile, { partitions: 2, onProgress: e => events.push(e) });
+    assert.strictEqual(opened.size(), 20000);
+    assert.strictEqual(opened.get('yük_19999'), 'değer_19999');
+    assert.strictEqual(opened.collection('etiketler').get('renk'), 'mavi');
+    assert.ok(events.length > 0);
+    assert.strictEqual(events[events.length - 1].keys, 20001);
+    opened.set('yazılabilir', 'evet');
+    const deferred = new Database(asyncFile, { partitions: 2, deferLoad: true });
+    assert.throws(() => deferred.set('erken', 'x'), /still loading/);
+    const ready = deferred.loadAsync();
+    await assert.rejects(deferred.loadAsync(), /already in progress/);
+    assert.strictEqual(await ready, deferred);
+    assert.strictEqual(deferred.get('yazılabilir'), 'evet');
+    deferred.set('sonra', 'olur');
+    deferred.clear();
+    for (const file of fs.readdirSync('.').filter(name => name.startsWith(asyncFile))) fs.unlinkSync(file);
+    console.log('   ✓ Database.open ve loadAsync çalışıyor');
+
+    console.log('✅ RESP Sunucu Testi');
+    const serverFile = 'test-server.bin';
+    const served = new Database(serverFile);
+    served.set('sayaç', 5);
+    served.set('vektör', new Float64Array([1, 2]));
+    const port = served.startServer({ port: 0 });
+    assert.throws(() => served.startServer({ port: 0 }), /already running/);
+    const net = require('net');
+    const encode = args => `*${args.length}\r\n` + args.map(arg => `$${Buffer.byteLength(arg)}\r\n${arg}\r\n`).join('');
+    const roundTrip = payload => new Promise((resolve, reject) => {
+        const socket = net.connect(port, '127.0.0.1');
+        const chunks = [];
+        socket.on('data', chunk => chunks.push(chunk));
+        socket.on('end', () => resolve(Buffer.concat(chunks).toString()));
+        socket.on('error', reject);
+        socket.write(payload);
+    });
+    const pipeline = [['SET', 'anahtar', 'değer'], ['GET', 'anahtar'], ['INCRBY', 'sayaç', '10'],
+        ['MGET', 'anahtar', 'yok'], ['EXISTS', 'anahtar', 'yok'], ['GET', 'vektör'], ['DEL', 'anahtar'],
+        ['SCAN', '0', 'MATCH', 'say*', 'COUNT', '1000'], ['NOPE']];
+    const replies = await roundTrip(pipeline.map(encode).join('') + 'PING\r\n' + encode(['QUIT']));
+    assert.strictEqual(replies, '+OK\r\n$6\r\ndeğer\r\n:15\r\n*2\r\n$6\r\ndeğer\r\n$-1\r\n:1\r\n' +
+        '-WRONGTYPE Operation against a key holding a numeric array\r\n:1\r\n*2\r\n$1\r\n0\r\n*1\r\n$6\r\nsayaç\r\n' +
+        "-ERR unknown command 'NOPE'\r\n+PONG\r\n+OK\r\n");
+    assert.strictEqual(new Database(serverFile).get('sayaç'), '15');
+    assert.strictEqual(served.serverStats().commands, 11);
+    const overflow = '-ERR increment or decrement would overflow\r\n';
+    const limits = [['SET', 'büyük', '9007199254740990'], ['INCRBY', 'büyük', '2'], ['INCRBY', 'büyük', '1'],
+        ['INCRBY', 'büyük', '-9223372036854775807'], ['INCRBY', 'büyük', '9223372036854775807'],
+        ['INCRBY', 'büyük', '99999999999999999999'], ['INCRBY', 'büyük', '-1'], ['QUIT']];
+    assert.strictEqual(await roundTrip(limits.map(encode).join('')), '+OK\r\n:9007199254740992\r\n' + overflow +
+        overflow + overflow + '-ERR value is not an integer or out of range\r\n:9007199254740991\r\n+OK\r\n');
+    assert.strictEqual(served.get('büyük'), '9007199254740991');
+    // Yanıtları okumayan istemci: sunucu okumayı durdurur, okununca devam eder
+    const block = 'x'.repeat(1024 * 1024);
+    served.set('blok', block);
+    const slowReader = await new Promise((resolve, reject) => {
+        const socket = net.connect(port, '127.0.0.1');
+        let received = 0;
+        socket.pause();
+        socket.on('data', chunk => { received += chunk.length; });
+        socket.on('end', () => resolve(received));
+        socket.on('error', reject);
+        socket.write(encode(['GET', 'blok']).repeat(40));
+        for (let i = 0; i < 64; i++) socket.write(encode(['SET', `blok_${i}`, block]));
+        socket.write(encode(['QUIT']));
+        setTimeout(() => {
+            assert.ok(socket.writableLength > 0);
+            socket.resume();
+        }, 300);
+    });
+    assert.strictEqual(slowReader, 40 * (1024 * 1024 + 12) + 64 * 5 + 5);
+    assert.strictEqual(served.get('blok_63'), block);
+    assert.strictEqual(served.stopServer(), true);
+    assert.strictEqual(served.serverStats().running, false);
+    fs.unlinkSync(serverFile);
+    console.log('   ✓ Boru hattı, INCRBY, SCAN ve toplu kayıt çalışıyor');
+
+    console.log('\n🎉 Tüm testler başarıyla geçti!');
+    console.log('FastDB hazır ve çalışıyor! 🚀');
+})().catch(error => {
+    console.error(error);
+    process.exit(1);
+});